@@ -314,6 +314,7 @@ async def upload_video(
             "video_path": video_path,
             "task": task,
             "params": params_dict,
+            "size_bytes": file_size,
             "created_at": job.created_at.isoformat()
         }
         
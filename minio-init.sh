@@ -24,6 +24,13 @@ fi
 echo "Configurando política de acceso público..."
 mc anonymous set download local/artifacts
 
-echo "Bucket 'artifacts' configurado con acceso público para descarga"
+# process_video sube los resultados a artifacts/results/ (PUT y multipart sin firmar)
+mc anonymous set upload local/artifacts/results
+
+# Checkpoints de jobs que nunca se reintentaron (o sin permiso para borrarlos al terminar)
+mc ilm rule add --prefix "results/checkpoints/" --expire-days 7 local/artifacts || \
+    echo "No se pudo configurar la expiracion de results/checkpoints/"
+
+echo "Bucket 'artifacts' configurado con acceso público para descarga y subida de resultados"
 
 wait $MINIO_PID # Espera a que MinIO termine (se mantiene el contenedor corriendo)
\ No newline at end of file
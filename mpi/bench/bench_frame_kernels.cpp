@@ -0,0 +1,167 @@
+/*
+ * Microbenchmark de los kernels de frame_kernels contra OpenCV.
+ *
+ *   bench_frame_kernels [ancho alto ancho_salida alto_salida iteraciones]
+ *
+ * Por defecto 1920x1080 -> 1280x720, 200 iteraciones. Cada kernel se mide con
+ * todos los juegos de instrucciones que soporta la CPU; "bgr round trip" es el
+ * camino que evitan los kernels: YUV420 -> BGR -> resize -> YUV420 en cv::Mat.
+ */
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include "frame_kernels.h"
+
+// Un frame I420 contiguo (Y, U, V seguidos) para poder envolverlo en un cv::Mat
+typedef struct {
+    std::vector<uint8_t> buffer;
+    Yuv420Planes planes;
+    cv::Mat i420;
+} I420Frame;
+
+static void alloc_frame(I420Frame *f, int width, int height) {
+    size_t luma = (size_t)width * height;
+    f->buffer.assign(luma * 3 / 2, 0);
+    f->planes.data[0] = f->buffer.data();
+    f->planes.data[1] = f->planes.data[0] + luma;
+    f->planes.data[2] = f->planes.data[1] + luma / 4;
+    f->planes.linesize[0] = width;
+    f->planes.linesize[1] = width / 2;
+    f->planes.linesize[2] = width / 2;
+    f->planes.width = width;
+    f->planes.height = height;
+    f->i420 = cv::Mat(height * 3 / 2, width, CV_8UC1, f->buffer.data());
+}
+
+// Cada plano como cv::Mat sin copiar
+static cv::Mat plane_mat(const I420Frame *f, int p) {
+    int shift = (p > 0);
+    return cv::Mat(f->planes.height >> shift, f->planes.width >> shift, CV_8UC1,
+                   f->planes.data[p], f->planes.linesize[p]);
+}
+
+template <typename F>
+static double ms_per_frame(int iterations, F body) {
+    body();  // calentar caches y la eleccion de kernels
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        body();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+static void report(const char *kernel, const char *impl, double ms, double baseline_ms) {
+    printf("%-16s %-10s %9.3f ms/frame %7.2fx\n", kernel, impl, ms, baseline_ms / ms);
+}
+
+static int max_diff(const uint8_t *a, const uint8_t *b, size_t n) {
+    int diff = 0;
+    for (size_t i = 0; i < n; i++) {
+        int d = abs(a[i] - b[i]);
+        diff = d > diff ? d : diff;
+    }
+    return diff;
+}
+
+int main(int argc, char **argv) {
+    int width = argc > 2 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int out_width = argc > 4 ? atoi(argv[3]) : 1280;
+    int out_height = argc > 4 ? atoi(argv[4]) : 720;
+    int iterations = argc > 5 ? atoi(argv[5]) : 200;
+    if (width <= 0 || height <= 0 || out_width <= 0 || out_height <= 0 || iterations <= 0 ||
+        (width | height | out_width | out_height) & 1) {
+        fprintf(stderr, "Uso: %s [ancho alto ancho_salida alto_salida iteraciones] (dimensiones pares)\n", argv[0]);
+        return 1;
+    }
+
+    I420Frame src, dst, cv_dst;
+    alloc_frame(&src, width, height);
+    alloc_frame(&dst, out_width, out_height);
+    alloc_frame(&cv_dst, out_width, out_height);
+
+    // Contenido con bordes y gradientes, no ruido puro: parecido a video real para las caches y el LUT
+    cv::RNG rng(12345);
+    rng.fill(src.i420, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(src.i420, src.i420, cv::Size(9, 9), 0);
+
+    cv::setNumThreads(1);  // los kernels son de un hilo; OpenCV en paralelo no es comparable
+    printf("Frame %dx%d -> %dx%d, %d iteraciones, OpenCV %s (1 hilo)\n\n",
+           width, height, out_width, out_height, iterations, CV_VERSION);
+
+    static const char *isas[] = {"scalar", "avx2", "avx512"};
+
+    // Escalado de los tres planos
+    double cv_scale = ms_per_frame(iterations, [&] {
+        for (int p = 0; p < 3; p++) {
+            cv::Mat out = plane_mat(&cv_dst, p);
+            cv::resize(plane_mat(&src, p), out, out.size(), 0, 0, cv::INTER_LINEAR);
+        }
+    });
+    report("scale", "opencv", cv_scale, cv_scale);
+    // Como en el pipeline: el plan de escalado se arma una vez por geometria
+    Yuv420Scaler *scaler = yuv420_scaler_alloc(width, height, out_width, out_height);
+    for (const char *isa : isas) {
+        if (frame_kernels_select(isa)) {
+            report("scale", isa, ms_per_frame(iterations, [&] { yuv420_scaler_run(scaler, &src.planes, &dst.planes); }),
+                   cv_scale);
+        }
+    }
+    printf("%-16s max |kernel - opencv| = %d\n\n", "",
+           max_diff(dst.buffer.data(), cv_dst.buffer.data(), dst.buffer.size()));
+
+    // Lo que cuesta pasar por BGR para escalar
+    cv::Mat bgr, bgr_scaled;
+    double cv_round_trip = ms_per_frame(iterations, [&] {
+        cv::cvtColor(src.i420, bgr, cv::COLOR_YUV2BGR_I420);
+        cv::resize(bgr, bgr_scaled, cv::Size(out_width, out_height), 0, 0, cv::INTER_LINEAR);
+        cv::cvtColor(bgr_scaled, cv_dst.i420, cv::COLOR_BGR2YUV_I420);
+    });
+    report("bgr round trip", "opencv", cv_round_trip, cv_round_trip);
+    frame_kernels_select(NULL);
+    report("bgr round trip", frame_kernels_isa(),
+           ms_per_frame(iterations, [&] { yuv420_scaler_run(scaler, &src.planes, &dst.planes); }), cv_round_trip);
+    yuv420_scaler_free(&scaler);
+    printf("\n");
+
+    // YUV420 -> BGR24
+    cv::Mat cv_bgr;
+    std::vector<uint8_t> kernel_bgr((size_t)width * height * 3);
+    double cv_convert = ms_per_frame(iterations, [&] { cv::cvtColor(src.i420, cv_bgr, cv::COLOR_YUV2BGR_I420); });
+    report("yuv420 -> bgr", "opencv", cv_convert, cv_convert);
+    for (const char *isa : isas) {
+        if (frame_kernels_select(isa)) {
+            report("yuv420 -> bgr", isa,
+                   ms_per_frame(iterations, [&] { yuv420_to_bgr(&src.planes, kernel_bgr.data(), width * 3); }),
+                   cv_convert);
+        }
+    }
+    printf("%-16s max |kernel - opencv| = %d\n\n", "",
+           max_diff(kernel_bgr.data(), cv_bgr.data, kernel_bgr.size()));
+
+    // Brillo/contraste de la luma, fuera del lugar como cv::Mat::convertTo
+    const int brightness = -12;
+    const double contrast = 0.85;
+    cv::Mat luma = plane_mat(&src, 0);
+    cv::Mat cv_luma;
+    I420Frame work;
+    alloc_frame(&work, width, height);
+    double cv_adjust = ms_per_frame(iterations, [&] {
+        luma.convertTo(cv_luma, CV_8U, contrast, 128 * (1 - contrast) + brightness);
+    });
+    report("brightness", "opencv", cv_adjust, cv_adjust);
+    for (const char *isa : isas) {
+        if (frame_kernels_select(isa)) {
+            report("brightness", isa, ms_per_frame(iterations, [&] {
+                yuv420_adjust(&src.planes, &work.planes, brightness, contrast);
+            }), cv_adjust);
+        }
+    }
+    printf("%-16s max |kernel - opencv| = %d (el kernel tambien copia el croma)\n",
+           "", max_diff(work.planes.data[0], cv_luma.data, (size_t)width * height));
+    return 0;
+}
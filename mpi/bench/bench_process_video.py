@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+"""
+Benchmark de punta a punta de process_video contra un S3 local.
+
+Genera videos sinteticos (testsrc2 + tono, H.264/AAC) para cada combinacion
+de resolucion, largo de GOP y duracion, los sirve con fake_s3.py (GET con
+Range, como MinIO) y corre process_video bajo mpirun con cada cantidad de
+ranks y de threads por rank. De cada corrida toma el registro "[Metricas]"
+del rank 0 (min/max/media por rank de head, index, download, broadcast,
+seek, decode, busy, idle, assemble, upload y total), usa el maximo de cada
+etapa entre los ranks y escribe todo como JSON: las corridas sueltas y la
+mediana por configuracion.
+
+    python3 bench_process_video.py --ranks 1,2,4 --threads 1,4 --output bench.json
+    python3 bench_process_video.py --baseline bench.json --tolerance 0.15
+
+Con --baseline compara la mediana del total de cada configuracion contra un
+JSON anterior y termina con codigo 1 si alguna empeoro mas que --tolerance.
+La cache de videos, la de resultados y los checkpoints se desactivan
+(DVP_CACHE_MB=0, DVP_RESULT_CACHE=0, DVP_CHECKPOINT=0) para que cada corrida
+descargue, procese y suba lo mismo.
+"""
+
+import argparse
+import glob
+import itertools
+import json
+import os
+import platform
+import re
+import shlex
+import shutil
+import socket
+import statistics
+import subprocess
+import sys
+import time
+import urllib.error
+import urllib.request
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+STAGES = ["head", "index", "download", "broadcast", "seek", "decode", "busy", "idle", "assemble", "upload", "total"]
+METRICS_LINE = re.compile(r"^\[Metricas\] (\{.*\})$", re.MULTILINE)
+
+
+def int_list(text):
+    return [int(x) for x in text.split(",") if x]
+
+
+def resolution_list(text):
+    return [tuple(int(v) for v in x.split("x")) for x in text.split(",") if x]
+
+
+def generate_video(path, width, height, gop, duration, fps):
+    if os.path.exists(path):
+        return
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    # Un solo thread de x264 y sin cortes de escena: mismos bytes en cada maquina
+    cmd = ["ffmpeg", "-v", "error", "-y",
+           "-f", "lavfi", "-i", f"testsrc2=size={width}x{height}:rate={fps}",
+           "-f", "lavfi", "-i", "sine=frequency=440:sample_rate=48000",
+           "-t", str(duration), "-c:v", "libx264", "-preset", "veryfast", "-threads", "1",
+           "-g", str(gop), "-keyint_min", str(gop), "-sc_threshold", "0", "-pix_fmt", "yuv420p",
+           "-c:a", "aac", "-b:a", "96k", "-shortest", path + ".partial.mp4"]
+    subprocess.run(cmd, check=True)
+    os.replace(path + ".partial.mp4", path)
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def start_object_store(root, latency_ms):
+    port = free_port()
+    proc = subprocess.Popen([sys.executable, os.path.join(HERE, "fake_s3.py"), "--port", str(port),
+                             "--root", root, "--latency-ms", str(latency_ms)],
+                            stdout=subprocess.DEVNULL)
+    endpoint = f"http://127.0.0.1:{port}"
+    for _ in range(100):
+        try:
+            urllib.request.urlopen(endpoint + "/uploads/ping", timeout=1)
+        except urllib.error.HTTPError:
+            return proc, endpoint  # 404: ya atiende
+        except OSError:
+            time.sleep(0.05)
+    proc.kill()
+    raise RuntimeError("fake_s3.py no arranco")
+
+
+def build_info(process_video):
+    info = {"host": platform.node(), "cpus": os.cpu_count(), "process_video": process_video}
+    try:
+        info["commit"] = subprocess.run(["git", "-C", HERE, "rev-parse", "HEAD"], capture_output=True,
+                                        text=True, check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        pass
+    binary = shutil.which(process_video)
+    if binary:
+        info["process_video_mtime"] = int(os.path.getmtime(binary))
+    return info
+
+
+def run_job(args, endpoint, video_path, job_id, ranks, threads):
+    env = dict(os.environ,
+               DVP_S3_ENDPOINT=endpoint,
+               DVP_THREADS_PER_RANK=str(threads),
+               DVP_CACHE_MB="0",
+               DVP_RESULT_CACHE="0",
+               DVP_CHECKPOINT="0",
+               DVP_FETCH_MODE=args.fetch_mode,
+               DVP_SCHEDULE=args.schedule,
+               DVP_UPLOAD="1" if args.upload else "0")
+    exported = [arg for name in ("DVP_S3_ENDPOINT", "DVP_THREADS_PER_RANK", "DVP_CACHE_MB", "DVP_RESULT_CACHE",
+                                 "DVP_CHECKPOINT", "DVP_FETCH_MODE", "DVP_SCHEDULE", "DVP_UPLOAD") for arg in ("-x", name)]
+    cmd = ([args.mpirun, "-np", str(ranks)] + shlex.split(args.mpirun_args) + exported +
+           [args.process_video, job_id, video_path, args.task, args.params])
+
+    started = time.monotonic()
+    result = subprocess.run(cmd, env=env, capture_output=True, text=True, timeout=args.timeout)
+    wall = time.monotonic() - started
+
+    # Ni el resultado local ni el subido se conservan entre corridas
+    for path in glob.glob(f"/tmp/output_{job_id}.*") + glob.glob(os.path.join(args.workdir, "s3", "artifacts",
+                                                                               "results", job_id + ".*")):
+        os.unlink(path)
+
+    match = METRICS_LINE.search(result.stdout)
+    if result.returncode != 0 or not match:
+        sys.stderr.write(result.stdout[-2000:] + result.stderr[-2000:])
+        raise RuntimeError(f"{job_id}: process_video fallo (codigo {result.returncode})")
+    record = json.loads(match.group(1))
+    # El camino critico de cada etapa es el del rank mas lento en ella
+    record["seconds"] = {s: record["metrics"][s]["max"] for s in STAGES}
+    record["wall"] = wall
+    return record
+
+
+def derived(record):
+    seconds = record["seconds"]
+    mb = record["video_bytes"] / (1024.0 * 1024.0)
+    rates = {
+        "mb_per_s": mb / seconds["total"] if seconds["total"] > 0 else 0.0,
+        "frames_per_s": record["video_frames"] / seconds["total"] if seconds["total"] > 0 else 0.0,
+    }
+    # Totales del job: la media por rank por la cantidad de ranks
+    metrics = record["metrics"]
+    if seconds["download"] > 0:
+        downloaded = metrics["bytes_downloaded"]["mean"] * record["ranks"]
+        rates["download_mb_per_s"] = downloaded / (1024.0 * 1024.0) / seconds["download"]
+    if seconds["decode"] > 0:
+        rates["decode_frames_per_s"] = metrics["frames"]["mean"] * record["ranks"] / seconds["decode"]
+    return rates
+
+
+def summarize(config, records):
+    summary = {"config": config, "repeat": len(records)}
+    summary["median_seconds"] = {s: statistics.median(r["seconds"][s] for r in records) for s in STAGES}
+    summary["median_wall"] = statistics.median(r["wall"] for r in records)
+    rates = [derived(r) for r in records]
+    common = [k for k in rates[0] if all(k in r for r in rates)]
+    summary["median_rates"] = {k: statistics.median(r[k] for r in rates) for k in common}
+    return summary
+
+
+def config_key(config):
+    return tuple(sorted((k, str(v)) for k, v in config.items()))
+
+
+def compare(summaries, baseline_path, tolerance):
+    with open(baseline_path) as f:
+        baseline = {config_key(s["config"]): s for s in json.load(f)["summary"]}
+    regressions = []
+    for summary in summaries:
+        old = baseline.get(config_key(summary["config"]))
+        if not old:
+            continue
+        before = old["median_seconds"]["total"]
+        after = summary["median_seconds"]["total"]
+        change = (after - before) / before if before > 0 else 0.0
+        status = "REGRESION" if change > tolerance else "ok"
+        print(f"{status:9s} {summary['config']}: total {before:.3f}s -> {after:.3f}s ({change:+.1%})")
+        if change > tolerance:
+            regressions.append(summary["config"])
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark de process_video con un S3 local")
+    parser.add_argument("--process-video", default="process_video")
+    parser.add_argument("--mpirun", default="mpirun")
+    parser.add_argument("--mpirun-args", default="--oversubscribe",
+                        help="argumentos extra de mpirun (hostfile, --allow-run-as-root...)")
+    parser.add_argument("--resolutions", type=resolution_list, default=resolution_list("640x360,1280x720"))
+    parser.add_argument("--gops", type=int_list, default=[30, 120], help="frames por GOP")
+    parser.add_argument("--durations", type=int_list, default=[20], help="segundos")
+    parser.add_argument("--fps", type=int, default=30)
+    parser.add_argument("--ranks", type=int_list, default=[1, 2, 4])
+    parser.add_argument("--threads", type=int_list, default=[1, 2], help="DVP_THREADS_PER_RANK")
+    parser.add_argument("--task", default="convert")
+    parser.add_argument("--params", default="{}")
+    parser.add_argument("--fetch-mode", choices=["direct", "master"], default="direct")
+    parser.add_argument("--schedule", choices=["static", "dynamic"], default="static")
+    parser.add_argument("--no-upload", dest="upload", action="store_false")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--latency-ms", type=float, default=0.0, help="espera por pedido del S3 local")
+    parser.add_argument("--workdir", default="/tmp/dvp_bench")
+    parser.add_argument("--timeout", type=float, default=1800)
+    parser.add_argument("--output", help="JSON de resultados (por defecto a stdout)")
+    parser.add_argument("--baseline", help="JSON de una corrida anterior para comparar")
+    parser.add_argument("--tolerance", type=float, default=0.10)
+    args = parser.parse_args()
+
+    root = os.path.join(args.workdir, "s3")
+    videos = []
+    for (width, height), gop, duration in itertools.product(args.resolutions, args.gops, args.durations):
+        name = f"{width}x{height}_g{gop}_{duration}s"
+        generate_video(os.path.join(root, "uploads", "bench", name + ".mp4"), width, height, gop, duration, args.fps)
+        videos.append({"video": name, "width": width, "height": height, "gop": gop, "duration": duration})
+
+    store, endpoint = start_object_store(root, args.latency_ms)
+    runs = []
+    summaries = []
+    try:
+        for video, ranks, threads in itertools.product(videos, args.ranks, args.threads):
+            config = dict(video, ranks=ranks, threads=threads, task=args.task, params=args.params,
+                          fetch_mode=args.fetch_mode, schedule=args.schedule)
+            records = []
+            for i in range(args.repeat):
+                job_id = f"bench_{video['video']}_n{ranks}_t{threads}_{i}"
+                record = run_job(args, endpoint, f"uploads/bench/{video['video']}.mp4", job_id, ranks, threads)
+                record["config"] = config
+                record["rates"] = derived(record)
+                records.append(record)
+                runs.append(record)
+                print(f"{job_id}: total {record['seconds']['total']:.3f}s, "
+                      f"{record['rates']['mb_per_s']:.1f} MB/s, {record['rates']['frames_per_s']:.0f} frames/s, "
+                      f"etapa mas larga {record['slowest_stage']}, rank mas lento {record['straggler_rank']}",
+                      file=sys.stderr)
+            summaries.append(summarize(config, records))
+    finally:
+        store.terminate()
+        store.wait()
+
+    report = {"build": build_info(args.process_video), "started": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+              "runs": runs, "summary": summaries}
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+    if args.baseline and compare(summaries, args.baseline, args.tolerance):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
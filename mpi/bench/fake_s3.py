@@ -0,0 +1,315 @@
+#!/usr/bin/env python3
+"""
+Servidor local compatible con el subconjunto de S3 que usa process_video:
+GET/HEAD con Range, PUT (tambien condicional, con If-Match o
+If-None-Match: *), copia (PUT con x-amz-copy-source), subida multipart
+(iniciar, partes, completar, abortar), DELETE y ListObjectsV2 por prefijo. Guarda los objetos
+como archivos en --root/<bucket>/<key> y no valida firmas, asi que sirve con
+o sin DVP_S3_ACCESS_KEY.
+
+    python3 fake_s3.py --port 9000 --root /tmp/fake_s3
+    DVP_S3_ENDPOINT=http://localhost:9000 process_video ...
+
+--latency-ms agrega una espera fija a cada pedido para simular la red.
+"""
+
+import argparse
+import hashlib
+import os
+import re
+import shutil
+import threading
+import time
+import uuid
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, unquote, urlsplit
+from xml.sax.saxutils import escape
+
+
+COPY_CHUNK = 1 << 20
+
+
+class Store:
+    def __init__(self, root):
+        self.root = root
+        self.lock = threading.RLock()  # reentrante: un PUT condicional pide el ETag con el lock tomado
+        self.uploads = {}  # upload_id -> (bucket, key)
+        self.etags = {}  # path -> (mtime_ns, size, etag)
+
+    def etag(self, path):
+        """ETag del objeto; el MD5 se calcula una vez por version del archivo."""
+        st = os.stat(path)
+        with self.lock:
+            cached = self.etags.get(path)
+        if cached and cached[:2] == (st.st_mtime_ns, st.st_size):
+            return cached[2]
+        digest = hashlib.md5()
+        with open(path, "rb") as f:
+            for chunk in iter(lambda: f.read(COPY_CHUNK), b""):
+                digest.update(chunk)
+        etag = '"' + digest.hexdigest() + '"'
+        self.remember(path, etag, st)
+        return etag
+
+    def remember(self, path, etag, st=None):
+        """Guarda el ETag que S3 habria devuelto al escribir el objeto (p.ej. el de multipart)."""
+        st = st or os.stat(path)
+        with self.lock:
+            self.etags[path] = (st.st_mtime_ns, st.st_size, etag)
+
+    def object_path(self, bucket, key):
+        path = os.path.normpath(os.path.join(self.root, bucket, key))
+        if not path.startswith(os.path.normpath(self.root) + os.sep):
+            raise ValueError("ruta fuera del root")
+        return path
+
+    def upload_dir(self, upload_id):
+        return os.path.join(self.root, ".uploads", upload_id)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # keep-alive, como el pool de curl
+    store = None
+    latency = 0.0
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def parse(self):
+        if self.latency:
+            time.sleep(self.latency)
+        parts = urlsplit(self.path)
+        query = parse_qs(parts.query, keep_blank_values=True)
+        bucket, _, key = unquote(parts.path).lstrip("/").partition("/")
+        return bucket, key, query
+
+    def body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        return self.rfile.read(length) if length else b""
+
+    def reply(self, status, data=b"", headers=None):
+        self.send_response(status)
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        if data and self.command != "HEAD":
+            self.wfile.write(data)
+
+    def error(self, status, code):
+        xml = f"<?xml version=\"1.0\"?><Error><Code>{code}</Code></Error>".encode()
+        self.reply(status, xml, {"Content-Type": "application/xml"})
+
+    def do_HEAD(self):
+        self.do_GET()
+
+    def do_GET(self):
+        bucket, key, query = self.parse()
+        if not key and "list-type" in query:
+            return self.list_objects(bucket, query)
+        try:
+            path = self.store.object_path(bucket, key)
+            f = open(path, "rb")
+        except (OSError, ValueError):
+            self.body()
+            return self.error(404, "NoSuchKey")
+
+        # Solo se lee del disco el rango pedido
+        with f:
+            size = os.fstat(f.fileno()).st_size
+            etag = self.store.etag(path)
+            match = re.match(r"bytes=(\d+)-(\d*)", self.headers.get("Range", ""))
+            if not match:
+                return self.send_range(f, 200, 0, size, {"ETag": etag})
+
+            start = int(match.group(1))
+            end = int(match.group(2)) if match.group(2) else size - 1
+            end = min(end, size - 1)
+            if start > end:
+                return self.error(416, "InvalidRange")
+            self.send_range(f, 206, start, end + 1 - start,
+                            {"ETag": etag, "Content-Range": f"bytes {start}-{end}/{size}"})
+
+    def send_range(self, f, status, start, length, headers):
+        self.send_response(status)
+        for name, value in headers.items():
+            self.send_header(name, value)
+        self.send_header("Content-Length", str(length))
+        self.end_headers()
+        if self.command == "HEAD":
+            return
+        f.seek(start)
+        while length > 0:
+            chunk = f.read(min(length, COPY_CHUNK))
+            if not chunk:
+                break
+            self.wfile.write(chunk)
+            length -= len(chunk)
+
+    def list_objects(self, bucket, query):
+        prefix = query.get("prefix", [""])[0]
+        after = query.get("continuation-token", [""])[0]
+        max_keys = int(query.get("max-keys", ["1000"])[0])
+        root = os.path.join(self.store.root, bucket)
+        keys = []
+        for directory, _, files in os.walk(root):
+            for name in files:
+                key = os.path.relpath(os.path.join(directory, name), root).replace(os.sep, "/")
+                if key.startswith(prefix) and key > after and not key.endswith(".partial"):
+                    keys.append(key)
+        keys.sort()
+
+        # El token es la ultima clave de la pagina: la siguiente arranca despues
+        page = keys[:max_keys]
+        truncated = len(keys) > max_keys
+        contents = "".join(
+            f"<Contents><Key>{escape(key)}</Key><Size>{os.path.getsize(os.path.join(root, key))}</Size></Contents>"
+            for key in page)
+        token = f"<NextContinuationToken>{escape(page[-1])}</NextContinuationToken>" if truncated else ""
+        xml = (f"<?xml version=\"1.0\"?><ListBucketResult><Name>{bucket}</Name><Prefix>{escape(prefix)}</Prefix>"
+               f"<KeyCount>{len(page)}</KeyCount><IsTruncated>{'true' if truncated else 'false'}</IsTruncated>"
+               f"{token}{contents}</ListBucketResult>")
+        self.reply(200, xml.encode(), {"Content-Type": "application/xml"})
+
+    def do_PUT(self):
+        bucket, key, query = self.parse()
+        data = self.body()
+        etag = '"' + hashlib.md5(data).hexdigest() + '"'
+
+        if "uploadId" in query:
+            upload_id = query["uploadId"][0]
+            if upload_id not in self.store.uploads:
+                return self.error(404, "NoSuchUpload")
+            part = int(query["partNumber"][0])
+            with open(os.path.join(self.store.upload_dir(upload_id), f"{part:05d}"), "wb") as f:
+                f.write(data)
+            return self.reply(200, b"", {"ETag": etag})
+
+        try:
+            path = self.store.object_path(bucket, key)
+        except ValueError:
+            return self.error(400, "InvalidObjectName")
+
+        # Copia del lado del servidor: "/bucket/key" del objeto de origen
+        copy_source = self.headers.get("x-amz-copy-source")
+        if copy_source:
+            source_bucket, _, source_key = unquote(copy_source).lstrip("/").partition("/")
+            try:
+                source = self.store.object_path(source_bucket, source_key)
+                etag = self.store.etag(source)
+            except (OSError, ValueError):
+                return self.error(404, "NoSuchKey")
+            if source == path:
+                return self.error(400, "InvalidRequest")  # como S3, sin cambiar metadata
+
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with self.store.lock:
+            # Comparar y escribir bajo el lock: dos PUT condicionales no pueden pisarse
+            if not self.precondition_met(path):
+                return self.error(412, "PreconditionFailed")
+            if copy_source:
+                shutil.copyfile(source, path + ".partial")
+            else:
+                with open(path + ".partial", "wb") as f:
+                    f.write(data)
+            os.replace(path + ".partial", path)
+            self.store.remember(path, etag)
+        if copy_source:
+            xml = f"<?xml version=\"1.0\"?><CopyObjectResult><ETag>{etag}</ETag></CopyObjectResult>"
+            return self.reply(200, xml.encode(), {"Content-Type": "application/xml"})
+        self.reply(200, b"", {"ETag": etag})
+
+    def precondition_met(self, path):
+        if_match = self.headers.get("If-Match")
+        if_none_match = self.headers.get("If-None-Match")
+        if not if_match and if_none_match != "*":
+            return True
+        try:
+            current = self.store.etag(path)
+        except OSError:
+            current = None
+        if if_none_match == "*":
+            return current is None
+        return current is not None and current.strip('"') == if_match.strip('"')
+
+    def do_POST(self):
+        bucket, key, query = self.parse()
+        data = self.body()
+
+        if "uploads" in query:
+            upload_id = uuid.uuid4().hex
+            os.makedirs(self.store.upload_dir(upload_id))
+            with self.store.lock:
+                self.store.uploads[upload_id] = (bucket, key)
+            xml = (f"<?xml version=\"1.0\"?><InitiateMultipartUploadResult><Bucket>{bucket}</Bucket>"
+                   f"<Key>{key}</Key><UploadId>{upload_id}</UploadId></InitiateMultipartUploadResult>")
+            return self.reply(200, xml.encode(), {"Content-Type": "application/xml"})
+
+        if "uploadId" not in query:
+            return self.error(400, "InvalidRequest")
+
+        upload_id = query["uploadId"][0]
+        with self.store.lock:
+            target = self.store.uploads.pop(upload_id, None)
+        if target is None:
+            return self.error(404, "NoSuchUpload")
+
+        # Las partes se concatenan en el orden del XML y cada ETag tiene que coincidir
+        directory = self.store.upload_dir(upload_id)
+        parts = re.findall(rb"<PartNumber>(\d+)</PartNumber>\s*<ETag>\"?([0-9a-f]+)\"?</ETag>", data)
+        digests = b""
+        path = self.store.object_path(*target)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path + ".partial", "wb") as out:
+            for number, etag in parts:
+                with open(os.path.join(directory, f"{int(number):05d}"), "rb") as f:
+                    chunk = f.read()
+                digest = hashlib.md5(chunk)
+                if digest.hexdigest().encode() != etag:
+                    shutil.rmtree(directory, ignore_errors=True)
+                    os.unlink(path + ".partial")
+                    return self.error(400, "InvalidPart")
+                digests += digest.digest()
+                out.write(chunk)
+        os.replace(path + ".partial", path)
+        shutil.rmtree(directory, ignore_errors=True)
+
+        etag = f"\"{hashlib.md5(digests).hexdigest()}-{len(parts)}\""
+        self.store.remember(path, etag)
+        xml = (f"<?xml version=\"1.0\"?><CompleteMultipartUploadResult><Bucket>{target[0]}</Bucket>"
+               f"<Key>{target[1]}</Key><ETag>{etag}</ETag></CompleteMultipartUploadResult>")
+        self.reply(200, xml.encode(), {"Content-Type": "application/xml"})
+
+    def do_DELETE(self):
+        bucket, key, query = self.parse()
+        self.body()
+        if "uploadId" in query:
+            upload_id = query["uploadId"][0]
+            with self.store.lock:
+                self.store.uploads.pop(upload_id, None)
+            shutil.rmtree(self.store.upload_dir(upload_id), ignore_errors=True)
+            return self.reply(204)
+        try:
+            os.unlink(self.store.object_path(bucket, key))
+        except (OSError, ValueError):
+            pass
+        self.reply(204)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="S3 local para pruebas de process_video")
+    parser.add_argument("--port", type=int, default=9000)
+    parser.add_argument("--root", default="/tmp/fake_s3")
+    parser.add_argument("--latency-ms", type=float, default=0.0)
+    args = parser.parse_args()
+
+    os.makedirs(os.path.join(args.root, ".uploads"), exist_ok=True)
+    Handler.store = Store(args.root)
+    Handler.latency = args.latency_ms / 1000.0
+    server = ThreadingHTTPServer(("0.0.0.0", args.port), Handler)
+    print(f"fake_s3 escuchando en :{args.port}, objetos en {args.root}", flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
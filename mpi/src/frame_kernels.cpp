@@ -0,0 +1,533 @@
+#include <atomic>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+#include "frame_kernels.h"
+
+/*
+ * Punto fijo comun a todas las versiones:
+ * - escalado: pesos de 7 bits; la pasada horizontal deja cada fila en Q7
+ *   (int16) y la vertical interpola con la semantica de _mm_mulhrs_epi16
+ * - brillo/contraste: contraste en Q11 sobre (y - 128) << 4, tambien mulhrs
+ * - YUV->BGR: coeficientes BT.601 en Q13 y aritmetica de 32 bits
+ */
+#define SCALE_BITS 7
+#define CONTRAST_BITS 11
+#define BGR_BITS 13
+
+// BT.601 rango limitado, los mismos que usa OpenCV para COLOR_YUV2BGR_I420
+#define BGR_CY 9539    // 1.164383
+#define BGR_CRV 13075  // 1.596027
+#define BGR_CGU -3209  // -0.391762
+#define BGR_CGV -6660  // -0.812968
+#define BGR_CBU 16525  // 2.017232
+
+typedef struct {
+    const char *name;
+    // dst[i] en Q7 a partir de src[idx[i]] y src[idx[i] + 1]; weights = w0 | w1 << 16
+    void (*hscale_row)(const uint8_t *src, const int32_t *idx, const int32_t *weights, int16_t *dst, int n);
+    void (*vblend_row)(const int16_t *h0, const int16_t *h1, int fy, uint8_t *dst, int n);
+    void (*adjust_row)(const uint8_t *src, uint8_t *dst, int n, int contrast_q, int offset);
+    void (*bgr_row)(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *bgr, int n);
+} FrameKernels;
+
+static inline uint8_t clamp_u8(int v) {
+    return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static inline int mulhrs(int a, int b) {
+    return (a * b + (1 << 14)) >> 15;
+}
+
+// Mascaras pshufb que intercalan 16 B, 16 G y 16 R en 48 bytes BGR: [bloque][canal][byte]
+static int8_t bgr_masks[3][3][16];
+
+static void init_bgr_masks(void) {
+    for (int block = 0; block < 3; block++) {
+        for (int k = 0; k < 16; k++) {
+            int pixel = (16 * block + k) / 3;
+            int channel = (16 * block + k) % 3;
+            for (int c = 0; c < 3; c++) {
+                bgr_masks[block][c][k] = (int8_t)(c == channel ? pixel : -128);
+            }
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- escalar */
+
+static void hscale_row_scalar(const uint8_t *src, const int32_t *idx, const int32_t *weights, int16_t *dst, int n) {
+    for (int i = 0; i < n; i++) {
+        int w0 = weights[i] & 0xffff;
+        int w1 = weights[i] >> 16;
+        // w1 == 0 en el borde derecho: src[idx + 1] puede estar fuera de la fila
+        int p1 = w1 ? src[idx[i] + 1] : 0;
+        dst[i] = (int16_t)(src[idx[i]] * w0 + p1 * w1);
+    }
+}
+
+static void vblend_row_scalar(const int16_t *h0, const int16_t *h1, int fy, uint8_t *dst, int n) {
+    int f = fy << 8;
+    for (int i = 0; i < n; i++) {
+        int v = h0[i] + mulhrs(h1[i] - h0[i], f);
+        dst[i] = clamp_u8((v + (1 << (SCALE_BITS - 1))) >> SCALE_BITS);
+    }
+}
+
+static void adjust_row_scalar(const uint8_t *src, uint8_t *dst, int n, int contrast_q, int offset) {
+    for (int i = 0; i < n; i++) {
+        dst[i] = clamp_u8(mulhrs((src[i] - 128) * 16, contrast_q) + offset);
+    }
+}
+
+static inline void bgr_pixel(int y, int u, int v, uint8_t *out) {
+    int yterm = BGR_CY * (y - 16) + (1 << (BGR_BITS - 1));
+    u -= 128;
+    v -= 128;
+    out[0] = clamp_u8((yterm + BGR_CBU * u) >> BGR_BITS);
+    out[1] = clamp_u8((yterm + BGR_CGU * u + BGR_CGV * v) >> BGR_BITS);
+    out[2] = clamp_u8((yterm + BGR_CRV * v) >> BGR_BITS);
+}
+
+static void bgr_row_scalar(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *bgr, int n) {
+    for (int i = 0; i < n; i++) {
+        bgr_pixel(y[i], u[i >> 1], v[i >> 1], bgr + 3 * i);
+    }
+}
+
+/* ------------------------------------------------------------------- AVX2 */
+
+__attribute__((target("avx2")))
+static void hscale_row_avx2(const uint8_t *src, const int32_t *idx, const int32_t *weights, int16_t *dst, int n) {
+    const __m256i lo_byte = _mm256_set1_epi32(0xff);
+    const __m256i hi_byte = _mm256_set1_epi32(0xff00);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i r[2];
+        for (int k = 0; k < 2; k++) {
+            // 4 bytes desde src[idx]: los dos primeros son p0 y p1; pasan a pares de 16 bits para madd
+            __m256i g = _mm256_i32gather_epi32((const int *)src,
+                                               _mm256_loadu_si256((const __m256i *)(idx + i + 8 * k)), 1);
+            __m256i pairs = _mm256_or_si256(_mm256_and_si256(g, lo_byte),
+                                            _mm256_slli_epi32(_mm256_and_si256(g, hi_byte), 8));
+            r[k] = _mm256_madd_epi16(pairs, _mm256_loadu_si256((const __m256i *)(weights + i + 8 * k)));
+        }
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[0], r[1]), 0xD8);
+        _mm256_storeu_si256((__m256i *)(dst + i), packed);
+    }
+    hscale_row_scalar(src, idx + i, weights + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i vblend16_avx2(const int16_t *h0, const int16_t *h1, __m256i f) {
+    const __m256i round = _mm256_set1_epi16(1 << (SCALE_BITS - 1));
+    __m256i a = _mm256_loadu_si256((const __m256i *)h0);
+    __m256i b = _mm256_loadu_si256((const __m256i *)h1);
+    __m256i v = _mm256_add_epi16(a, _mm256_mulhrs_epi16(_mm256_sub_epi16(b, a), f));
+    return _mm256_srai_epi16(_mm256_add_epi16(v, round), SCALE_BITS);
+}
+
+__attribute__((target("avx2")))
+static void vblend_row_avx2(const int16_t *h0, const int16_t *h1, int fy, uint8_t *dst, int n) {
+    const __m256i f = _mm256_set1_epi16((short)(fy << 8));
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = vblend16_avx2(h0 + i, h1 + i, f);
+        __m256i b = vblend16_avx2(h0 + i + 16, h1 + i + 16, f);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+    vblend_row_scalar(h0 + i, h1 + i, fy, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i adjust16_avx2(__m128i bytes, __m256i contrast, __m256i offset) {
+    __m256i d = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(bytes), _mm256_set1_epi16(128)), 4);
+    return _mm256_adds_epi16(_mm256_mulhrs_epi16(d, contrast), offset);
+}
+
+__attribute__((target("avx2")))
+static void adjust_row_avx2(const uint8_t *src, uint8_t *dst, int n, int contrast_q, int offset) {
+    const __m256i contrast = _mm256_set1_epi16((short)contrast_q);
+    const __m256i off = _mm256_set1_epi16((short)offset);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = adjust16_avx2(_mm_loadu_si128((const __m128i *)(src + i)), contrast, off);
+        __m256i b = adjust16_avx2(_mm_loadu_si128((const __m128i *)(src + i + 16)), contrast, off);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+    adjust_row_scalar(src + i, dst + i, n - i, contrast_q, offset);
+}
+
+// Un canal de 16 pixeles: (yterm + cu * u + cv * v) >> 13 saturado a bytes
+__attribute__((target("avx2")))
+static inline __m128i bgr_channel_avx2(const __m256i yterm[2], const __m256i u[2], const __m256i v[2],
+                                       int cu, int cv) {
+    __m256i r[2];
+    for (int k = 0; k < 2; k++) {
+        __m256i acc = yterm[k];
+        if (cu) {
+            acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(u[k], _mm256_set1_epi32(cu)));
+        }
+        if (cv) {
+            acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(v[k], _mm256_set1_epi32(cv)));
+        }
+        r[k] = _mm256_srai_epi32(acc, BGR_BITS);
+    }
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[0], r[1]), 0xD8);
+    return _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+}
+
+__attribute__((target("avx2")))
+static void bgr_row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *bgr, int n) {
+    const __m256i y_offset = _mm256_set1_epi32(16);
+    const __m256i uv_offset = _mm256_set1_epi32(128);
+    const __m256i cy = _mm256_set1_epi32(BGR_CY);
+    const __m256i round = _mm256_set1_epi32(1 << (BGR_BITS - 1));
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i yb = _mm_loadu_si128((const __m128i *)(y + i));
+        // 8 muestras de croma duplicadas: una por pixel
+        __m128i ub = _mm_loadl_epi64((const __m128i *)(u + i / 2));
+        __m128i vb = _mm_loadl_epi64((const __m128i *)(v + i / 2));
+        ub = _mm_unpacklo_epi8(ub, ub);
+        vb = _mm_unpacklo_epi8(vb, vb);
+
+        // Pixeles 0-7 y 8-15 en 32 bits
+        __m128i yh[2] = {yb, _mm_srli_si128(yb, 8)};
+        __m128i uh[2] = {ub, _mm_srli_si128(ub, 8)};
+        __m128i vh[2] = {vb, _mm_srli_si128(vb, 8)};
+        __m256i yterm[2], uw[2], vw[2];
+        for (int k = 0; k < 2; k++) {
+            __m256i yw = _mm256_sub_epi32(_mm256_cvtepu8_epi32(yh[k]), y_offset);
+            yterm[k] = _mm256_add_epi32(_mm256_mullo_epi32(yw, cy), round);
+            uw[k] = _mm256_sub_epi32(_mm256_cvtepu8_epi32(uh[k]), uv_offset);
+            vw[k] = _mm256_sub_epi32(_mm256_cvtepu8_epi32(vh[k]), uv_offset);
+        }
+        __m128i channels[3] = {
+            bgr_channel_avx2(yterm, uw, vw, BGR_CBU, 0),
+            bgr_channel_avx2(yterm, uw, vw, BGR_CGU, BGR_CGV),
+            bgr_channel_avx2(yterm, uw, vw, 0, BGR_CRV),
+        };
+        for (int block = 0; block < 3; block++) {
+            __m128i out = _mm_setzero_si128();
+            for (int c = 0; c < 3; c++) {
+                out = _mm_or_si128(out, _mm_shuffle_epi8(channels[c],
+                                                         _mm_loadu_si128((const __m128i *)bgr_masks[block][c])));
+            }
+            _mm_storeu_si128((__m128i *)(bgr + 3 * i + 16 * block), out);
+        }
+    }
+    bgr_row_scalar(y + i, u + i / 2, v + i / 2, bgr + 3 * i, n - i);
+}
+
+/* -------------------------------------------------------------- AVX-512BW */
+
+__attribute__((target("avx512f,avx512bw")))
+static void hscale_row_avx512(const uint8_t *src, const int32_t *idx, const int32_t *weights, int16_t *dst, int n) {
+    const __m512i lo_byte = _mm512_set1_epi32(0xff);
+    const __m512i hi_byte = _mm512_set1_epi32(0xff00);
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512i r[2];
+        for (int k = 0; k < 2; k++) {
+            __m512i g = _mm512_i32gather_epi32(_mm512_loadu_si512(idx + i + 16 * k), src, 1);
+            __m512i pairs = _mm512_or_si512(_mm512_and_si512(g, lo_byte),
+                                            _mm512_slli_epi32(_mm512_and_si512(g, hi_byte), 8));
+            r[k] = _mm512_madd_epi16(pairs, _mm512_loadu_si512(weights + i + 16 * k));
+        }
+        _mm512_storeu_si512(dst + i, _mm512_permutexvar_epi64(order, _mm512_packs_epi32(r[0], r[1])));
+    }
+    hscale_row_avx2(src, idx + i, weights + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i vblend32_avx512(const int16_t *h0, const int16_t *h1, __m512i f) {
+    const __m512i round = _mm512_set1_epi16(1 << (SCALE_BITS - 1));
+    __m512i a = _mm512_loadu_si512(h0);
+    __m512i b = _mm512_loadu_si512(h1);
+    __m512i v = _mm512_add_epi16(a, _mm512_mulhrs_epi16(_mm512_sub_epi16(b, a), f));
+    return _mm512_srai_epi16(_mm512_add_epi16(v, round), SCALE_BITS);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void vblend_row_avx512(const int16_t *h0, const int16_t *h1, int fy, uint8_t *dst, int n) {
+    const __m512i f = _mm512_set1_epi16((short)(fy << 8));
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    int i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i a = vblend32_avx512(h0 + i, h1 + i, f);
+        __m512i b = vblend32_avx512(h0 + i + 32, h1 + i + 32, f);
+        _mm512_storeu_si512(dst + i, _mm512_permutexvar_epi64(order, _mm512_packus_epi16(a, b)));
+    }
+    vblend_row_avx2(h0 + i, h1 + i, fy, dst + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void adjust_row_avx512(const uint8_t *src, uint8_t *dst, int n, int contrast_q, int offset) {
+    const __m512i contrast = _mm512_set1_epi16((short)contrast_q);
+    const __m512i off = _mm512_set1_epi16((short)offset);
+    const __m512i bias = _mm512_set1_epi16(128);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512i y = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(src + i)));
+        __m512i d = _mm512_slli_epi16(_mm512_sub_epi16(y, bias), 4);
+        __m512i r = _mm512_adds_epi16(_mm512_mulhrs_epi16(d, contrast), off);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm512_cvtusepi16_epi8(_mm512_max_epi16(r, _mm512_setzero_si512())));
+    }
+    adjust_row_avx2(src + i, dst + i, n - i, contrast_q, offset);
+}
+
+static const FrameKernels scalar_kernels = {
+    "scalar", hscale_row_scalar, vblend_row_scalar, adjust_row_scalar, bgr_row_scalar,
+};
+
+static const FrameKernels avx2_kernels = {
+    "avx2", hscale_row_avx2, vblend_row_avx2, adjust_row_avx2, bgr_row_avx2,
+};
+
+// La conversion a BGR esta limitada por el intercalado de 3 canales: AVX-512 no aporta
+static const FrameKernels avx512_kernels = {
+    "avx512", hscale_row_avx512, vblend_row_avx512, adjust_row_avx512, bgr_row_avx2,
+};
+
+static const FrameKernels *kernels_for(const char *isa) {
+    __builtin_cpu_init();
+    int avx2 = __builtin_cpu_supports("avx2");
+    int avx512 = avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+
+    if (!isa || !isa[0]) {
+        return avx512 ? &avx512_kernels : avx2 ? &avx2_kernels : &scalar_kernels;
+    }
+    if (strcmp(isa, "scalar") == 0) {
+        return &scalar_kernels;
+    }
+    if (strcmp(isa, "avx2") == 0 && avx2) {
+        return &avx2_kernels;
+    }
+    if (strcmp(isa, "avx512") == 0 && avx512) {
+        return &avx512_kernels;
+    }
+    return NULL;
+}
+
+// Eleccion por defecto (CPU + DVP_SIMD), una sola vez; frame_kernels_select la reemplaza
+static const FrameKernels *default_kernels(void) {
+    static const FrameKernels *k = [] {
+        init_bgr_masks();
+        const FrameKernels *chosen = kernels_for(getenv("DVP_SIMD"));
+        return chosen ? chosen : kernels_for(NULL);
+    }();
+    return k;
+}
+
+static std::atomic<const FrameKernels *> selected_kernels(NULL);
+
+static const FrameKernels *kernels(void) {
+    const FrameKernels *k = selected_kernels.load(std::memory_order_acquire);
+    return k ? k : default_kernels();
+}
+
+extern "C" const char *frame_kernels_isa(void) {
+    return kernels()->name;
+}
+
+extern "C" int frame_kernels_select(const char *isa) {
+    default_kernels();
+    const FrameKernels *k = kernels_for(isa);
+    if (!k) {
+        return 0;
+    }
+    selected_kernels.store(k, std::memory_order_release);
+    return 1;
+}
+
+/* ------------------------------------------------------------ operaciones */
+
+extern "C" void yuv420_crop(const Yuv420Planes *src, int x, int y, int width, int height, Yuv420Planes *dst) {
+    x &= ~1;
+    y &= ~1;
+    dst->data[0] = src->data[0] + (size_t)y * src->linesize[0] + x;
+    dst->data[1] = src->data[1] + (size_t)(y / 2) * src->linesize[1] + x / 2;
+    dst->data[2] = src->data[2] + (size_t)(y / 2) * src->linesize[2] + x / 2;
+    for (int p = 0; p < 3; p++) {
+        dst->linesize[p] = src->linesize[p];
+    }
+    dst->width = width;
+    dst->height = height;
+}
+
+// Posicion en Q7 del pixel de origen que corresponde al centro del pixel i de destino
+static void scale_position(int i, int src_size, int dst_size, int *index, int *frac) {
+    int64_t pos = ((int64_t)(2 * i + 1) * src_size << SCALE_BITS) / (2 * dst_size) - (1 << (SCALE_BITS - 1));
+    if (pos < 0) {
+        pos = 0;
+    }
+    *index = (int)(pos >> SCALE_BITS);
+    *frac = (int)(pos & ((1 << SCALE_BITS) - 1));
+    if (*index >= src_size - 1) {
+        *index = src_size - 1;
+        *frac = 0;
+    }
+}
+
+/*
+ * Plan de escalado de un plano: indices y pesos de cada columna y fila de
+ * destino, y las dos filas intermedias en Q7. Se calcula una vez por
+ * geometria; escalar un frame no reserva memoria.
+ */
+typedef struct {
+    int src_w, src_h, dst_w, dst_h;
+    int32_t *idx;      // columna de origen de cada columna de destino
+    int32_t *weights;  // w0 | w1 << 16
+    int simd_n;        // columnas con margen para los gathers de 4 bytes
+    int32_t *row_idx;  // fila de origen de cada fila de destino
+    int32_t *row_frac;
+    int16_t *rows[2];
+} ScalePlan;
+
+struct Yuv420Scaler {
+    ScalePlan planes[3];
+};
+
+static int init_scale_plan(ScalePlan *plan, int src_w, int src_h, int dst_w, int dst_h) {
+    plan->src_w = src_w;
+    plan->src_h = src_h;
+    plan->dst_w = dst_w;
+    plan->dst_h = dst_h;
+    plan->idx = (int32_t *)malloc(sizeof(int32_t) * (2 * dst_w + 2 * dst_h) + sizeof(int16_t) * 2 * dst_w);
+    if (!plan->idx) {
+        return 0;
+    }
+    plan->weights = plan->idx + dst_w;
+    plan->row_idx = plan->weights + dst_w;
+    plan->row_frac = plan->row_idx + dst_h;
+    plan->rows[0] = (int16_t *)(plan->row_frac + dst_h);
+    plan->rows[1] = plan->rows[0] + dst_w;
+
+    plan->simd_n = 0;
+    for (int x = 0; x < dst_w; x++) {
+        int frac;
+        scale_position(x, src_w, dst_w, &plan->idx[x], &frac);
+        plan->weights[x] = ((1 << SCALE_BITS) - frac) | (frac << 16);
+        if (plan->idx[x] + 4 <= src_w) {
+            plan->simd_n = x + 1;
+        }
+    }
+    for (int y = 0; y < dst_h; y++) {
+        scale_position(y, src_h, dst_h, &plan->row_idx[y], &plan->row_frac[y]);
+    }
+    return 1;
+}
+
+static void scale_plane(const FrameKernels *k, ScalePlan *plan, const uint8_t *src, int src_linesize,
+                        uint8_t *dst, int dst_linesize) {
+    int16_t *row_buf[2] = {plan->rows[0], plan->rows[1]};
+    int row_src[2] = {-1, -1};
+    int simd_n = plan->simd_n;
+    int dst_w = plan->dst_w;
+
+    for (int y = 0; y < plan->dst_h; y++) {
+        int sy = plan->row_idx[y];
+        int fy = plan->row_frac[y];
+        int needed[2] = {sy, (fy && sy + 1 < plan->src_h) ? sy + 1 : sy};
+
+        // Al avanzar una fila de origen, la segunda fila anterior pasa a ser la primera
+        if (row_src[0] != sy && row_src[1] == sy) {
+            int16_t *tmp = row_buf[0];
+            row_buf[0] = row_buf[1];
+            row_buf[1] = tmp;
+            row_src[0] = sy;
+            row_src[1] = -1;
+        }
+        for (int r = 0; r < 2; r++) {
+            if (row_src[r] != needed[r]) {
+                const uint8_t *line = src + (size_t)needed[r] * src_linesize;
+                k->hscale_row(line, plan->idx, plan->weights, row_buf[r], simd_n);
+                hscale_row_scalar(line, plan->idx + simd_n, plan->weights + simd_n, row_buf[r] + simd_n,
+                                  dst_w - simd_n);
+                row_src[r] = needed[r];
+            }
+        }
+        k->vblend_row(row_buf[0], row_buf[1], fy, dst + (size_t)y * dst_linesize, dst_w);
+    }
+}
+
+extern "C" Yuv420Scaler *yuv420_scaler_alloc(int src_width, int src_height, int dst_width, int dst_height) {
+    Yuv420Scaler *scaler = (Yuv420Scaler *)calloc(1, sizeof(Yuv420Scaler));
+    if (!scaler) {
+        return NULL;
+    }
+    for (int p = 0; p < 3; p++) {
+        int shift = (p > 0);
+        if (!init_scale_plan(&scaler->planes[p], (src_width + shift) >> shift, (src_height + shift) >> shift,
+                             (dst_width + shift) >> shift, (dst_height + shift) >> shift)) {
+            yuv420_scaler_free(&scaler);
+            return NULL;
+        }
+    }
+    return scaler;
+}
+
+extern "C" int yuv420_scaler_matches(const Yuv420Scaler *scaler, const Yuv420Planes *src, const Yuv420Planes *dst) {
+    const ScalePlan *luma = &scaler->planes[0];
+    return luma->src_w == src->width && luma->src_h == src->height &&
+           luma->dst_w == dst->width && luma->dst_h == dst->height;
+}
+
+extern "C" void yuv420_scaler_run(Yuv420Scaler *scaler, const Yuv420Planes *src, const Yuv420Planes *dst) {
+    const FrameKernels *k = kernels();
+    for (int p = 0; p < 3; p++) {
+        scale_plane(k, &scaler->planes[p], src->data[p], src->linesize[p], dst->data[p], dst->linesize[p]);
+    }
+}
+
+extern "C" void yuv420_scaler_free(Yuv420Scaler **scaler) {
+    if (!*scaler) {
+        return;
+    }
+    for (int p = 0; p < 3; p++) {
+        free((*scaler)->planes[p].idx);
+    }
+    free(*scaler);
+    *scaler = NULL;
+}
+
+extern "C" int yuv420_scale(const Yuv420Planes *src, const Yuv420Planes *dst) {
+    Yuv420Scaler *scaler = yuv420_scaler_alloc(src->width, src->height, dst->width, dst->height);
+    if (!scaler) {
+        return 0;
+    }
+    yuv420_scaler_run(scaler, src, dst);
+    yuv420_scaler_free(&scaler);
+    return 1;
+}
+
+extern "C" void yuv420_adjust(const Yuv420Planes *src, const Yuv420Planes *dst, int brightness, double contrast) {
+    const FrameKernels *k = kernels();
+    int contrast_q = (int)lrint((contrast < 0 ? 0 : contrast > 4 ? 4 : contrast) * (1 << CONTRAST_BITS));
+    int offset = 128 + (brightness < -255 ? -255 : brightness > 255 ? 255 : brightness);
+    for (int y = 0; y < src->height; y++) {
+        k->adjust_row(src->data[0] + (size_t)y * src->linesize[0], dst->data[0] + (size_t)y * dst->linesize[0],
+                      src->width, contrast_q, offset);
+    }
+
+    // Fuera del lugar el croma se copia tal cual
+    for (int p = 1; p < 3 && src->data[p] != dst->data[p]; p++) {
+        for (int y = 0; y < (src->height + 1) / 2; y++) {
+            memcpy(dst->data[p] + (size_t)y * dst->linesize[p], src->data[p] + (size_t)y * src->linesize[p],
+                   (src->width + 1) / 2);
+        }
+    }
+}
+
+extern "C" void yuv420_to_bgr(const Yuv420Planes *src, uint8_t *bgr, int bgr_linesize) {
+    const FrameKernels *k = kernels();
+    for (int y = 0; y < src->height; y++) {
+        k->bgr_row(src->data[0] + (size_t)y * src->linesize[0],
+                   src->data[1] + (size_t)(y / 2) * src->linesize[1],
+                   src->data[2] + (size_t)(y / 2) * src->linesize[2],
+                   bgr + (size_t)y * bgr_linesize, src->width);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef FRAME_KERNELS_H
+#define FRAME_KERNELS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Kernels de pixel sobre los planos YUV420 de 8 bits que entrega el decoder,
+ * sin pasar por BGR. Cada kernel tiene version escalar, AVX2 y (salvo la
+ * conversion a BGR) AVX-512BW; la mejor que soporta la CPU se elige una vez
+ * en tiempo de ejecucion. Todas las versiones usan la misma aritmetica de
+ * punto fijo y dan el mismo resultado bit a bit.
+ */
+typedef struct {
+    uint8_t *data[3];  // Y, U, V
+    int linesize[3];
+    int width;         // de la luma; el croma mide (width + 1) / 2 x (height + 1) / 2
+    int height;
+} Yuv420Planes;
+
+// Vista de la region [x, x + width) x [y, y + height) sin copiar; x e y se redondean a par
+void yuv420_crop(const Yuv420Planes *src, int x, int y, int width, int height, Yuv420Planes *dst);
+
+/*
+ * Escalado bilineal de los tres planos. El scaler guarda indices, pesos y
+ * filas intermedias de una geometria: se crea una vez y cada frame se escala
+ * sin reservar memoria. yuv420_scale hace todo en una llamada; devuelve 0 si
+ * falta memoria.
+ */
+typedef struct Yuv420Scaler Yuv420Scaler;
+
+Yuv420Scaler *yuv420_scaler_alloc(int src_width, int src_height, int dst_width, int dst_height);
+int yuv420_scaler_matches(const Yuv420Scaler *scaler, const Yuv420Planes *src, const Yuv420Planes *dst);
+void yuv420_scaler_run(Yuv420Scaler *scaler, const Yuv420Planes *src, const Yuv420Planes *dst);
+void yuv420_scaler_free(Yuv420Scaler **scaler);
+int yuv420_scale(const Yuv420Planes *src, const Yuv420Planes *dst);
+
+/*
+ * Brillo/contraste sobre la luma: y' = (y - 128) * contrast + 128 +
+ * brightness, saturado a [0, 255]. contrast en [0, 4], brightness en
+ * [-255, 255]. Con src == dst trabaja en el lugar; si no, copia el croma.
+ */
+void yuv420_adjust(const Yuv420Planes *src, const Yuv420Planes *dst, int brightness, double contrast);
+
+// BT.601 rango limitado a BGR24 empaquetado, como cv::COLOR_YUV2BGR_I420
+void yuv420_to_bgr(const Yuv420Planes *src, uint8_t *bgr, int bgr_linesize);
+
+/*
+ * Juego de instrucciones en uso: "avx512", "avx2" o "scalar". DVP_SIMD con
+ * uno de esos valores fuerza la eleccion (si la CPU no lo tiene se ignora).
+ * frame_kernels_select hace lo mismo en caliente (NULL: el mejor disponible);
+ * devuelve 0 si el nombre no existe o la CPU no lo soporta.
+ */
+const char *frame_kernels_isa(void);
+int frame_kernels_select(const char *isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,279 @@
+#include <atomic>
+#include <new>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "frame_pipeline.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#define PIPELINE_STOP -1
+
+/*
+ * Ring MPMC acotado sin locks (Vyukov): cada celda lleva un numero de
+ * secuencia que dice si esta libre para la vuelta actual del productor o ya
+ * tiene dato para el consumidor. Los semaforos de afuera garantizan que nunca
+ * se llena ni se lee vacio, asi que push y pop no reintentan por eso.
+ */
+typedef struct {
+    std::atomic<int64_t> sequence;
+    int64_t value;
+} RingCell;
+
+typedef struct {
+    RingCell *cells;
+    int64_t mask;
+    std::atomic<int64_t> head;  // proxima celda a escribir
+    std::atomic<int64_t> tail;  // proxima celda a leer
+} FrameRing;
+
+typedef struct {
+    AVFrame *decoded;
+    AVFrame *processed;
+    AVFrame *out;
+    int eos;
+    sem_t ready;  // el worker termino con el slot (o es el fin del stream)
+} PipelineSlot;
+
+typedef struct {
+    FramePipeline *pipeline;
+    int index;
+} WorkerArgs;
+
+struct FramePipeline {
+    PipelineProcess process;
+    PipelineConsume consume;
+    void *opaque;
+    int workers;
+    int window;
+    PipelineSlot *slots;
+    FrameRing ring;
+    sem_t items;     // entradas en el ring
+    sem_t free_slots;  // ventana: frames que todavia pueden entrar
+    int64_t next_seq;  // solo lo usa el thread que decodifica
+    std::atomic<int> failed;
+    pthread_t *worker_threads;
+    WorkerArgs *worker_args;
+    pthread_t encoder_thread;
+    int started_workers;
+    int encoder_started;
+};
+
+static int ring_init(FrameRing *ring, int min_capacity) {
+    int64_t capacity = 1;
+    while (capacity < min_capacity) {
+        capacity <<= 1;
+    }
+    ring->cells = new (std::nothrow) RingCell[capacity];
+    if (!ring->cells) {
+        return 0;
+    }
+    for (int64_t i = 0; i < capacity; i++) {
+        ring->cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    ring->mask = capacity - 1;
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+    return 1;
+}
+
+static void ring_push(FrameRing *ring, int64_t value) {
+    int64_t pos = ring->head.load(std::memory_order_relaxed);
+    for (;;) {
+        RingCell *cell = &ring->cells[pos & ring->mask];
+        int64_t diff = cell->sequence.load(std::memory_order_acquire) - pos;
+        if (diff == 0 && ring->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            cell->value = value;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return;
+        }
+        if (diff != 0) {
+            pos = ring->head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static int64_t ring_pop(FrameRing *ring) {
+    int64_t pos = ring->tail.load(std::memory_order_relaxed);
+    for (;;) {
+        RingCell *cell = &ring->cells[pos & ring->mask];
+        int64_t diff = cell->sequence.load(std::memory_order_acquire) - (pos + 1);
+        if (diff == 0 && ring->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            int64_t value = cell->value;
+            cell->sequence.store(pos + ring->mask + 1, std::memory_order_release);
+            return value;
+        }
+        if (diff != 0) {
+            pos = ring->tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// sem_wait reintentando si lo interrumpe una senal
+static void wait_sem(sem_t *sem) {
+    while (sem_wait(sem) != 0) {
+    }
+}
+
+static void *worker_main(void *arg) {
+    WorkerArgs *args = (WorkerArgs *)arg;
+    FramePipeline *p = args->pipeline;
+
+    for (;;) {
+        wait_sem(&p->items);
+        int64_t seq = ring_pop(&p->ring);
+        if (seq == PIPELINE_STOP) {
+            break;
+        }
+        PipelineSlot *slot = &p->slots[seq % p->window];
+        slot->out = NULL;
+        // Tras un fallo se sigue vaciando el ring para que nadie quede bloqueado
+        if (!p->failed.load(std::memory_order_relaxed) &&
+            !p->process(p->opaque, args->index, slot->decoded, slot->processed, &slot->out)) {
+            p->failed.store(1, std::memory_order_relaxed);
+        }
+        sem_post(&slot->ready);
+    }
+    return NULL;
+}
+
+static void *encoder_main(void *arg) {
+    FramePipeline *p = (FramePipeline *)arg;
+
+    for (int64_t seq = 0;; seq++) {
+        PipelineSlot *slot = &p->slots[seq % p->window];
+        wait_sem(&slot->ready);
+        if (slot->eos) {
+            break;
+        }
+        if (!p->failed.load(std::memory_order_relaxed) && slot->out && !p->consume(p->opaque, slot->out)) {
+            p->failed.store(1, std::memory_order_relaxed);
+        }
+        av_frame_unref(slot->decoded);
+        av_frame_unref(slot->processed);
+        sem_post(&p->free_slots);
+    }
+    return NULL;
+}
+
+static void pipeline_free(FramePipeline *p) {
+    if (p->slots) {
+        for (int i = 0; i < p->window; i++) {
+            av_frame_free(&p->slots[i].decoded);
+            av_frame_free(&p->slots[i].processed);
+            sem_destroy(&p->slots[i].ready);
+        }
+    }
+    sem_destroy(&p->items);
+    sem_destroy(&p->free_slots);
+    delete[] p->ring.cells;
+    free(p->slots);
+    free(p->worker_threads);
+    free(p->worker_args);
+    delete p;
+}
+
+// Toma un lugar de la ventana y devuelve su slot
+static PipelineSlot *acquire_slot(FramePipeline *p) {
+    wait_sem(&p->free_slots);
+    return &p->slots[p->next_seq % p->window];
+}
+
+// Cierra el stream: fin para el encoder y una parada por worker
+static void stop_threads(FramePipeline *p) {
+    if (p->encoder_started) {
+        PipelineSlot *slot = acquire_slot(p);
+        slot->eos = 1;
+        p->next_seq++;
+        sem_post(&slot->ready);
+    }
+    for (int i = 0; i < p->started_workers; i++) {
+        ring_push(&p->ring, PIPELINE_STOP);
+        sem_post(&p->items);
+    }
+    for (int i = 0; i < p->started_workers; i++) {
+        pthread_join(p->worker_threads[i], NULL);
+    }
+    if (p->encoder_started) {
+        pthread_join(p->encoder_thread, NULL);
+    }
+}
+
+FramePipeline *frame_pipeline_start(int workers, int window, PipelineProcess process,
+                                    PipelineConsume consume, void *opaque) {
+    FramePipeline *p = new (std::nothrow) FramePipeline();
+    if (!p) {
+        return NULL;
+    }
+    p->process = process;
+    p->consume = consume;
+    p->opaque = opaque;
+    p->workers = workers;
+    p->window = window;
+    p->failed.store(0);
+    sem_init(&p->items, 0, 0);
+    sem_init(&p->free_slots, 0, window);
+
+    // La ventana acota los frames en el ring; las paradas de los workers ocupan el resto
+    p->slots = (PipelineSlot *)calloc(window, sizeof(PipelineSlot));
+    p->worker_threads = (pthread_t *)calloc(workers, sizeof(pthread_t));
+    p->worker_args = (WorkerArgs *)calloc(workers, sizeof(WorkerArgs));
+    int ok = p->slots && p->worker_threads && p->worker_args && ring_init(&p->ring, window + workers);
+    for (int i = 0; ok && i < window; i++) {
+        sem_init(&p->slots[i].ready, 0, 0);
+        p->slots[i].decoded = av_frame_alloc();
+        p->slots[i].processed = av_frame_alloc();
+        ok = p->slots[i].decoded && p->slots[i].processed;
+    }
+    if (!ok) {
+        // Los slots sin inicializar quedaron en cero: av_frame_free y sem_destroy no los tocan
+        window = p->slots ? window : 0;
+        p->window = window;
+        pipeline_free(p);
+        return NULL;
+    }
+
+    p->encoder_started = pthread_create(&p->encoder_thread, NULL, encoder_main, p) == 0;
+    for (int i = 0; p->encoder_started && i < workers; i++) {
+        p->worker_args[i].pipeline = p;
+        p->worker_args[i].index = i;
+        if (pthread_create(&p->worker_threads[i], NULL, worker_main, &p->worker_args[i]) != 0) {
+            break;
+        }
+        p->started_workers++;
+    }
+    if (!p->encoder_started || p->started_workers == 0) {
+        fprintf(stderr, "Error: No se pudieron crear los threads del pipeline\n");
+        stop_threads(p);
+        pipeline_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+int frame_pipeline_push(FramePipeline *p, AVFrame *frame) {
+    if (p->failed.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    PipelineSlot *slot = acquire_slot(p);
+    av_frame_move_ref(slot->decoded, frame);
+    slot->eos = 0;
+    ring_push(&p->ring, p->next_seq++);
+    sem_post(&p->items);
+    return 1;
+}
+
+int frame_pipeline_finish(FramePipeline **pipeline) {
+    FramePipeline *p = *pipeline;
+    *pipeline = NULL;
+    if (!p) {
+        return 1;
+    }
+    stop_threads(p);
+    int ok = !p->failed.load();
+    pipeline_free(p);
+    return ok;
+}
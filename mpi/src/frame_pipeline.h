@@ -0,0 +1,42 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pipeline de frames dentro de un rank: el thread que decodifica entrega
+ * frames con frame_pipeline_push, N workers los procesan en paralelo
+ * tomandolos de un ring acotado sin locks, y un thread de encoder los
+ * consume en el orden original. Una ventana de window frames en vuelo acota
+ * la memoria: push se bloquea hasta que el encoder libera un lugar.
+ */
+typedef struct FramePipeline FramePipeline;
+
+struct AVFrame;
+
+/*
+ * En un worker: procesa decoded y deja en *out el frame a codificar, que
+ * puede ser el mismo decoded o processed (un AVFrame vacio del slot).
+ */
+typedef int (*PipelineProcess)(void *opaque, int worker, struct AVFrame *decoded,
+                               struct AVFrame *processed, struct AVFrame **out);
+
+// En el thread del encoder, frame a frame en orden
+typedef int (*PipelineConsume)(void *opaque, struct AVFrame *frame);
+
+FramePipeline *frame_pipeline_start(int workers, int window, PipelineProcess process,
+                                    PipelineConsume consume, void *opaque);
+
+// Toma la referencia de frame. Devuelve 0 si alguna etapa ya fallo
+int frame_pipeline_push(FramePipeline *pipeline, struct AVFrame *frame);
+
+// Espera a que se consuma todo lo entregado y junta los threads. Devuelve 0 si algo fallo
+int frame_pipeline_finish(FramePipeline **pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
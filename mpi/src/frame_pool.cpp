@@ -0,0 +1,199 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "frame_pool.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+// Cada fila arranca alineada para los kernels AVX-512
+#define FRAME_POOL_ALIGN 64
+
+struct FramePool {
+    pthread_mutex_t mutex;
+    AVBufferPool *pool;  // NULL hasta el primer frame
+    int format;
+    int width;
+    int height;
+    int linesize[4];
+    size_t plane_offset[4];
+    size_t plane_size[4];
+    size_t size;
+    int capacity;
+    int allocated;       // buffers creados: el pool reusa uno libre antes de crear otro
+    int overflow;
+    char name[32];
+};
+
+FramePool *frame_pool_create(const char *name, int capacity) {
+    FramePool *pool = (FramePool *)av_mallocz(sizeof(FramePool));
+    if (!pool) {
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pool->format = AV_PIX_FMT_NONE;
+    pool->capacity = capacity;
+    snprintf(pool->name, sizeof(pool->name), "%s", name);
+    return pool;
+}
+
+static AVBufferRef *pool_alloc(void *opaque, size_t size) {
+    FramePool *pool = (FramePool *)opaque;
+    pthread_mutex_lock(&pool->mutex);
+    int full = pool->allocated >= pool->capacity;
+    if (!full) {
+        pool->allocated++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (full) {
+        return NULL;
+    }
+
+    AVBufferRef *buf = av_buffer_alloc(size);
+    if (!buf) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->allocated--;
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return buf;
+}
+
+// Lo llama libavutil cuando el pool ya fue liberado y vuelve su ultimo buffer
+static void pool_release(void *opaque) {
+    FramePool *pool = (FramePool *)opaque;
+    pthread_mutex_destroy(&pool->mutex);
+    av_free(pool);
+}
+
+/*
+ * Fija la geometria del pool a partir del primer frame. Con ctx (decoder) las
+ * dimensiones y los linesize se alinean como en avcodec_default_get_buffer2.
+ * Llamar con el mutex tomado.
+ */
+static int bind_geometry(FramePool *pool, const AVFrame *frame, AVCodecContext *ctx) {
+    int width = frame->width;
+    int height = frame->height;
+    int stride_align[AV_NUM_DATA_POINTERS];
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; i++) {
+        stride_align[i] = FRAME_POOL_ALIGN;
+    }
+    if (ctx) {
+        avcodec_align_dimensions2(ctx, &width, &height, stride_align);
+        for (int i = 0; i < AV_NUM_DATA_POINTERS; i++) {
+            stride_align[i] = FFMAX(stride_align[i], FRAME_POOL_ALIGN);
+        }
+    }
+
+    // Ensanchar hasta que todos los planos queden alineados
+    int unaligned;
+    do {
+        if (av_image_fill_linesizes(pool->linesize, (AVPixelFormat)frame->format, width) < 0) {
+            return 0;
+        }
+        width += width & ~(width - 1);
+        unaligned = 0;
+        for (int i = 0; i < 4; i++) {
+            unaligned |= pool->linesize[i] % stride_align[i];
+        }
+    } while (unaligned);
+
+    ptrdiff_t linesizes[4];
+    size_t sizes[4];
+    for (int i = 0; i < 4; i++) {
+        linesizes[i] = pool->linesize[i];
+    }
+    if (av_image_fill_plane_sizes(sizes, (AVPixelFormat)frame->format, height, linesizes) < 0) {
+        return 0;
+    }
+
+    pool->size = 0;
+    for (int i = 0; i < 4; i++) {
+        pool->plane_offset[i] = pool->size;
+        pool->plane_size[i] = sizes[i];
+        pool->size += FFALIGN(sizes[i], FRAME_POOL_ALIGN);
+    }
+    // Los decoders y los kernels SIMD pueden leer algunos bytes mas alla del ultimo plano
+    pool->size += AV_INPUT_BUFFER_PADDING_SIZE;
+
+    pool->pool = av_buffer_pool_init2(pool->size, pool, pool_alloc, pool_release);
+    if (!pool->pool) {
+        return 0;
+    }
+    pool->format = frame->format;
+    pool->width = frame->width;
+    pool->height = frame->height;
+    return 1;
+}
+
+// 1: frame servido desde el pool; 0: hay que reservarlo aparte
+static int take_buffer(FramePool *pool, AVFrame *frame, AVCodecContext *ctx) {
+    pthread_mutex_lock(&pool->mutex);
+    int usable = pool->pool ? 1 : bind_geometry(pool, frame, ctx);
+    usable = usable && frame->format == pool->format &&
+             frame->width == pool->width && frame->height == pool->height;
+    pthread_mutex_unlock(&pool->mutex);
+
+    AVBufferRef *buf = usable ? av_buffer_pool_get(pool->pool) : NULL;
+    if (!buf) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->overflow++;
+        pthread_mutex_unlock(&pool->mutex);
+        return 0;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        frame->data[i] = pool->plane_size[i] ? buf->data + pool->plane_offset[i] : NULL;
+        frame->linesize[i] = pool->linesize[i];
+    }
+    frame->buf[0] = buf;
+    frame->extended_data = frame->data;
+    return 1;
+}
+
+int frame_pool_get(FramePool *pool, AVFrame *frame) {
+    if (take_buffer(pool, frame, NULL)) {
+        return 1;
+    }
+    return av_frame_get_buffer(frame, FRAME_POOL_ALIGN) >= 0;
+}
+
+int frame_pool_get_buffer2(AVCodecContext *ctx, AVFrame *frame, int flags) {
+    FramePool *pool = (FramePool *)ctx->opaque;
+    if (pool && frame->format != AV_PIX_FMT_NONE && frame->width > 0 && frame->height > 0 &&
+        take_buffer(pool, frame, ctx)) {
+        return 0;
+    }
+    return avcodec_default_get_buffer2(ctx, frame, flags);
+}
+
+void frame_pool_report(FramePool *pool, int rank) {
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->pool) {
+        printf("[MPI Rank %d] Pool %s: %dx%d %s, maximo %d/%d buffers en uso (%.1f MB), %d fuera del pool\n",
+               rank, pool->name, pool->width, pool->height,
+               av_get_pix_fmt_name((AVPixelFormat)pool->format), pool->allocated, pool->capacity,
+               pool->allocated * (double)pool->size / (1024 * 1024), pool->overflow);
+        fflush(stdout);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void frame_pool_free(FramePool **pool) {
+    FramePool *p = *pool;
+    *pool = NULL;
+    if (!p) {
+        return;
+    }
+    if (p->pool) {
+        // p puede liberarse dentro de uninit si no quedan buffers afuera
+        AVBufferPool *buffers = p->pool;
+        av_buffer_pool_uninit(&buffers);
+    } else {
+        pool_release(p);
+    }
+}
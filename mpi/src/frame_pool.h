@@ -0,0 +1,42 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pool de buffers de frame alineados, uno por etapa del rank (frames
+ * decodificados, frames procesados). Toma formato y tamano del primer frame
+ * que pide y crea buffers a demanda hasta capacity; desde ahi los frames
+ * liberados vuelven al pool y el bucle decode -> proceso -> encode no
+ * reserva memoria. Un frame de otro tamano o con el pool agotado se reserva
+ * fuera del pool y se cuenta como desborde.
+ */
+typedef struct FramePool FramePool;
+
+struct AVFrame;
+struct AVCodecContext;
+
+FramePool *frame_pool_create(const char *name, int capacity);
+
+// Llena frame (format, width y height ya fijados) con un buffer del pool. Devuelve 0 sin memoria
+int frame_pool_get(FramePool *pool, struct AVFrame *frame);
+
+/*
+ * get_buffer2 de un decoder con ctx->opaque = pool: respeta la alineacion que
+ * pide el codec y cae en avcodec_default_get_buffer2 si el pool no sirve.
+ */
+int frame_pool_get_buffer2(struct AVCodecContext *ctx, struct AVFrame *frame, int flags);
+
+// Maximo de buffers en uso a la vez y memoria que ocupan, para dimensionar cada nodo
+void frame_pool_report(FramePool *pool, int rank);
+
+// Los buffers todavia referenciados siguen validos; la memoria se libera con el ultimo
+void frame_pool_free(FramePool **pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,383 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavformat/avformat.h>
+#include "gop_index.h"
+
+#define GOP_INITIAL_CAPACITY 256
+
+/*
+ * key_pts guarda el pts del keyframe del GOP actual entre llamadas. Sin pts
+ * (la tabla de muestras no lo trae) no se sabe que paquetes son iniciales y
+ * lead_end cubre el GOP entero.
+ */
+static int add_packet(GopIndex *index, int *capacity, int64_t timestamp, int64_t pts, double time_base,
+                      int64_t pos, int size, int is_key, int is_discard, int64_t *key_pts) {
+    // Los paquetes anteriores al primer keyframe no se pueden decodificar
+    if (index->num_gops == 0 && !is_key) {
+        return 1;
+    }
+
+    if (is_key) {
+        if (index->num_gops == *capacity) {
+            int new_capacity = *capacity * 2;
+            GopEntry *new_gops = (GopEntry *)realloc(index->gops, new_capacity * sizeof(GopEntry));
+            if (!new_gops) {
+                fprintf(stderr, "Error: No se pudo ampliar el indice de GOPs\n");
+                return 0;
+            }
+            index->gops = new_gops;
+            *capacity = new_capacity;
+        }
+
+        GopEntry *gop = &index->gops[index->num_gops++];
+        gop->timestamp = timestamp;
+        gop->start_time = timestamp * time_base;
+        gop->byte_start = pos;
+        gop->byte_end = pos + size;
+        gop->lead_end = pos + size;
+        gop->frame_start = index->total_frames;
+        gop->frame_count = 0;
+        *key_pts = pts;
+    }
+
+    GopEntry *gop = &index->gops[index->num_gops - 1];
+    if (pos >= 0) {
+        if (gop->byte_start < 0 || pos < gop->byte_start) {
+            gop->byte_start = pos;
+        }
+        if (pos + size > gop->byte_end) {
+            gop->byte_end = pos + size;
+        }
+        // Frames iniciales de un GOP abierto: los decodifica el rank del GOP anterior
+        if ((*key_pts == AV_NOPTS_VALUE || timestamp < *key_pts) && pos + size > gop->lead_end) {
+            gop->lead_end = pos + size;
+        }
+    }
+
+    // Los frames descartados por edit lists se decodifican pero no se muestran
+    if (!is_discard) {
+        gop->frame_count++;
+        index->total_frames++;
+    }
+
+    return 1;
+}
+
+/*
+ * Amplia el rango de bytes de cada GOP con los paquetes de audio de su
+ * intervalo de tiempo, para que el rank que lo procesa tenga tambien el
+ * audio que le toca. El audio anterior al primer keyframe va al primer GOP.
+ */
+static void add_audio_entries(GopIndex *index, AVStream *audio) {
+    double time_base = av_q2d(audio->time_base);
+    int num_entries = avformat_index_get_entries_count(audio);
+
+    for (int i = 0; i < num_entries; i++) {
+        const AVIndexEntry *e = avformat_index_get_entry(audio, i);
+        double t = e->timestamp * time_base;
+        if (e->pos < 0) {
+            continue;
+        }
+
+        // Ultimo GOP que empieza antes de t
+        int lo = 0;
+        int hi = index->num_gops - 1;
+        while (lo < hi) {
+            int mid = (lo + hi + 1) / 2;
+            if (index->gops[mid].start_time <= t) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+
+        GopEntry *gop = &index->gops[lo];
+        if (e->pos < gop->byte_start) {
+            gop->byte_start = e->pos;
+        }
+        if (e->pos + e->size > gop->byte_end) {
+            gop->byte_end = e->pos + e->size;
+        }
+    }
+}
+
+int build_gop_index(const char *video_file, GopIndex *index) {
+    AVFormatContext *fmt = NULL;
+    int capacity = GOP_INITIAL_CAPACITY;
+
+    memset(index, 0, sizeof(GopIndex));
+
+    if (avformat_open_input(&fmt, video_file, NULL, NULL) < 0) {
+        fprintf(stderr, "Error: No se pudo abrir el contenedor %s\n", video_file);
+        return 0;
+    }
+
+    int stream_index = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (stream_index < 0) {
+        fprintf(stderr, "Error: No hay stream de video en %s\n", video_file);
+        avformat_close_input(&fmt);
+        return 0;
+    }
+
+    AVStream *st = fmt->streams[stream_index];
+    double time_base = av_q2d(st->time_base);
+
+    index->gops = (GopEntry *)malloc(capacity * sizeof(GopEntry));
+    if (!index->gops) {
+        fprintf(stderr, "Error al asignar memoria para el indice de GOPs\n");
+        avformat_close_input(&fmt);
+        return 0;
+    }
+    index->stream_index = stream_index;
+    index->audio_stream_index = -1;
+    index->time_base_num = st->time_base.num;
+    index->time_base_den = st->time_base.den;
+
+    int ok = 1;
+    int64_t key_pts = AV_NOPTS_VALUE;
+    int num_entries = avformat_index_get_entries_count(st);
+
+    if (num_entries > 0) {
+        // MP4/MOV: la tabla de muestras del moov ya trae offset, tamano y
+        // flag de keyframe de cada paquete, sin leer un solo byte de mdat
+        for (int i = 0; i < num_entries && ok; i++) {
+            const AVIndexEntry *e = avformat_index_get_entry(st, i);
+            ok = add_packet(index, &capacity, e->timestamp, AV_NOPTS_VALUE, time_base, e->pos, e->size,
+                            (e->flags & AVINDEX_KEYFRAME) != 0,
+                            (e->flags & AVINDEX_DISCARD_FRAME) != 0, &key_pts);
+        }
+    } else {
+        // Contenedores sin indice completo: recorrer los paquetes sin decodificar
+        AVPacket *pkt = av_packet_alloc();
+        if (!pkt || avformat_find_stream_info(fmt, NULL) < 0) {
+            fprintf(stderr, "Error: No se pudo leer la informacion de streams\n");
+            ok = 0;
+        }
+        while (ok && av_read_frame(fmt, pkt) >= 0) {
+            if (pkt->stream_index == stream_index) {
+                int64_t ts = (pkt->dts != AV_NOPTS_VALUE) ? pkt->dts : pkt->pts;
+                ok = add_packet(index, &capacity, ts, pkt->pts, time_base, pkt->pos, pkt->size,
+                                (pkt->flags & AV_PKT_FLAG_KEY) != 0,
+                                (pkt->flags & AV_PKT_FLAG_DISCARD) != 0, &key_pts);
+            }
+            av_packet_unref(pkt);
+        }
+        av_packet_free(&pkt);
+    }
+
+    // Solo con tabla de muestras: sin ella no se sabe donde esta cada paquete de audio
+    int audio_index = av_find_best_stream(fmt, AVMEDIA_TYPE_AUDIO, -1, stream_index, NULL, 0);
+    if (ok && index->num_gops > 0 && num_entries > 0 && audio_index >= 0 &&
+        avformat_index_get_entries_count(fmt->streams[audio_index]) > 0) {
+        add_audio_entries(index, fmt->streams[audio_index]);
+        index->audio_stream_index = audio_index;
+    }
+
+    // Fin del ultimo GOP: la duracion del stream si el contenedor la declara
+    if (index->num_gops > 0) {
+        index->end_time = index->gops[index->num_gops - 1].start_time;
+        if (st->duration != AV_NOPTS_VALUE && st->duration > 0) {
+            int64_t start = (st->start_time != AV_NOPTS_VALUE) ? st->start_time : 0;
+            double end = (start + st->duration) * time_base;
+            if (end > index->end_time) {
+                index->end_time = end;
+            }
+        }
+    }
+
+    index->file_size = avio_size(fmt->pb);
+    avformat_close_input(&fmt);
+
+    if (!ok || index->num_gops == 0) {
+        fprintf(stderr, "Error: No se encontraron keyframes en %s\n", video_file);
+        free_gop_index(index);
+        return 0;
+    }
+
+    index->header_end = index->gops[0].byte_start;
+    index->trailer_start = 0;
+    for (int g = 0; g < index->num_gops; g++) {
+        if (index->gops[g].byte_start < index->header_end) {
+            index->header_end = index->gops[g].byte_start;
+        }
+        if (index->gops[g].byte_end > index->trailer_start) {
+            index->trailer_start = index->gops[g].byte_end;
+        }
+    }
+
+    printf("[Master] Indice de GOPs: %d GOPs, %d frames, cabecera %lld bytes, cola %lld bytes\n",
+           index->num_gops, index->total_frames, (long long)index->header_end,
+           (long long)(index->file_size - index->trailer_start));
+    fflush(stdout);
+
+    return 1;
+}
+
+int broadcast_gop_index(GopIndex *index, MPI_Comm comm, int rank) {
+    GopEntry *gops = index->gops;
+
+    // Primero los campos escalares; el puntero se restaura despues
+    MPI_Bcast(index, sizeof(GopIndex), MPI_BYTE, 0, comm);
+    index->gops = (rank == 0) ? gops : NULL;
+
+    if (index->num_gops <= 0) {
+        return 0;
+    }
+
+    if (rank != 0) {
+        index->gops = (GopEntry *)malloc(index->num_gops * sizeof(GopEntry));
+    }
+
+    int have_memory = (index->gops != NULL);
+    int all_have_memory;
+    MPI_Allreduce(&have_memory, &all_have_memory, 1, MPI_INT, MPI_MIN, comm);
+    if (!all_have_memory) {
+        fprintf(stderr, "[Rank %d] Error al asignar memoria para el indice de GOPs\n", rank);
+        if (rank != 0) {
+            free(index->gops);
+            index->gops = NULL;
+        }
+        return 0;
+    }
+
+    MPI_Bcast(index->gops, index->num_gops * (int)sizeof(GopEntry), MPI_BYTE, 0, comm);
+    return 1;
+}
+
+// Primer GOP cuyo frame inicial alcanza la fraccion part/num_procs del video
+static int gop_boundary(const GopIndex *index, int part, int num_procs) {
+    if (part >= num_procs) {
+        return index->num_gops;
+    }
+
+    long long target = (long long)index->total_frames * part / num_procs;
+    int lo = 0;
+    int hi = index->num_gops;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (index->gops[mid].frame_start < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void gop_range_for_rank(const GopIndex *index, int rank, int num_procs,
+                        int *first_gop, int *end_gop) {
+    *first_gop = gop_boundary(index, rank, num_procs);
+    *end_gop = gop_boundary(index, rank + 1, num_procs);
+}
+
+void gop_span(const GopIndex *index, int first_gop, int end_gop, ByteRange *span) {
+    if (first_gop >= end_gop) {
+        span->start = span->end = 0;
+        return;
+    }
+    span->start = index->gops[first_gop].byte_start;
+    span->end = index->gops[end_gop - 1].byte_end;
+    if (end_gop < index->num_gops && index->gops[end_gop].lead_end > span->end) {
+        span->end = index->gops[end_gop].lead_end;
+    }
+}
+
+// Rango de bytes de los GOPs asignados al rank (vacio si no tiene GOPs)
+void gop_span_for_rank(const GopIndex *index, int rank, int num_procs, ByteRange *span) {
+    int first_gop, end_gop;
+    gop_range_for_rank(index, rank, num_procs, &first_gop, &end_gop);
+    gop_span(index, first_gop, end_gop, span);
+}
+
+void free_gop_index(GopIndex *index) {
+    free(index->gops);
+    index->gops = NULL;
+    index->num_gops = 0;
+}
+
+int slice_gop_index(GopIndex *index, double start_time, double end_time) {
+    // Ultimo GOP que empieza no despues de start_time: su keyframe hace falta para decodificar
+    int first = 0;
+    while (first + 1 < index->num_gops && index->gops[first + 1].start_time <= start_time) {
+        first++;
+    }
+    int end = first + 1;
+    while (end < index->num_gops && (end_time < 0 || index->gops[end].start_time < end_time)) {
+        end++;
+    }
+
+    if (index->num_gops == 0 || start_time >= index->end_time) {
+        return 0;
+    }
+
+    if (end < index->num_gops) {
+        index->end_time = index->gops[end].start_time;
+    }
+    index->num_gops = end - first;
+    memmove(index->gops, index->gops + first, index->num_gops * sizeof(GopEntry));
+
+    index->total_frames = 0;
+    for (int g = 0; g < index->num_gops; g++) {
+        index->gops[g].frame_start = index->total_frames;
+        index->total_frames += index->gops[g].frame_count;
+    }
+
+    printf("[Master] Ventana %.3f-%.3fs: %d GOPs, %d frames, bytes %lld-%lld\n",
+           index->gops[0].start_time, index->end_time, index->num_gops, index->total_frames,
+           (long long)index->gops[0].byte_start, (long long)index->gops[index->num_gops - 1].byte_end);
+    fflush(stdout);
+    return 1;
+}
+
+int gop_at_time(const GopIndex *index, double seconds) {
+    int lo = 0;
+    int hi = index->num_gops - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (index->gops[mid].start_time <= seconds) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+int select_gop_index(GopIndex *index, const double *times, int num_times) {
+    int total_gops = index->num_gops;
+    int kept = 0;
+    int gop = 0;
+
+    // Recorrido hacia adelante: se escribe en [0, kept) y se lee desde gop >= kept - 1
+    for (int i = 0; i < num_times && total_gops > 0; i++) {
+        while (gop + 1 < total_gops && index->gops[gop + 1].start_time <= times[i]) {
+            gop++;
+        }
+        if (kept == 0 || index->gops[kept - 1].timestamp != index->gops[gop].timestamp) {
+            index->gops[kept++] = index->gops[gop];
+        }
+    }
+
+    if (kept == 0) {
+        return 0;
+    }
+    if (gop + 1 < total_gops) {
+        index->end_time = index->gops[gop + 1].start_time;
+    }
+    index->num_gops = kept;
+
+    int64_t bytes = 0;
+    index->total_frames = 0;
+    for (int g = 0; g < index->num_gops; g++) {
+        index->gops[g].frame_start = index->total_frames;
+        index->total_frames += index->gops[g].frame_count;
+        bytes += index->gops[g].byte_end - index->gops[g].byte_start;
+    }
+
+    printf("[Master] Capturas: %d instantes en %d de %d GOPs, %d frames, %.1f MB de video\n",
+           num_times, index->num_gops, total_gops, index->total_frames, bytes / (1024.0 * 1024.0));
+    fflush(stdout);
+    return 1;
+}
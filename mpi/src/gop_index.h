@@ -0,0 +1,81 @@
+#ifndef GOP_INDEX_H
+#define GOP_INDEX_H
+
+#include <mpi.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Indice de GOPs (keyframe + frames hasta el siguiente keyframe) del stream
+ * de video, construido una sola vez en el rank 0 a partir de los paquetes
+ * del contenedor y difundido a todos los ranks.
+ */
+typedef struct {
+    int64_t timestamp;   // timestamp de busqueda del keyframe (time_base del stream)
+    double start_time;   // inicio del GOP en segundos
+    int64_t byte_start;  // offset del primer paquete de video del GOP
+    int64_t byte_end;    // offset exclusivo tras el ultimo paquete de video del GOP
+    int64_t lead_end;    // offset exclusivo tras el keyframe y los paquetes con dts anterior a su pts
+    int frame_start;     // numero global del primer frame del GOP
+    int frame_count;
+} GopEntry;
+
+typedef struct {
+    int64_t start;
+    int64_t end;  // exclusivo
+} ByteRange;
+
+typedef struct {
+    GopEntry *gops;
+    int num_gops;
+    int total_frames;
+    int stream_index;
+    int audio_stream_index;  // -1 si no hay audio; sus paquetes quedan dentro del rango de bytes de cada GOP
+    int time_base_num;
+    int time_base_den;
+    double end_time;        // fin del ultimo GOP en segundos
+    int64_t file_size;
+    int64_t header_end;     // [0, header_end): cabecera del contenedor
+    int64_t trailer_start;  // [trailer_start, file_size): cola (p.ej. moov al final)
+} GopIndex;
+
+int build_gop_index(const char *video_file, GopIndex *index);
+// Colectiva en comm: el indice del rank 0 queda en todos
+int broadcast_gop_index(GopIndex *index, MPI_Comm comm, int rank);
+void gop_range_for_rank(const GopIndex *index, int rank, int num_procs,
+                        int *first_gop, int *end_gop);
+/*
+ * Rango de bytes que lee quien procesa los GOPs [first_gop, end_gop): si el
+ * GOP siguiente es abierto, encode_segment sigue decodificando su keyframe y
+ * sus frames iniciales, asi que el rango llega hasta su lead_end.
+ */
+void gop_span(const GopIndex *index, int first_gop, int end_gop, ByteRange *span);
+void gop_span_for_rank(const GopIndex *index, int rank, int num_procs, ByteRange *span);
+void free_gop_index(GopIndex *index);
+
+/*
+ * Recorta el indice a los GOPs que cubren [start_time, end_time) en segundos
+ * (end_time < 0: hasta el final) y renumera sus frames. Cabecera y cola no
+ * cambian. Devuelve 0 si la ventana no contiene ningun GOP.
+ */
+int slice_gop_index(GopIndex *index, double start_time, double end_time);
+
+// GOP que contiene el instante (el ultimo que empieza no despues de seconds; 0 si es anterior a todos)
+int gop_at_time(const GopIndex *index, double seconds);
+
+/*
+ * Deja solo los GOPs que contienen alguno de los instantes (ordenados) y
+ * renumera sus frames; los GOPs que quedan pueden no ser consecutivos en el
+ * video. end_time pasa a ser el fin del ultimo GOP elegido. Devuelve 0 si no
+ * queda ninguno.
+ */
+int select_gop_index(GopIndex *index, const double *times, int num_times);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,268 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gop_scheduler.h"
+#include "monotonic_clock.h"
+
+#define SCHED_REQUEST_TAG 110  // worker -> rank 0: resultado del lote anterior
+#define SCHED_ASSIGN_TAG 111   // rank 0 -> worker: [first_gop, end_gop), -1 = parar
+#define SCHED_LOAD_TAG 112     // worker -> rank 0: su RankLoad al final del job
+#define SCHED_POLL_USEC 200
+
+/*
+ * Como wait_idle del job server pero con una espera mucho mas corta: un lote
+ * tarda lo que tarda el rank 0 en leer su proximo paquete, y mientras tanto
+ * un MPI_Recv bloqueante le robaria un nucleo a los otros ranks del nodo.
+ */
+static void wait_quiet(MPI_Request *request, MPI_Status *status) {
+    int done = 0;
+    while (1) {
+        MPI_Test(request, &done, status);
+        if (done) {
+            return;
+        }
+        usleep(SCHED_POLL_USEC);
+    }
+}
+
+void gop_scheduler_init(GopScheduler *sched, const GopIndex *index, MPI_Comm comm, int rank, int num_procs,
+                        int min_batch) {
+    memset(sched, 0, sizeof(*sched));
+    sched->index = index;
+    sched->comm = comm;
+    sched->rank = rank;
+    sched->num_procs = num_procs;
+    sched->min_batch = (min_batch > 0) ? min_batch : 1;
+    sched->pending = index->num_gops;
+}
+
+// Rank 0: agrega un lote a la tabla, que crece de a el doble
+static int append_batch(GopScheduler *sched, int first_gop, int end_gop, int owner) {
+    if (sched->num_batches == sched->capacity) {
+        int capacity = sched->capacity ? 2 * sched->capacity : 64;
+        GopBatch *batches = (GopBatch *)realloc(sched->batches, capacity * sizeof(GopBatch));
+        if (!batches) {
+            fprintf(stderr, "Error: Sin memoria para la tabla de lotes\n");
+            sched->failed = 1;
+            return 0;
+        }
+        sched->batches = batches;
+        sched->capacity = capacity;
+    }
+
+    GopBatch *batch = &sched->batches[sched->num_batches++];
+    batch->first_gop = first_gop;
+    batch->end_gop = end_gop;
+    batch->owner = owner;
+    return 1;
+}
+
+int gop_scheduler_skip(GopScheduler *sched, const GopBatch *batches, int num_batches) {
+    int num_gops = sched->index->num_gops;
+    if (!sched->done) {
+        sched->done = (unsigned char *)calloc(num_gops > 0 ? num_gops : 1, 1);
+        if (!sched->done) {
+            sched->failed = 1;
+            return 0;
+        }
+    }
+    for (int b = 0; b < num_batches; b++) {
+        if (!append_batch(sched, batches[b].first_gop, batches[b].end_gop, batches[b].owner)) {
+            return 0;
+        }
+        for (int g = batches[b].first_gop; g < batches[b].end_gop && g < num_gops; g++) {
+            sched->pending -= !sched->done[g];
+            sched->done[g] = 1;
+        }
+    }
+    return 1;
+}
+
+// Rank 0: corta el proximo lote y lo anota en la tabla. Devuelve 0 si no hay mas
+static int take_batch(GopScheduler *sched, int owner, int *first_gop, int *end_gop) {
+    int num_gops = sched->index->num_gops;
+    while (sched->done && sched->next_gop < num_gops && sched->done[sched->next_gop]) {
+        sched->next_gop++;
+    }
+    int remaining = sched->pending;
+    if (sched->failed || remaining <= 0) {
+        return 0;
+    }
+
+    int size = (remaining + 2 * sched->num_procs - 1) / (2 * sched->num_procs);
+    if (size < sched->min_batch) {
+        size = sched->min_batch;
+    }
+    if (size > remaining) {
+        size = remaining;
+    }
+    // Un lote termina antes del proximo GOP ya hecho
+    int end = sched->next_gop + 1;
+    while (end < sched->next_gop + size && end < num_gops && !(sched->done && sched->done[end])) {
+        end++;
+    }
+
+    if (!append_batch(sched, sched->next_gop, end, owner)) {
+        return 0;
+    }
+    sched->pending -= end - sched->next_gop;
+    *first_gop = sched->next_gop;
+    *end_gop = end;
+    sched->next_gop = end;
+    return 1;
+}
+
+static int compare_batches(const void *a, const void *b) {
+    return ((const GopBatch *)a)->first_gop - ((const GopBatch *)b)->first_gop;
+}
+
+static void serve_request(GopScheduler *sched, int source, int prev_ok) {
+    int assignment[2] = {-1, -1};
+    if (!prev_ok) {
+        sched->failed = 1;
+    }
+    if (!take_batch(sched, source, &assignment[0], &assignment[1])) {
+        sched->stopped++;
+    }
+    MPI_Send(assignment, 2, MPI_INT, source, SCHED_ASSIGN_TAG, sched->comm);
+}
+
+void gop_scheduler_poll(void *opaque) {
+    GopScheduler *sched = (GopScheduler *)opaque;
+    int pending;
+    MPI_Status status;
+    MPI_Iprobe(MPI_ANY_SOURCE, SCHED_REQUEST_TAG, sched->comm, &pending, &status);
+    while (pending) {
+        int prev_ok;
+        MPI_Recv(&prev_ok, 1, MPI_INT, status.MPI_SOURCE, SCHED_REQUEST_TAG, sched->comm, MPI_STATUS_IGNORE);
+        serve_request(sched, status.MPI_SOURCE, prev_ok);
+        MPI_Iprobe(MPI_ANY_SOURCE, SCHED_REQUEST_TAG, sched->comm, &pending, &status);
+    }
+}
+
+int gop_scheduler_next(GopScheduler *sched, int ok, int *first_gop, int *end_gop) {
+    double start = now_seconds();
+    if (sched->batch_started > 0) {
+        sched->load.busy += start - sched->batch_started;
+        sched->batch_started = 0;
+    }
+
+    int assigned;
+    if (sched->rank == 0) {
+        if (!ok) {
+            sched->failed = 1;
+        }
+        // Primero los pedidos que llegaron mientras el rank 0 codificaba
+        gop_scheduler_poll(sched);
+        assigned = take_batch(sched, 0, first_gop, end_gop);
+    } else {
+        int assignment[2];
+        MPI_Request request;
+        MPI_Send(&ok, 1, MPI_INT, 0, SCHED_REQUEST_TAG, sched->comm);
+        MPI_Irecv(assignment, 2, MPI_INT, 0, SCHED_ASSIGN_TAG, sched->comm, &request);
+        wait_quiet(&request, MPI_STATUS_IGNORE);
+        assigned = (assignment[0] >= 0);
+        *first_gop = assignment[0];
+        *end_gop = assignment[1];
+    }
+
+    double now = now_seconds();
+    sched->load.idle += now - start;
+    if (assigned) {
+        sched->batch_started = now;
+        sched->load.gops += *end_gop - *first_gop;
+        sched->load.batches++;
+    }
+    return assigned;
+}
+
+int gop_scheduler_finish(GopScheduler *sched) {
+    double start = now_seconds();
+    if (sched->rank == 0) {
+        while (sched->stopped < sched->num_procs - 1) {
+            int prev_ok;
+            MPI_Request request;
+            MPI_Status status;
+            MPI_Irecv(&prev_ok, 1, MPI_INT, MPI_ANY_SOURCE, SCHED_REQUEST_TAG, sched->comm, &request);
+            wait_quiet(&request, &status);
+            serve_request(sched, status.MPI_SOURCE, prev_ok);
+        }
+    }
+    sched->load.idle += now_seconds() - start;
+
+    // Los lotes de gop_scheduler_skip entraron primero: la tabla se difunde en orden de GOP
+    if (sched->rank == 0 && sched->done && sched->num_batches > 1) {
+        qsort(sched->batches, sched->num_batches, sizeof(GopBatch), compare_batches);
+    }
+    MPI_Bcast(&sched->num_batches, 1, MPI_INT, 0, sched->comm);
+    int ok = 1;
+    if (sched->rank != 0) {
+        free(sched->batches);
+        sched->batches = (GopBatch *)malloc((sched->num_batches + 1) * sizeof(GopBatch));
+        ok = (sched->batches != NULL);
+    }
+    // Un rank sin memoria igual tiene que participar del Bcast
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, sched->comm);
+    if (all_ok && sched->num_batches > 0) {
+        MPI_Bcast(sched->batches, sched->num_batches * (int)sizeof(GopBatch), MPI_BYTE, 0, sched->comm);
+    }
+    return all_ok;
+}
+
+void gop_scheduler_free(GopScheduler *sched) {
+    free(sched->batches);
+    free(sched->done);
+    sched->batches = NULL;
+    sched->done = NULL;
+    sched->num_batches = 0;
+    sched->capacity = 0;
+}
+
+int gop_static_batches(const GopIndex *index, int num_procs, GopBatch **batches) {
+    *batches = (GopBatch *)malloc(num_procs * sizeof(GopBatch));
+    if (!*batches) {
+        return -1;
+    }
+    int count = 0;
+    for (int r = 0; r < num_procs; r++) {
+        int first_gop, end_gop;
+        gop_range_for_rank(index, r, num_procs, &first_gop, &end_gop);
+        if (first_gop < end_gop) {
+            (*batches)[count].first_gop = first_gop;
+            (*batches)[count].end_gop = end_gop;
+            (*batches)[count].owner = r;
+            count++;
+        }
+    }
+    return count;
+}
+
+void report_rank_load(const RankLoad *load, const char *schedule, MPI_Comm comm, int rank, int num_procs) {
+    double row[4] = {load->busy, load->idle, (double)load->gops, (double)load->batches};
+    if (rank != 0) {
+        MPI_Send(row, 4, MPI_DOUBLE, 0, SCHED_LOAD_TAG, comm);
+        return;
+    }
+
+    double max_busy = 0;
+    double total_busy = 0;
+    for (int r = 0; r < num_procs; r++) {
+        if (r > 0) {
+            MPI_Recv(row, 4, MPI_DOUBLE, r, SCHED_LOAD_TAG, comm, MPI_STATUS_IGNORE);
+        }
+        printf("[Carga] Rank %d: ocupado %.2fs, ocioso %.2fs, %d GOPs en %d lotes\n",
+               r, row[0], row[1], (int)row[2], (int)row[3]);
+        total_busy += row[0];
+        if (row[0] > max_busy) {
+            max_busy = row[0];
+        }
+    }
+    // 0% = todos los ranks ocupados el mismo tiempo
+    double mean_busy = total_busy / num_procs;
+    printf("[Carga] Reparto %s: ocupado maximo %.2fs, medio %.2fs, desbalance %.1f%%\n", schedule,
+           max_busy, mean_busy, (max_busy > 0) ? 100.0 * (max_busy - mean_busy) / max_busy : 0.0);
+    fflush(stdout);
+}
@@ -0,0 +1,92 @@
+#ifndef GOP_SCHEDULER_H
+#define GOP_SCHEDULER_H
+
+#include <mpi.h>
+#include "gop_index.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lote contiguo de GOPs procesado por un rank en un segmento propio
+typedef struct {
+    int first_gop;
+    int end_gop;  // exclusivo
+    int owner;    // rank que lo codifica
+} GopBatch;
+
+// Tiempo de un rank en la fase de codificacion, para ver el desbalance
+typedef struct {
+    double busy;  // bajando y codificando sus GOPs
+    double idle;  // esperando un lote o a que terminen los demas
+    int gops;
+    int batches;
+} RankLoad;
+
+/*
+ * Reparto dinamico: el rank 0 entrega lotes a pedido por MPI_Send/MPI_Recv y
+ * tambien procesa los suyos. El tamano del lote arranca en lo que queda
+ * dividido por 2 * num_procs y se achica hasta min_batch GOPs, asi los
+ * ultimos lotes son cortos y los ranks terminan casi a la vez aunque unos
+ * GOPs cuesten mucho mas que otros.
+ */
+typedef struct {
+    const GopIndex *index;
+    MPI_Comm comm;      // ranks del job
+    int rank;
+    int num_procs;
+    int min_batch;
+    int next_gop;       // rank 0: primer GOP sin asignar
+    int pending;        // rank 0: GOPs sin asignar ni hechos de antes
+    unsigned char *done;  // rank 0: GOPs que no se reparten (gop_scheduler_skip); NULL si ninguno
+    int stopped;        // rank 0: workers que ya recibieron la orden de parar
+    int failed;         // rank 0: algun lote fallo, no se reparte mas
+    GopBatch *batches;  // rank 0 mientras reparte; todos tras gop_scheduler_finish
+    int num_batches;
+    int capacity;
+    double batch_started;
+    RankLoad load;
+} GopScheduler;
+
+void gop_scheduler_init(GopScheduler *sched, const GopIndex *index, MPI_Comm comm, int rank, int num_procs,
+                        int min_batch);
+
+/*
+ * Rank 0, antes del primer lote: los GOPs de batches ya estan hechos (p.ej.
+ * segmentos de un checkpoint). Entran a la tabla tal cual, con su owner, y no
+ * se reparten; ningun lote nuevo los cruza. Devuelve 0 sin memoria.
+ */
+int gop_scheduler_skip(GopScheduler *sched, const GopBatch *batches, int num_batches);
+
+/*
+ * Siguiente lote del rank; ok = 0 avisa que el anterior fallo y corta el
+ * reparto. Devuelve 0 cuando no quedan GOPs o el job ya fallo.
+ */
+int gop_scheduler_next(GopScheduler *sched, int ok, int *first_gop, int *end_gop);
+
+/*
+ * Rank 0: contesta sin bloquear los pedidos pendientes. Se llama desde el
+ * thread principal mientras codifica, asi un worker no espera a que el rank 0
+ * termine su propio lote.
+ */
+void gop_scheduler_poll(void *sched);
+
+/*
+ * Colectiva: el rank 0 atiende hasta que todos los workers paran y difunde la
+ * tabla de lotes en orden de GOP. Devuelve 0 sin memoria para la tabla.
+ */
+int gop_scheduler_finish(GopScheduler *sched);
+
+void gop_scheduler_free(GopScheduler *sched);
+
+// Un lote por rank con GOPs, como gop_range_for_rank. Devuelve la cantidad (-1 sin memoria)
+int gop_static_batches(const GopIndex *index, int num_procs, GopBatch **batches);
+
+// Colectiva: junta en el rank 0 la carga de cada rank y la imprime
+void report_rank_load(const RankLoad *load, const char *schedule, MPI_Comm comm, int rank, int num_procs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,268 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "job_server.h"
+
+#define JOB_LINE_MAX (sizeof(JobDescriptor) + 16)
+#define JOB_LOG_DIR "/var/log/mpi_jobs"
+#define IDLE_POLL_USEC 2000
+
+/*
+ * Espera una operacion no bloqueante durmiendo entre consultas: un
+ * MPI_Bcast bloqueante haria busy-polling en todos los ranks mientras el
+ * servidor esta ocioso.
+ */
+static void wait_idle(MPI_Request *request) {
+    int done = 0;
+    while (1) {
+        MPI_Test(request, &done, MPI_STATUS_IGNORE);
+        if (done) {
+            return;
+        }
+        usleep(IDLE_POLL_USEC);
+    }
+}
+
+static int open_listener(const char *socket_path) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Ruta de socket demasiado larga: %s\n", socket_path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        fprintf(stderr, "Error: No se pudo escuchar en %s\n", socket_path);
+        close(fd);
+        return -1;
+    }
+    // El consumer corre como otro usuario
+    chmod(socket_path, 0666);
+    return fd;
+}
+
+// Lee una linea completa de la conexion; devuelve su longitud sin el '\n' o -1
+static int read_line(int fd, char *line, size_t size) {
+    size_t used = 0;
+    while (used < size - 1) {
+        ssize_t n = read(fd, line + used, 1);
+        if (n <= 0) {
+            return -1;
+        }
+        if (line[used] == '\n') {
+            break;
+        }
+        used++;
+    }
+    line[used] = '\0';
+    if (used > 0 && line[used - 1] == '\r') {
+        line[--used] = '\0';
+    }
+    return (int)used;
+}
+
+static int copy_field(char *dst, size_t size, const char *src, size_t len) {
+    if (len == 0 || len >= size) {
+        return 0;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return 1;
+}
+
+static int parse_job_line(char *line, JobDescriptor *job) {
+    memset(job, 0, sizeof(JobDescriptor));
+    if (strcmp(line, "SHUTDOWN") == 0) {
+        job->shutdown = 1;
+        return 1;
+    }
+
+    // params va sin tabs (JSON compacto): un quinto campo es la cantidad de ranks
+    char *fields[5] = {line, NULL, NULL, NULL, NULL};
+    for (int i = 1; i < 5; i++) {
+        char *tab = strchr(fields[i - 1], '\t');
+        if (!tab) {
+            break;
+        }
+        *tab = '\0';
+        fields[i] = tab + 1;
+    }
+    if (!fields[2]) {
+        return 0;
+    }
+
+    const char *params = (fields[3] && *fields[3]) ? fields[3] : "{}";
+    if (fields[4]) {
+        char *end;
+        long np = strtol(fields[4], &end, 10);
+        if (*end != '\0' || np < 0 || np > 1 << 20) {
+            return 0;
+        }
+        job->np = (int)np;
+    }
+    return copy_field(job->job_id, sizeof(job->job_id), fields[0], strlen(fields[0])) &&
+           copy_field(job->video_path, sizeof(job->video_path), fields[1], strlen(fields[1])) &&
+           copy_field(job->task, sizeof(job->task), fields[2], strlen(fields[2])) &&
+           copy_field(job->params, sizeof(job->params), params, strlen(params)) &&
+           strchr(job->job_id, '/') == NULL;
+}
+
+static void reply(int client, const char *message) {
+    size_t len = strlen(message);
+    if (write(client, message, len) != (ssize_t)len) {
+        fprintf(stderr, "Aviso: No se pudo responder al cliente del job server\n");
+    }
+}
+
+static void reply_result(int client, int status, const char *summary) {
+    reply(client, (status == JOB_OK) ? "OK" : (status == JOB_REJECTED) ? "REJECTED" : "ERROR");
+    if (summary) {
+        reply(client, " ");
+        reply(client, summary);
+    }
+    reply(client, "\n");
+}
+
+/*
+ * El log del rank 0 va a /var/log/mpi_jobs/<job_id>.log como cuando cada job
+ * era un mpirun aparte; los demas ranks siguen saliendo por el log de mpirun.
+ */
+static int redirect_output(const char *job_id, int saved[2]) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.log", JOB_LOG_DIR, job_id);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return 0;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    saved[0] = dup(STDOUT_FILENO);
+    saved[1] = dup(STDERR_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    return 1;
+}
+
+static void restore_output(int saved[2]) {
+    fflush(stdout);
+    fflush(stderr);
+    dup2(saved[0], STDOUT_FILENO);
+    dup2(saved[1], STDERR_FILENO);
+    close(saved[0]);
+    close(saved[1]);
+}
+
+int serve_jobs(const char *socket_path, JobHandler handler, int rank, int num_procs) {
+    int listener = -1;
+    JobDescriptor job;
+
+    if (rank == 0) {
+        // Un consumer que se va antes de la respuesta no debe tumbar al servidor
+        signal(SIGPIPE, SIG_IGN);
+        listener = open_listener(socket_path);
+    }
+
+    int ok = (listener >= 0);
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!ok) {
+        return 0;
+    }
+
+    if (rank == 0) {
+        printf("Job server listo en %s con %d procesos MPI\n", socket_path, num_procs);
+        fflush(stdout);
+    }
+
+    while (1) {
+        int client = -1;
+
+        if (rank == 0) {
+            char line[JOB_LINE_MAX];
+            while (1) {
+                client = accept(listener, NULL, NULL);
+                if (client < 0) {
+                    continue;
+                }
+                // Un cliente que no manda la linea no puede bloquear al servidor
+                struct timeval timeout = {10, 0};
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                if (read_line(client, line, sizeof(line)) >= 0 && parse_job_line(line, &job)) {
+                    break;
+                }
+                reply(client, "ERROR formato invalido\n");
+                close(client);
+            }
+        }
+
+        MPI_Request request;
+        MPI_Ibcast(&job, sizeof(JobDescriptor), MPI_BYTE, 0, MPI_COMM_WORLD, &request);
+        wait_idle(&request);
+
+        if (job.shutdown) {
+            if (rank == 0) {
+                reply(client, "OK\n");
+                close(client);
+            }
+            break;
+        }
+
+        // Un job chico corre solo en los primeros np ranks; los demas vuelven a esperar
+        int job_procs = (job.np > 0 && job.np < num_procs) ? job.np : num_procs;
+        MPI_Comm comm = MPI_COMM_WORLD;
+        if (job_procs < num_procs) {
+            MPI_Comm_split(MPI_COMM_WORLD, (rank < job_procs) ? 0 : MPI_UNDEFINED, rank, &comm);
+        }
+
+        int status = JOB_FAILED;
+        char *summary = NULL;
+        if (comm != MPI_COMM_NULL) {
+            int saved[2];
+            int redirected = (rank == 0) && redirect_output(job.job_id, saved);
+
+            status = handler(&job, comm, rank, job_procs, &summary);
+
+            if (redirected) {
+                restore_output(saved);
+            }
+        }
+        if (comm != MPI_COMM_WORLD && comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&comm);
+        }
+        if (rank == 0) {
+            printf("Job %s %s\n", job.job_id,
+                   (status == JOB_OK) ? "completado" : (status == JOB_REJECTED) ? "rechazado" : "fallido");
+            fflush(stdout);
+            reply_result(client, status, summary);
+            close(client);
+        }
+        free(summary);
+    }
+
+    if (rank == 0) {
+        close(listener);
+        unlink(socket_path);
+        printf("Job server detenido\n");
+        fflush(stdout);
+    }
+    return 1;
+}
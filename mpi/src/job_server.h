@@ -0,0 +1,52 @@
+#ifndef JOB_SERVER_H
+#define JOB_SERVER_H
+
+#include <mpi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEFAULT_JOB_SOCKET "/tmp/dvp_jobs.sock"
+
+typedef struct {
+    char job_id[128];
+    char video_path[512];
+    char task[64];
+    char params[4096];
+    int np;  // ranks del job; 0 usa todos los del servidor
+    int shutdown;
+} JobDescriptor;
+
+// Resultado de un JobHandler
+#define JOB_FAILED 0
+#define JOB_OK 1
+#define JOB_REJECTED 2  // un reintento fallaria igual: tarea, params o video invalidos
+
+/*
+ * Ejecuta un job en los ranks de comm; devuelve el resultado combinado.
+ * El rank 0 puede dejar en summary una linea sin '\n' (con malloc) que viaja
+ * en la respuesta, p.ej. el registro de metricas.
+ */
+typedef int (*JobHandler)(const JobDescriptor *job, MPI_Comm comm, int rank, int num_procs, char **summary);
+
+/*
+ * Modo residente: los ranks quedan levantados y el rank 0 recibe jobs por un
+ * socket Unix, una linea por conexion:
+ *
+ *     <job_id>\t<video_path>\t<task>\t<params>[\t<np>]\n
+ *
+ * El job se difunde a todos los ranks y se ejecuta con handler. Con np menor
+ * que la cantidad de ranks corre en un subcomunicador con los ranks 0 a
+ * np - 1 y los demas esperan el proximo job. El rank 0 responde "OK",
+ * "ERROR" o "REJECTED" (JOB_REJECTED), seguido de " <summary>" si el handler
+ * dejo uno, y '\n' antes de cerrar la conexion. La linea "SHUTDOWN\n" detiene el servidor. Devuelve 0
+ * si no se pudo abrir el socket.
+ */
+int serve_jobs(const char *socket_path, JobHandler handler, int rank, int num_procs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "node_share.h"
+
+int node_topology_init(NodeTopology *topo, MPI_Comm comm, int rank, int num_procs) {
+    memset(topo, 0, sizeof(*topo));
+    topo->comm = comm;
+    topo->leaders = MPI_COMM_NULL;
+
+    // key = rank: el rank mas bajo del nodo queda como node_rank 0
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &topo->node);
+    MPI_Comm_rank(topo->node, &topo->node_rank);
+    MPI_Comm_size(topo->node, &topo->node_size);
+
+    int is_leader = (topo->node_rank == 0);
+    MPI_Comm_split(comm, is_leader ? 0 : MPI_UNDEFINED, rank, &topo->leaders);
+    MPI_Allreduce(&is_leader, &topo->num_nodes, 1, MPI_INT, MPI_SUM, comm);
+
+    int leader = rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, topo->node);
+    topo->leader_of = (int *)malloc(num_procs * sizeof(int));
+    int ok = (topo->leader_of != NULL);
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, comm);
+    if (!all_ok) {
+        node_topology_free(topo);
+        return 0;
+    }
+    MPI_Allgather(&leader, 1, MPI_INT, topo->leader_of, 1, MPI_INT, comm);
+    return 1;
+}
+
+void node_topology_free(NodeTopology *topo) {
+    if (topo->leaders != MPI_COMM_NULL) {
+        MPI_Comm_free(&topo->leaders);
+    }
+    if (topo->node != MPI_COMM_NULL) {
+        MPI_Comm_free(&topo->node);
+    }
+    free(topo->leader_of);
+    topo->leader_of = NULL;
+}
+
+int shared_video_alloc(SharedVideo *video, const NodeTopology *topo, int64_t size) {
+    memset(video, 0, sizeof(*video));
+    video->win = MPI_WIN_NULL;
+
+    // Sin el handler por defecto un fallo de memoria abortaria todo el job server
+    MPI_Comm_set_errhandler(topo->node, MPI_ERRORS_RETURN);
+    void *base = NULL;
+    int ok = MPI_Win_allocate_shared((topo->node_rank == 0) ? (MPI_Aint)size : 0, 1, MPI_INFO_NULL,
+                                     topo->node, &base, &video->win) == MPI_SUCCESS;
+    MPI_Comm_set_errhandler(topo->node, MPI_ERRORS_ARE_FATAL);
+
+    if (ok) {
+        MPI_Aint leader_size;
+        int disp_unit;
+        MPI_Win_shared_query(video->win, 0, &leader_size, &disp_unit, &base);
+        video->data = (uint8_t *)base;
+        video->size = size;
+        // Epoca pasiva para todo el job: el lider escribe con stores y MPI_Recv normales
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, video->win);
+    }
+
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, topo->node);
+    if (!all_ok) {
+        fprintf(stderr, "Error: No se pudo reservar la ventana compartida de %lld bytes\n", (long long)size);
+        shared_video_free(video);
+    }
+    return all_ok;
+}
+
+void shared_video_publish(SharedVideo *video, const NodeTopology *topo) {
+    MPI_Win_sync(video->win);
+    MPI_Barrier(topo->node);
+    MPI_Win_sync(video->win);
+}
+
+void shared_video_free(SharedVideo *video) {
+    if (video->win != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(video->win);
+        MPI_Win_free(&video->win);
+    }
+    video->data = NULL;
+    video->size = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef NODE_SHARE_H
+#define NODE_SHARE_H
+
+#include <mpi.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Ranks de comm agrupados por nodo (MPI_COMM_TYPE_SHARED). El lider de cada
+ * nodo es su rank de comm mas bajo; el rank 0 siempre es lider. Se arma una
+ * vez al arrancar el proceso sobre MPI_COMM_WORLD y sirve para todos los
+ * jobs; un job del servidor residente con menos ranks arma la suya.
+ */
+typedef struct {
+    MPI_Comm comm;     // ranks del job; no es de la topologia, no se libera con ella
+    MPI_Comm node;     // ranks del mismo nodo
+    MPI_Comm leaders;  // un rank por nodo; MPI_COMM_NULL fuera de los lideres
+    int node_rank;
+    int node_size;
+    int num_nodes;
+    int *leader_of;    // rank -> rank en comm del lider de su nodo
+} NodeTopology;
+
+// Colectiva en comm; rank y num_procs son los de comm
+int node_topology_init(NodeTopology *topo, MPI_Comm comm, int rank, int num_procs);
+void node_topology_free(NodeTopology *topo);
+
+/*
+ * Una copia por nodo de los bytes del video de entrada, en una ventana
+ * MPI_Win_allocate_shared del tamano del archivo. Solo el lider escribe; los
+ * demas ranks del nodo leen la misma memoria sin copiarla. Las paginas que
+ * nadie toca (los spans de otros nodos) no ocupan memoria.
+ */
+typedef struct {
+    MPI_Win win;
+    uint8_t *data;
+    int64_t size;
+} SharedVideo;
+
+// Colectiva en el nodo. Devuelve 0 si no se pudo reservar
+int shared_video_alloc(SharedVideo *video, const NodeTopology *topo, int64_t size);
+
+// Colectiva en el nodo: lo que escribio el lider queda visible para todos
+void shared_video_publish(SharedVideo *video, const NodeTopology *topo);
+
+// Colectiva en el nodo
+void shared_video_free(SharedVideo *video);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,17 +1,62 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // fallocate, sched_getaffinity
+#endif
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <pthread.h>
 #include <curl/curl.h>
+#include <cjson/cJSON.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include "gop_scheduler.h"
+#include "node_share.h"
+#include "video_cache.h"
 #include "video_decompose.h"
+#include "video_distribute.h"
+#include "video_source.h"
+#include "job_server.h"
+#include "monotonic_clock.h"
+#include "video_tasks.h"
 
 #define MINIO_ENDPOINT "http://minio:9000"
 #define MINIO_BUCKET "uploads"
-#define NUM_DOWNLOAD_THREADS 4
+#define DEFAULT_DOWNLOAD_THREADS 8  // DVP_DOWNLOAD_THREADS
+#define MAX_DOWNLOAD_THREADS 64
 #define CHUNK_SIZE (1024 * 1024)  // 1 MB chunks
+#define DEFAULT_RANGE_TASK_MB 8  // DVP_RANGE_SIZE_MB: tamano maximo de cada GET con Range
+#define MAX_TASK_ATTEMPTS 4  // intentos por rango antes de dar el job por fallido
+#define MIN_STEAL_SIZE (2 * CHUNK_SIZE)  // un thread ocioso solo roba colas mayores a esto
+#define WRITE_BUFFER_SIZE (256 * 1024)  // buffer fijo por thread antes de cada pwrite
+#define MAX_TOP_LEVEL_BOXES 64
+#define MAX_POOLED_HANDLES MAX_DOWNLOAD_THREADS
+#define MAX_THREADS_PER_RANK 256  // DVP_THREADS_PER_RANK
+#define DEFAULT_UPLOAD_PART_MB 16  // DVP_UPLOAD_PART_MB: tamano de cada parte del multipart
+#define MIN_UPLOAD_PART_MB 5  // minimo de S3 para toda parte salvo la ultima
+#define MAX_UPLOAD_PARTS 10000
+#define DEFAULT_RESULT_BUCKET "artifacts"  // DVP_RESULT_BUCKET
+#define RESULT_INDEX_PREFIX "results/index"  // DVP_RESULT_CACHE: entradas del indice de resultados
+#define RESULT_INDEX_VERSION 1  // subirlo invalida el indice entero (p.ej. si cambia la codificacion)
+#define CHECKPOINT_PREFIX "results/checkpoints"  // DVP_CHECKPOINT: job.json y segmentos de cada job
+#define DEFAULT_CACHE_DIR "/tmp/dvp_cache"  // DVP_CACHE_DIR
+#define DEFAULT_CACHE_MB 4096  // DVP_CACHE_MB: presupuesto de la cache de videos, 0 la desactiva
+#define EXIT_REJECTED 2  // codigo de salida de un job que un reintento repetiria (JOB_REJECTED)
+
+// Modo de obtencion del video: cada rank baja sus rangos, o el master baja todo y reparte por MPI
+#define FETCH_MODE_DIRECT 0
+#define FETCH_MODE_MASTER 1
+
+// Reparto de GOPs entre ranks (DVP_SCHEDULE): un rango fijo por rank, o lotes a pedido
+#define SCHEDULE_STATIC 0
+#define SCHEDULE_DYNAMIC 1
 
 typedef struct {
     char *data;
@@ -19,22 +64,141 @@ typedef struct {
     size_t capacity;
 } MemoryBuffer;
 
+// Lo que dicen del objeto completo las cabeceras de un GET con Range
+typedef struct {
+    long size;       // de Content-Range; -1 si no vino
+    char etag[128];  // sin comillas; vacio si no vino
+    long first;      // rango servido segun Content-Range; -1 si no vino
+    long last;
+} ObjectInfo;
+
+/*
+ * Handles de curl reutilizables para todo el proceso. Comparten cache de DNS
+ * y de conexiones, asi que cada GET con Range sale por una conexion
+ * keep-alive ya abierta contra MinIO en vez de abrir una nueva.
+ */
+typedef struct {
+    CURLSH *share;
+    pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+    pthread_mutex_t pool_mutex;
+    CURL *idle[MAX_POOLED_HANDLES];
+    int num_idle;
+} TransferEngine;
+
+static TransferEngine engine;
+
+/*
+ * Tiempos por etapa del job en este rank, en segundos de reloj monotonico,
+ * y lo que movio. Las etapas se solapan: la descarga corre mientras se
+ * reparte y se decodifica el video. Al terminar, report_job_metrics junta las
+ * de todos los ranks en el rank 0.
+ */
+typedef struct {
+    double started;
+    double head;       // GETs con Range de la metadata del contenedor
+    double index;      // indice de GOPs
+    double download;   // descargas por rangos, sumadas
+    int64_t bytes_downloaded;
+    double broadcast;  // difusion del indice y reparto del video por MPI
+    SegmentStats segments;
+    double busy;       // fase de GOPs completa: descarga, decode y encode (RankLoad.busy)
+    double idle;       // esperando lotes o a los demas ranks en las barreras
+    int gops;
+    double assemble;   // juntar y concatenar los segmentos
+    double upload;     // resultado y checkpoints de segmentos
+    double total;
+    int64_t video_bytes;
+    int video_frames;
+    int reused;        // el resultado salio de la cache de resultados
+    int restored;      // segmentos retomados del checkpoint del job
+    int rejected;      // fallo que un reintento repetiria; igual en todos los ranks
+} JobStages;
+
+static JobStages stages;
+
+// Columnas de la fila de cada rank en el registro de metricas; las primeras NUM_TIME_METRICS son segundos
+static const char *const metric_names[] = {
+    "head", "index", "download", "broadcast", "seek", "decode", "busy", "idle", "assemble", "upload", "total",
+    "bytes_downloaded", "frames", "gops",
+};
+#define NUM_METRICS ((int)(sizeof(metric_names) / sizeof(metric_names[0])))
+#define NUM_TIME_METRICS 11
+
+// Registro JSON del ultimo job en el rank 0, para la respuesta del job server
+static char *metrics_record;
+
+// Ranks del job agrupados por nodo; comm es el comunicador del job. Se arma en main sobre MPI_COMM_WORLD
+static NodeTopology topology;
+
+// Cache de videos del nodo del rank 0 (DVP_CACHE_DIR, DVP_CACHE_MB); budget 0 en el resto
+static VideoCache video_cache;
+
+/*
+ * Un GET con Range en curso o pendiente. Cada chunk arranca como una sola
+ * tarea; un reintento o un robo la parte en varias que cubren el mismo chunk.
+ */
+typedef struct RangeTask {
+    int chunk;             // chunk al que pertenece
+    long start_byte;
+    long end_byte;         // inclusivo; un thread ocioso puede recortarlo para robar la cola
+    long received;         // siguiente offset aun no recibido
+    int attempts;
+    struct RangeTask *next;
+} RangeTask;
+
+// Escribe lo que llega de curl directo en su offset del archivo destino
+typedef struct {
+    int fd;
+    off_t offset;  // siguiente offset a escribir
+    off_t limit;   // offset exclusivo del rango pedido
+    char *buffer;
+    size_t used;
+    int error;
+    int truncated;  // la cola del rango fue robada y la transferencia se corto a proposito
+    int checked;    // la respuesta ya se valido con el primer byte
+    int rejected;   // la respuesta no era el 206 pedido; no se escribio nada
+    CURL *curl;
+    ObjectInfo info;  // Content-Range de la respuesta
+    RangeTask *task;
+    pthread_mutex_t *mutex;  // protege task->end_byte y task->received
+} StreamWriter;
+
 typedef struct {
-    char *url;
     long start_byte;
     long end_byte;
-    char *output_buffer;
-    size_t bytes_downloaded;
-    int thread_id;
+    int64_t logical_end;  // bytes descargados en orden al completar este chunk
+    int pending;          // tareas del chunk sin terminar
     int success;
+    int done;
 } DownloadChunk;
 
+typedef struct {
+    size_t bytes;
+    int tasks;
+    int retries;
+    int steals;
+    double busy_seconds;
+} DownloadStats;
+
 typedef struct {
     DownloadChunk *chunks;
     int num_chunks;
+    int next_chunk;        // siguiente chunk a repartir, en orden de offset
+    int completed_prefix;  // chunks contiguos completados desde el primero
+    RangeTask *retry_queue;  // reintentos y colas robadas, antes que los chunks nuevos
+    RangeTask **active;    // tarea en curso de cada thread
+    DownloadStats *stats;  // por thread
+    int next_worker_id;
+    int failed;
     pthread_mutex_t progress_mutex;
     size_t total_downloaded;
     size_t total_size;
+    char *url;
+    int fd;
+    ByteWatermark *wm;
+    pthread_t *threads;
+    int num_threads;
+    double start_time;
 } DownloadContext;
 
 static size_t write_memory_callback(void *contents, size_t size, size_t nmemb, void *userp) {
@@ -46,7 +210,7 @@ static size_t write_memory_callback(void *contents, size_t size, size_t nmemb, v
         if (new_capacity < mem->size + realsize) {
             new_capacity = mem->size + realsize;
         }
-        char *new_data = (char *)malloc(new_capacity);
+        char *new_data = (char *)realloc(mem->data, new_capacity);
         if (new_data == NULL) {
             fprintf(stderr, "Error: No se pudo realocar memoria\n");
             return 0;
@@ -60,88 +224,378 @@ static size_t write_memory_callback(void *contents, size_t size, size_t nmemb, v
     return realsize;
 }
 
-long get_file_size(const char *url) {
-    CURL *curl;
-    CURLcode res;
-    long file_size = -1;
+static int flush_stream_writer(StreamWriter *writer) {
+    if (writer->used > 0) {
+        if (!pwrite_all(writer->fd, writer->buffer, writer->used, writer->offset)) {
+            writer->error = 1;
+            return 0;
+        }
+        writer->offset += writer->used;
+        writer->used = 0;
+    }
+    return 1;
+}
 
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, NULL);
-
-        res = curl_easy_perform(curl);
-
-        if (res == CURLE_OK) {
-            double content_length;
-            res = curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &content_length);
-            if (res == CURLE_OK && content_length > 0) {
-                file_size = (long)content_length;
-            }
+static size_t write_stream_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    StreamWriter *writer = (StreamWriter *)userp;
+    const char *src = (const char *)contents;
+
+    off_t pos = writer->offset + (off_t)writer->used;
+    off_t limit = writer->limit;
+    size_t accepted = realsize;
+
+    // Antes del primer byte: solo un 206 que arranca donde se pidio es parte del video
+    if (!writer->checked) {
+        long status = 0;
+        writer->checked = 1;
+        curl_easy_getinfo(writer->curl, CURLINFO_RESPONSE_CODE, &status);
+        if (status != 206 || writer->info.first != (long)writer->offset) {
+            fprintf(stderr, "Error: Respuesta inesperada al rango desde %ld: HTTP %ld, Content-Range desde %ld\n",
+                    (long)writer->offset, status, writer->info.first);
+            writer->rejected = 1;
+        }
+    }
+    if (writer->rejected) {
+        return 0;
+    }
+
+    if (writer->task) {
+        pthread_mutex_lock(writer->mutex);
+        limit = writer->task->end_byte + 1;
+        if (pos + (off_t)accepted > limit && limit < writer->limit) {
+            // Otro thread se llevo la cola: se escribe hasta el recorte y se corta
+            accepted = (pos < limit) ? (size_t)(limit - pos) : 0;
+            writer->truncated = 1;
+        }
+        writer->task->received = pos + accepted;
+        pthread_mutex_unlock(writer->mutex);
+    }
+
+    // Un servidor que ignora Range mandaria el objeto entero: se corta la transferencia
+    if (!writer->truncated && pos + (off_t)accepted > limit) {
+        fprintf(stderr, "Error: El servidor devolvio mas bytes que el rango pedido\n");
+        writer->error = 1;
+        return 0;
+    }
+
+    size_t remaining = accepted;
+    while (remaining > 0) {
+        size_t n = WRITE_BUFFER_SIZE - writer->used;
+        if (n > remaining) {
+            n = remaining;
+        }
+        memcpy(writer->buffer + writer->used, src, n);
+        writer->used += n;
+        src += n;
+        remaining -= n;
+
+        if (writer->used == WRITE_BUFFER_SIZE && !flush_stream_writer(writer)) {
+            return 0;
         }
+    }
+
+    return writer->truncated ? 0 : realsize;
+}
+
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    pthread_mutex_lock(&engine.share_locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userptr) {
+    pthread_mutex_unlock(&engine.share_locks[data]);
+}
+
+static void transfer_engine_init(void) {
+    memset(&engine, 0, sizeof(engine));
+    pthread_mutex_init(&engine.pool_mutex, NULL);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&engine.share_locks[i], NULL);
+    }
+
+    engine.share = curl_share_init();
+    if (engine.share) {
+        curl_share_setopt(engine.share, CURLSHOPT_LOCKFUNC, share_lock);
+        curl_share_setopt(engine.share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+        curl_share_setopt(engine.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(engine.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+}
+
+static void transfer_engine_cleanup(void) {
+    for (int i = 0; i < engine.num_idle; i++) {
+        curl_easy_cleanup(engine.idle[i]);
+    }
+    engine.num_idle = 0;
+    if (engine.share) {
+        curl_share_cleanup(engine.share);
+        engine.share = NULL;
+    }
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&engine.share_locks[i]);
+    }
+    pthread_mutex_destroy(&engine.pool_mutex);
+}
+
+// Toma un handle del pool (o crea uno) con las opciones comunes ya puestas
+static CURL *acquire_handle(void) {
+    CURL *curl = NULL;
+
+    pthread_mutex_lock(&engine.pool_mutex);
+    if (engine.num_idle > 0) {
+        curl = engine.idle[--engine.num_idle];
+    }
+    pthread_mutex_unlock(&engine.pool_mutex);
+
+    if (curl) {
+        curl_easy_reset(curl);  // conserva las conexiones abiertas del handle
+    } else if (!(curl = curl_easy_init())) {
+        return NULL;
+    }
+
+    if (engine.share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, engine.share);
+    }
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    return curl;
+}
+
+static void release_handle(CURL *curl) {
+    pthread_mutex_lock(&engine.pool_mutex);
+    if (engine.num_idle < MAX_POOLED_HANDLES) {
+        engine.idle[engine.num_idle++] = curl;
+        curl = NULL;
+    }
+    pthread_mutex_unlock(&engine.pool_mutex);
 
+    if (curl) {
         curl_easy_cleanup(curl);
     }
+}
 
-    return file_size;
+/*
+ * Toma el rango servido y el tamano total del objeto de
+ * "Content-Range: bytes a-b/total" y su ETag, que identifica el contenido
+ * para la cache del nodo
+ */
+static size_t object_info_callback(char *buffer, size_t size, size_t nitems, void *userp) {
+    size_t len = size * nitems;
+    ObjectInfo *info = (ObjectInfo *)userp;
+    const char *range_prefix = "content-range:";
+    const char *etag_prefix = "etag:";
+
+    if (len > strlen(range_prefix) && strncasecmp(buffer, range_prefix, strlen(range_prefix)) == 0) {
+        char value[128];
+        size_t value_len = len - strlen(range_prefix);
+        long first, last;
+        if (value_len >= sizeof(value)) {
+            value_len = sizeof(value) - 1;
+        }
+        memcpy(value, buffer + strlen(range_prefix), value_len);
+        value[value_len] = '\0';
+        if (sscanf(value, " bytes %ld-%ld", &first, &last) == 2) {
+            info->first = first;
+            info->last = last;
+        }
+        const char *slash = strchr(value, '/');
+        if (slash && slash[1] != '*') {
+            info->size = strtol(slash + 1, NULL, 10);
+        }
+    } else if (len > strlen(etag_prefix) && strncasecmp(buffer, etag_prefix, strlen(etag_prefix)) == 0) {
+        const char *value = buffer + strlen(etag_prefix);
+        const char *end = buffer + len;
+        while (value < end && (*value == ' ' || *value == '"')) {
+            value++;
+        }
+        while (end > value && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ' || end[-1] == '"')) {
+            end--;
+        }
+        if (end - value < (long)sizeof(info->etag)) {
+            memcpy(info->etag, value, end - value);
+            info->etag[end - value] = '\0';
+        }
+    }
+    return len;
 }
 
-void *download_chunk_thread(void *arg) {
-    DownloadChunk *chunk = (DownloadChunk *)arg;
+/*
+ * GET con Range [start_byte, end_byte] a memoria. Si info no es NULL devuelve
+ * ahi el tamano total y el ETag del objeto, lo que evita un HEAD aparte.
+ * Solo acepta un 206 cuyo Content-Range empiece en start_byte y cuadre con los
+ * bytes recibidos: un 200 con el objeto entero o el XML de un error no pueden
+ * pasar por datos del video.
+ */
+static int download_range(const char *url, long start_byte, long end_byte, MemoryBuffer *mem, int thread_id,
+                          ObjectInfo *info) {
     CURL *curl;
     CURLcode res;
-    MemoryBuffer mem = {0};
+    ObjectInfo local_info;
+    long status = 0;
 
-    mem.capacity = chunk->end_byte - chunk->start_byte + 1;
-    mem.data = (char *)malloc(mem.capacity);
-    if (mem.data == NULL) {
-        fprintf(stderr, "Thread %d: Error al asignar memoria\n", chunk->thread_id);
-        chunk->success = 0;
-        return NULL;
+    if (!info) {
+        info = &local_info;
+    }
+    info->size = -1;
+    info->etag[0] = '\0';
+    info->first = -1;
+    info->last = -1;
+
+    mem->size = 0;
+    mem->capacity = end_byte - start_byte + 1;
+    mem->data = (char *)malloc(mem->capacity);
+    if (mem->data == NULL) {
+        fprintf(stderr, "Thread %d: Error al asignar memoria\n", thread_id);
+        return 0;
     }
 
-    curl = curl_easy_init();
+    curl = acquire_handle();
     if (!curl) {
-        fprintf(stderr, "Thread %d: Error al inicializar curl\n", chunk->thread_id);
-        free(mem.data);
-        chunk->success = 0;
-        return NULL;
+        fprintf(stderr, "Thread %d: Error al inicializar curl\n", thread_id);
+        free(mem->data);
+        mem->data = NULL;
+        return 0;
     }
 
     char range[128];
-    snprintf(range, sizeof(range), "%ld-%ld", chunk->start_byte, chunk->end_byte);
+    snprintf(range, sizeof(range), "%ld-%ld", start_byte, end_byte);
 
-    curl_easy_setopt(curl, CURLOPT_URL, chunk->url);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_RANGE, range);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&mem);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);
-
-    printf("Thread %d: Descargando bytes %ld-%ld (%ld bytes)\n",
-           chunk->thread_id, chunk->start_byte, chunk->end_byte,
-           chunk->end_byte - chunk->start_byte + 1);
-    fflush(stdout);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)mem);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, object_info_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)info);
+    // Corta antes del cuerpo los errores y un 200 mas grande que el rango
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXFILESIZE_LARGE, (curl_off_t)mem->capacity);
 
     res = curl_easy_perform(curl);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    release_handle(curl);
 
     if (res != CURLE_OK) {
         fprintf(stderr, "Thread %d: Error en descarga: %s\n",
-                chunk->thread_id, curl_easy_strerror(res));
-        chunk->success = 0;
-    } else {
-        chunk->output_buffer = mem.data;
-        chunk->bytes_downloaded = mem.size;
-        chunk->success = 1;
-        printf("Thread %d: Descarga completada (%zu bytes)\n",
-               chunk->thread_id, mem.size);
-        fflush(stdout);
+                thread_id, curl_easy_strerror(res));
+        free(mem->data);
+        mem->data = NULL;
+        return 0;
     }
 
-    curl_easy_cleanup(curl);
-    return NULL;
+    if (status != 206 || info->first != start_byte || info->last < info->first || info->last > end_byte ||
+        (long)mem->size != info->last - info->first + 1) {
+        fprintf(stderr, "Thread %d: Respuesta inesperada al rango %s: HTTP %ld, %ld-%ld, %zu bytes\n",
+                thread_id, range, status, info->first, info->last, mem->size);
+        free(mem->data);
+        mem->data = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+static int env_int(const char *name, int default_value, int min_value, int max_value) {
+    const char *value = getenv(name);
+    if (!value || !*value) {
+        return default_value;
+    }
+    int n = atoi(value);
+    if (n < min_value) {
+        return min_value;
+    }
+    return (n > max_value) ? max_value : n;
+}
+
+/*
+ * Nucleos para el pipeline de frames del rank: los que el proceso puede usar
+ * repartidos entre los ranks de su nodo. DVP_THREADS_PER_RANK lo fija a mano.
+ */
+static int threads_per_rank(void) {
+    cpu_set_t set;
+    int cpus = (sched_getaffinity(0, sizeof(set), &set) == 0) ? CPU_COUNT(&set) : 0;
+    if (cpus <= 0) {
+        cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    int threads = cpus / topology.node_size;
+    return env_int("DVP_THREADS_PER_RANK", (threads > 0) ? threads : 1, 1, MAX_THREADS_PER_RANK);
+}
+
+/*
+ * Baja task hacia fd con pwrite a medida que llegan los bytes, reusando el
+ * buffer de escritura del thread. Devuelve 1 si el rango quedo completo (o
+ * se completo hasta donde otro thread robo la cola); en caso contrario deja
+ * en task->received hasta donde llego para retomar desde ahi.
+ */
+static int download_task(const char *url, int fd, RangeTask *task, char *buffer,
+                         pthread_mutex_t *mutex, int thread_id, int *write_failed) {
+    CURL *curl;
+    CURLcode res;
+    StreamWriter writer = {0};
+
+    writer.fd = fd;
+    writer.offset = task->start_byte;
+    writer.limit = task->end_byte + 1;
+    writer.buffer = buffer;
+    writer.task = task;
+    writer.mutex = mutex;
+    *write_failed = 0;
+
+    curl = acquire_handle();
+    if (!curl) {
+        fprintf(stderr, "Thread %d: Error al inicializar curl\n", thread_id);
+        return 0;
+    }
+
+    char range[128];
+    snprintf(range, sizeof(range), "%ld-%ld", task->start_byte, task->end_byte);
+
+    writer.curl = curl;
+    writer.info.size = -1;
+    writer.info.first = -1;
+    writer.info.last = -1;
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_RANGE, range);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_stream_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&writer);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, object_info_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)&writer.info);
+    // Un 4xx/5xx se corta antes del cuerpo: su XML no llega al archivo
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    // Una conexion estancada se corta y el rango se reintenta en vez de frenar el job
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1024L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 30L);
+
+    res = curl_easy_perform(curl);
+    release_handle(curl);
+
+    if (!writer.error) {
+        flush_stream_writer(&writer);
+    }
+
+    pthread_mutex_lock(mutex);
+    task->received = writer.offset;
+    long end_byte = task->end_byte;
+    pthread_mutex_unlock(mutex);
+
+    int complete = !writer.error && writer.offset == end_byte + 1;
+    if (complete && (res == CURLE_OK || writer.truncated)) {
+        return 1;
+    }
+
+    *write_failed = writer.error;
+    if (res != CURLE_OK || writer.error) {
+        const char *reason = writer.error      ? "escritura fallida"
+                             : writer.rejected ? "respuesta inesperada"
+                                               : curl_easy_strerror(res);
+        fprintf(stderr, "Thread %d: Error en descarga de bytes %ld-%ld: %s\n",
+                thread_id, task->start_byte, end_byte, reason);
+    } else {
+        fprintf(stderr, "Thread %d: Descarga incompleta (%ld de %ld bytes)\n",
+                thread_id, (long)writer.offset - task->start_byte, end_byte - task->start_byte + 1);
+    }
+    return 0;
 }
 
 char *generate_presigned_url(const char *bucket, const char *object_key) {
@@ -151,7 +605,9 @@ char *generate_presigned_url(const char *bucket, const char *object_key) {
         return NULL;
     }
 
-    snprintf(presigned_url, 1024, "%s/%s/%s", MINIO_ENDPOINT, bucket, object_key);
+    // DVP_S3_ENDPOINT apunta a otro servidor compatible con S3 (p.ej. bench/fake_s3.py)
+    const char *endpoint = getenv("DVP_S3_ENDPOINT");
+    snprintf(presigned_url, 1024, "%s/%s/%s", endpoint ? endpoint : MINIO_ENDPOINT, bucket, object_key);
 
     printf("URL publica generada: %s\n", presigned_url);
     fflush(stdout);
@@ -159,11 +615,7 @@ char *generate_presigned_url(const char *bucket, const char *object_key) {
     return presigned_url;
 }
 
-int download_video_parallel(const char *video_path, const char *output_file, int rank) {
-    if (rank != 0) {
-        return 1;
-    }
-
+static char *object_url(const char *video_path) {
     char bucket[256];
     char object_key[512];
 
@@ -171,219 +623,2283 @@ int download_video_parallel(const char *video_path, const char *output_file, int
     // extrae bucket (artifacts) y object_key (uploads/20260214/video_xxx.mp4)
     if (sscanf(video_path, "%255[^/]/%511s", bucket, object_key) != 2) {
         fprintf(stderr, "Error: video_path no tiene formato bucket/object: %s\n", video_path);
-        return 0;
+        return NULL;
     }
 
-    char *url = generate_presigned_url(bucket, object_key);
-    if (!url) {
-        return 0;
-    }
+    return generate_presigned_url(bucket, object_key);
+}
 
-    printf("Obteniendo tamano del archivo...\n");
-    fflush(stdout);
+static RangeTask *new_range_task(int chunk, long start_byte, long end_byte, int attempts) {
+    RangeTask *task = (RangeTask *)calloc(1, sizeof(RangeTask));
+    if (task) {
+        task->chunk = chunk;
+        task->start_byte = start_byte;
+        task->end_byte = end_byte;
+        task->received = start_byte;
+        task->attempts = attempts;
+    }
+    return task;
+}
 
-    long file_size = get_file_size(url);
-    if (file_size <= 0) {
-        fprintf(stderr, "Error: No se pudo obtener el tamano del archivo\n");
-        free(url);
-        return 0;
+// Con progress_mutex tomado. La cola de reintentos va en orden de offset para no frenar la marca de agua
+static void push_retry_task(DownloadContext *ctx, RangeTask *task) {
+    RangeTask **p = &ctx->retry_queue;
+    while (*p && (*p)->start_byte < task->start_byte) {
+        p = &(*p)->next;
     }
+    task->next = *p;
+    *p = task;
+}
 
-    printf("Tamano del archivo: %ld bytes (%.2f MB)\n",
-           file_size, file_size / (1024.0 * 1024.0));
-    fflush(stdout);
+/*
+ * Con progress_mutex tomado. Sin trabajo en cola, un thread ocioso parte a la
+ * mitad la tarea en curso con mas bytes por recibir y se queda con la cola:
+ * asi una conexion lenta no retiene al resto del job.
+ */
+static RangeTask *steal_range_task(DownloadContext *ctx) {
+    RangeTask *victim = NULL;
+    long victim_remaining = MIN_STEAL_SIZE;
+
+    for (int i = 0; i < ctx->num_threads; i++) {
+        RangeTask *task = ctx->active[i];
+        if (task && task->end_byte + 1 - task->received > victim_remaining) {
+            victim = task;
+            victim_remaining = task->end_byte + 1 - task->received;
+        }
+    }
+    if (!victim) {
+        return NULL;
+    }
 
-    int num_threads = NUM_DOWNLOAD_THREADS;
-    long chunk_size = file_size / num_threads;
+    long split = victim->received + victim_remaining / 2;
+    RangeTask *stolen = new_range_task(victim->chunk, split, victim->end_byte, 0);
+    if (stolen) {
+        victim->end_byte = split - 1;
+        ctx->chunks[victim->chunk].pending++;
+    }
+    return stolen;
+}
 
-    DownloadChunk *chunks = (DownloadChunk *)malloc(num_threads * sizeof(DownloadChunk));
-    pthread_t *threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+// Con progress_mutex tomado
+static RangeTask *next_range_task(DownloadContext *ctx, int *stolen) {
+    *stolen = 0;
+    if (ctx->failed) {
+        return NULL;
+    }
+    if (ctx->retry_queue) {
+        RangeTask *task = ctx->retry_queue;
+        ctx->retry_queue = task->next;
+        task->next = NULL;
+        return task;
+    }
+    if (ctx->next_chunk < ctx->num_chunks) {
+        DownloadChunk *chunk = &ctx->chunks[ctx->next_chunk];
+        RangeTask *task = new_range_task(ctx->next_chunk, chunk->start_byte, chunk->end_byte, 0);
+        if (!task) {
+            ctx->failed = 1;
+            return NULL;
+        }
+        chunk->pending = 1;
+        ctx->next_chunk++;
+        return task;
+    }
+    RangeTask *task = steal_range_task(ctx);
+    *stolen = (task != NULL);
+    return task;
+}
 
-    if (!chunks || !threads) {
-        fprintf(stderr, "Error al asignar memoria para threads\n");
-        free(url);
-        free(chunks);
-        free(threads);
+/*
+ * Con progress_mutex tomado. Lo que falta de una tarea fallida vuelve a la
+ * cola partido en dos, para que dos conexiones distintas lo reintenten.
+ * Devuelve 0 si se agotaron los intentos.
+ */
+static int requeue_failed_task(DownloadContext *ctx, RangeTask *task) {
+    if (task->attempts + 1 >= MAX_TASK_ATTEMPTS) {
         return 0;
     }
 
-    printf("Iniciando descarga paralela con %d threads...\n", num_threads);
-    fflush(stdout);
+    long start = task->received;
+    long end = task->end_byte;
+    long split = (end + 1 - start > MIN_STEAL_SIZE) ? start + (end + 1 - start) / 2 : end + 1;
 
-    for (int i = 0; i < num_threads; i++) {
-        chunks[i].url = url;
-        chunks[i].thread_id = i;
-        chunks[i].start_byte = i * chunk_size;
-        chunks[i].end_byte = (i == num_threads - 1) ? file_size - 1 : (i + 1) * chunk_size - 1;
-        chunks[i].output_buffer = NULL;
-        chunks[i].bytes_downloaded = 0;
-        chunks[i].success = 0;
-
-        if (pthread_create(&threads[i], NULL, download_chunk_thread, &chunks[i]) != 0) {
-            fprintf(stderr, "Error al crear thread %d\n", i);
-            for (int j = 0; j < i; j++) {
-                pthread_join(threads[j], NULL);
-            }
-            free(url);
-            free(chunks);
-            free(threads);
-            return 0;
-        }
+    RangeTask *first = new_range_task(task->chunk, start, split - 1, task->attempts + 1);
+    RangeTask *second = (split <= end) ? new_range_task(task->chunk, split, end, task->attempts + 1) : NULL;
+    if (!first || (split <= end && !second)) {
+        free(first);
+        free(second);
+        return 0;
+    }
+
+    push_retry_task(ctx, first);
+    if (second) {
+        push_retry_task(ctx, second);
+        ctx->chunks[task->chunk].pending++;
     }
+    return 1;
+}
 
-    for (int i = 0; i < num_threads; i++) {
-        pthread_join(threads[i], NULL);
+/*
+ * Los threads toman tareas de una cola compartida: primero reintentos, luego
+ * chunks nuevos en orden de offset y, cuando no queda nada, la mitad de la
+ * tarea mas atrasada de otro thread. Cada uno escribe con pwrite en su offset
+ * de fd a medida que llegan los bytes, asi que la memoria usada es
+ * WRITE_BUFFER_SIZE por thread sin importar el tamano del video. Al
+ * completarse un prefijo contiguo de chunks se publica la marca de agua para
+ * que el decodificador avance sin esperar el final.
+ */
+static void *download_worker_thread(void *arg) {
+    DownloadContext *ctx = (DownloadContext *)arg;
+    int worker_id;
+
+    pthread_mutex_lock(&ctx->progress_mutex);
+    worker_id = ctx->next_worker_id++;
+    pthread_mutex_unlock(&ctx->progress_mutex);
+
+    DownloadStats *stats = &ctx->stats[worker_id];
+    char *buffer = (char *)malloc(WRITE_BUFFER_SIZE);
+    if (buffer == NULL) {
+        fprintf(stderr, "Thread %d: Error al asignar memoria\n", worker_id);
+        return NULL;
     }
 
-    printf("Todos los threads completados, ensamblando archivo...\n");
-    fflush(stdout);
+    while (1) {
+        int stolen;
+        pthread_mutex_lock(&ctx->progress_mutex);
+        RangeTask *task = next_range_task(ctx, &stolen);
+        ctx->active[worker_id] = task;
+        pthread_mutex_unlock(&ctx->progress_mutex);
 
-    int all_success = 1;
-    for (int i = 0; i < num_threads; i++) {
-        if (!chunks[i].success) {
-            fprintf(stderr, "Error: Thread %d fallo en la descarga\n", i);
-            all_success = 0;
+        if (!task) {
+            break;
         }
-    }
 
-    if (!all_success) {
-        for (int i = 0; i < num_threads; i++) {
-            if (chunks[i].output_buffer) {
-                free(chunks[i].output_buffer);
+        if (stolen) {
+            printf("Thread %d: Roba bytes %ld-%ld de una conexion lenta\n",
+                   worker_id, task->start_byte, task->end_byte);
+            fflush(stdout);
+        } else if (task->attempts > 0) {
+            // Espera creciente antes de reintentar contra el mismo servidor
+            usleep(200000 * task->attempts);
+        }
+
+        double started = now_seconds();
+        int write_failed;
+        int success = download_task(ctx->url, ctx->fd, task, buffer, &ctx->progress_mutex,
+                                    worker_id, &write_failed);
+
+        pthread_mutex_lock(&ctx->progress_mutex);
+        ctx->active[worker_id] = NULL;
+        size_t bytes = task->received - task->start_byte;
+        DownloadChunk *chunk = &ctx->chunks[task->chunk];
+
+        stats->bytes += bytes;
+        stats->tasks++;
+        stats->steals += stolen;
+        stats->busy_seconds += now_seconds() - started;
+        ctx->total_downloaded += bytes;
+
+        if (success) {
+            chunk->pending--;
+        } else if (!write_failed && !ctx->failed && requeue_failed_task(ctx, task)) {
+            stats->retries++;
+        } else {
+            fprintf(stderr, "Thread %d: Se agotaron los intentos para bytes %ld-%ld\n",
+                    worker_id, task->received, task->end_byte);
+            ctx->failed = 1;
+        }
+        free(task);
+
+        if (chunk->pending == 0 && !ctx->failed) {
+            chunk->done = 1;
+            chunk->success = 1;
+        }
+        while (ctx->completed_prefix < ctx->num_chunks && ctx->chunks[ctx->completed_prefix].done &&
+               ctx->chunks[ctx->completed_prefix].success) {
+            ctx->completed_prefix++;
+        }
+        int64_t available = (ctx->completed_prefix > 0) ? ctx->chunks[ctx->completed_prefix - 1].logical_end : 0;
+        int failed = ctx->failed;
+        pthread_mutex_unlock(&ctx->progress_mutex);
+
+        if (ctx->wm) {
+            if (failed) {
+                watermark_fail(ctx->wm);
+            } else {
+                watermark_publish(ctx->wm, available);
             }
         }
-        free(url);
-        free(chunks);
-        free(threads);
-        return 0;
     }
 
-    FILE *fp = fopen(output_file, "wb");
-    if (!fp) {
-        fprintf(stderr, "Error: No se pudo crear el archivo de salida: %s\n", output_file);
-        for (int i = 0; i < num_threads; i++) {
-            if (chunks[i].output_buffer) {
-                free(chunks[i].output_buffer);
-            }
+    free(buffer);
+    return NULL;
+}
+
+/*
+ * Lanza en segundo plano la descarga de los rangos indicados, en ese orden,
+ * hacia fd. El contexto toma posesion de url y fd; finish_range_download
+ * espera a los threads y los libera. DVP_DOWNLOAD_THREADS y
+ * DVP_RANGE_SIZE_MB ajustan la cantidad de conexiones y el tamano de cada GET.
+ */
+static int start_range_download(DownloadContext *ctx, char *url, const ByteRange *ranges, int num_ranges,
+                                int fd, ByteWatermark *wm) {
+    memset(ctx, 0, sizeof(DownloadContext));
+    ctx->url = url;
+    ctx->fd = fd;
+    ctx->wm = wm;
+    ctx->start_time = now_seconds();
+    pthread_mutex_init(&ctx->progress_mutex, NULL);
+
+    int max_threads = env_int("DVP_DOWNLOAD_THREADS", DEFAULT_DOWNLOAD_THREADS, 1, MAX_DOWNLOAD_THREADS);
+    long range_task_size = (long)env_int("DVP_RANGE_SIZE_MB", DEFAULT_RANGE_TASK_MB, 1, 1024) * 1024 * 1024;
+
+    for (int r = 0; r < num_ranges; r++) {
+        ctx->total_size += ranges[r].end - ranges[r].start;
+    }
+
+    long task_size = (long)(ctx->total_size / max_threads);
+    if (task_size > range_task_size) {
+        task_size = range_task_size;
+    }
+    if (task_size < CHUNK_SIZE) {
+        task_size = CHUNK_SIZE;
+    }
+
+    for (int r = 0; r < num_ranges; r++) {
+        long len = ranges[r].end - ranges[r].start;
+        if (len > 0) {
+            ctx->num_chunks += (len + task_size - 1) / task_size;
         }
-        free(url);
-        free(chunks);
-        free(threads);
-        return 0;
     }
 
-    for (int i = 0; i < num_threads; i++) {
-        if (fwrite(chunks[i].output_buffer, 1, chunks[i].bytes_downloaded, fp) != chunks[i].bytes_downloaded) {
-            fprintf(stderr, "Error al escribir chunk %d al archivo\n", i);
-            fclose(fp);
-            for (int j = 0; j < num_threads; j++) {
-                if (chunks[j].output_buffer) {
-                    free(chunks[j].output_buffer);
-                }
-            }
-            free(url);
-            free(chunks);
-            free(threads);
+    // Reserva los bloques de una vez (solo los rangos pedidos: el archivo sigue disperso)
+    for (int r = 0; r < num_ranges; r++) {
+        long len = ranges[r].end - ranges[r].start;
+        if (len > 0 && fallocate(fd, 0, ranges[r].start, len) != 0 && errno != EOPNOTSUPP) {
+            fprintf(stderr, "Error: No se pudo reservar espacio para %ld bytes: %s\n", len, strerror(errno));
             return 0;
         }
     }
 
-    fclose(fp);
+    ctx->chunks = (DownloadChunk *)calloc(ctx->num_chunks > 0 ? ctx->num_chunks : 1, sizeof(DownloadChunk));
+    ctx->threads = (pthread_t *)malloc(max_threads * sizeof(pthread_t));
+    ctx->active = (RangeTask **)calloc(max_threads, sizeof(RangeTask *));
+    ctx->stats = (DownloadStats *)calloc(max_threads, sizeof(DownloadStats));
+    if (!ctx->chunks || !ctx->threads || !ctx->active || !ctx->stats) {
+        fprintf(stderr, "Error al asignar memoria para threads\n");
+        return 0;
+    }
 
-    for (int i = 0; i < num_threads; i++) {
-        if (chunks[i].output_buffer) {
-            free(chunks[i].output_buffer);
+    int c = 0;
+    int64_t logical = 0;
+    for (int r = 0; r < num_ranges; r++) {
+        for (long start = ranges[r].start; start < ranges[r].end; start += task_size) {
+            DownloadChunk *chunk = &ctx->chunks[c++];
+            chunk->start_byte = start;
+            chunk->end_byte = (start + task_size < ranges[r].end) ? start + task_size - 1 : ranges[r].end - 1;
+            logical += chunk->end_byte - chunk->start_byte + 1;
+            chunk->logical_end = logical;
         }
     }
 
-    free(url);
-    free(chunks);
-    free(threads);
+    int num_threads = (ctx->num_chunks < max_threads) ? ctx->num_chunks : max_threads;
 
-    printf("Descarga completada exitosamente: %s\n", output_file);
+    printf("Iniciando descarga paralela de %zu bytes en %d chunks de hasta %ld bytes con %d threads...\n",
+           ctx->total_size, ctx->num_chunks, task_size, num_threads);
     fflush(stdout);
 
+    // Los threads leen num_threads al robar: se fija antes de lanzarlos
+    pthread_mutex_lock(&ctx->progress_mutex);
+    for (; ctx->num_threads < num_threads; ctx->num_threads++) {
+        if (pthread_create(&ctx->threads[ctx->num_threads], NULL, download_worker_thread, ctx) != 0) {
+            fprintf(stderr, "Error al crear thread %d\n", ctx->num_threads);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ctx->progress_mutex);
+
+    if (ctx->num_threads == 0 && ctx->num_chunks > 0) {
+        return 0;
+    }
     return 1;
 }
 
-int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);
+static void abort_range_download(DownloadContext *ctx) {
+    pthread_mutex_lock(&ctx->progress_mutex);
+    ctx->failed = 1;
+    pthread_mutex_unlock(&ctx->progress_mutex);
+}
 
-    int rank, num_procs;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+static int finish_range_download(DownloadContext *ctx) {
+    for (int i = 0; i < ctx->num_threads; i++) {
+        pthread_join(ctx->threads[i], NULL);
+    }
 
-    if (argc < 4) {
-        if (rank == 0) {
-            fprintf(stderr, "Usage: %s <job_id> <video_path> <task> [params]\n", argv[0]);
+    double elapsed = now_seconds() - ctx->start_time;
+    stages.download += elapsed;
+    stages.bytes_downloaded += ctx->total_downloaded;
+    if (ctx->num_threads > 0) {
+        printf("Descarga: %zu bytes en %.2fs (%.2f MB/s)\n", ctx->total_downloaded, elapsed,
+               elapsed > 0 ? ctx->total_downloaded / (1024.0 * 1024.0) / elapsed : 0.0);
+        for (int i = 0; i < ctx->num_threads; i++) {
+            const DownloadStats *st = &ctx->stats[i];
+            printf("  Thread %d: %zu bytes, %d rangos, %d reintentos, %d robos, %.2f MB/s\n",
+                   i, st->bytes, st->tasks, st->retries, st->steals,
+                   st->busy_seconds > 0 ? st->bytes / (1024.0 * 1024.0) / st->busy_seconds : 0.0);
         }
-        MPI_Finalize();
-        return 1;
+        fflush(stdout);
     }
 
-    const char *job_id = argv[1];
-    const char *video_path = argv[2];
-    const char *task = argv[3];
-    const char *params = (argc > 4) ? argv[4] : "{}";
-    char output_file[512];
-
-    if (rank == 0) {
-        printf("========================================\n");
-        printf("PROCESS_VIDEO - Iniciando procesamiento\n");
-        printf("========================================\n");
-        printf("Job ID: %s\n", job_id);
-        printf("Video Path: %s\n", video_path);
-        printf("Task: %s\n", task);
-        printf("Params: %s\n", params);
-        printf("MPI Processes: %d\n", num_procs);
-        printf("========================================\n\n");
-        fflush(stdout);
+    int all_success = !ctx->failed && ctx->completed_prefix == ctx->num_chunks;
+    if (!all_success) {
+        fprintf(stderr, "Error: Fallo la descarga de %d de %d chunks\n",
+                ctx->num_chunks - ctx->completed_prefix, ctx->num_chunks);
+        if (ctx->wm) {
+            watermark_fail(ctx->wm);
+        }
+    }
 
-        curl_global_init(CURL_GLOBAL_DEFAULT);
+    if (ctx->fd >= 0) {
+        close(ctx->fd);
+    }
+    while (ctx->retry_queue) {
+        RangeTask *task = ctx->retry_queue;
+        ctx->retry_queue = task->next;
+        free(task);
+    }
+    free(ctx->url);
+    free(ctx->chunks);
+    free(ctx->threads);
+    free(ctx->active);
+    free(ctx->stats);
+    pthread_mutex_destroy(&ctx->progress_mutex);
+
+    return all_success;
+}
 
-        snprintf(output_file, sizeof(output_file), "/tmp/video_%s.mp4", job_id);
+static int download_ranges_parallel(char *url, const ByteRange *ranges, int num_ranges, int fd) {
+    DownloadContext ctx;
+    int started = start_range_download(&ctx, url, ranges, num_ranges, fd, NULL);
+    if (!started) {
+        abort_range_download(&ctx);
+    }
+    return finish_range_download(&ctx) && started;
+}
 
-        printf("Descargando video desde MinIO...\n");
-        fflush(stdout);
+/*
+ * object_size es el tamano ya conocido por un GET con Range previo; si es <= 0
+ * se obtiene del Content-Range de un GET del primer byte.
+ * Con cache_key no vacia primero busca el video en la cache del nodo, y si no
+ * esta lo guarda ahi al terminar de bajarlo.
+ */
+int download_video_parallel(const char *video_path, const char *output_file, int rank, long object_size,
+                            const char *cache_key) {
+    if (rank != 0) {
+        return 1;
+    }
 
-        if (!download_video_parallel(video_path, output_file, rank)) {
-            fprintf(stderr, "Error: Fallo la descarga del video\n");
-            curl_global_cleanup();
-            MPI_Finalize();
+    if (cache_key[0]) {
+        // output_file puede tener la metadata parcial de fetch_container_metadata
+        unlink(output_file);
+        if (video_cache_lookup(&video_cache, cache_key, output_file)) {
+            printf("Video en la cache del nodo (%s), no se descarga\n", cache_key);
+            fflush(stdout);
             return 1;
         }
+    }
 
-        printf("\n========================================\n");
-        printf("Descarga completada - Video disponible en: %s\n", output_file);
-        printf("========================================\n\n");
-        fflush(stdout);
-
-    printf("Iniciando descomposición del video...\n");
-    fflush(stdout);
+    char *url = object_url(video_path);
+    if (!url) {
+        return 0;
+    }
 
-    curl_global_cleanup();
-}
+    long file_size = object_size;
+    if (file_size <= 0) {
+        printf("Obteniendo tamano del archivo...\n");
+        fflush(stdout);
 
-MPI_Barrier(MPI_COMM_WORLD);
+        ObjectInfo info;
+        MemoryBuffer probe = {0};
+        if (download_range(url, 0, 0, &probe, 0, &info)) {
+            free(probe.data);
+            file_size = info.size;
+        }
+    }
+    if (file_size <= 0) {
+        fprintf(stderr, "Error: No se pudo obtener el tamano del archivo\n");
+        free(url);
+        return 0;
+    }
+
+    printf("Tamano del archivo: %ld bytes (%.2f MB)\n",
+           file_size, file_size / (1024.0 * 1024.0));
+    fflush(stdout);
 
-MPI_Bcast(output_file, 512, MPI_CHAR, 0, MPI_COMM_WORLD);
+    int fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: No se pudo crear el archivo de salida: %s\n", output_file);
+        free(url);
+        return 0;
+    }
 
-if (!decompose_video(output_file, rank, num_procs)) {
-    fprintf(stderr, "[Rank %d] Error en la descomposición del video\n", rank);
-    MPI_Finalize();
+    ByteRange whole = {0, file_size};
+    if (!download_ranges_parallel(url, &whole, 1, fd)) {
+        return 0;
+    }
+
+    printf("Descarga completada exitosamente: %s\n", output_file);
+    fflush(stdout);
+
+    if (cache_key[0]) {
+        video_cache_insert(&video_cache, cache_key, output_file);
+    }
+    return 1;
+}
+
+static uint64_t read_be(const unsigned char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/*
+ * Descarga solo las cajas de nivel superior del MP4 que no son mdat (ftyp,
+ * moov, free...) y la cabecera de mdat, en un archivo disperso del tamano
+ * del objeto. Con eso libavformat arma el indice de GOPs desde la tabla de
+ * muestras del moov sin bajar los datos de video.
+ * Devuelve 0 si el objeto no es un MP4 plano (p.ej. fragmentado). El tamano
+ * del objeto sale del Content-Range de la primera cabecera de caja y se
+ * devuelve en object_size aunque el contenedor no sirva.
+ */
+int fetch_container_metadata(const char *video_path, const char *output_file, long *object_size) {
+    *object_size = -1;
+    char *url = object_url(video_path);
+    if (!url) {
+        return 0;
+    }
+
+    ObjectInfo info = {-1, "", -1, -1};
+    MemoryBuffer first = {0};
+    int probed = download_range(url, 0, 15, &first, 0, &info);
+    *object_size = info.size;
+    if (!probed || *object_size <= 0) {
+        fprintf(stderr, "Error: No se pudo obtener el tamano del archivo\n");
+        free(first.data);
+        free(url);
+        return 0;
+    }
+    long file_size = *object_size;
+
+    int fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, file_size) != 0) {
+        fprintf(stderr, "Error: No se pudo crear el archivo de salida: %s\n", output_file);
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(first.data);
+        free(url);
+        return 0;
+    }
+
+    int ok = 1;
+    int found_moov = 0;
+    long fetched = 0;
+    long offset = 0;
+
+    for (int boxes = 0; ok && offset < file_size && boxes < MAX_TOP_LEVEL_BOXES; boxes++) {
+        // La primera cabecera ya llego con el GET que dio el tamano
+        MemoryBuffer mem = first;
+        first.data = NULL;
+        long header_end = (offset + 16 <= file_size) ? offset + 15 : file_size - 1;
+        if ((offset > 0 && !download_range(url, offset, header_end, &mem, 0, NULL)) || mem.size < 8) {
+            free(mem.data);
+            ok = 0;
+            break;
+        }
+
+        const unsigned char *h = (const unsigned char *)mem.data;
+        char type[5] = {(char)h[4], (char)h[5], (char)h[6], (char)h[7], '\0'};
+        long header_size = 8;
+        long box_size = (long)read_be(h, 4);
+        if (box_size == 1 && mem.size >= 16) {
+            box_size = (long)read_be(h + 8, 8);
+            header_size = 16;
+        } else if (box_size == 0) {
+            box_size = file_size - offset;
+        }
+
+        if (box_size < header_size || offset + box_size > file_size ||
+            strspn(type, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ") != 4 ||
+            strcmp(type, "moof") == 0) {
+            fprintf(stderr, "Error: Caja '%s' no soportada en offset %ld, se requiere MP4 no fragmentado\n",
+                    type, offset);
+            free(mem.data);
+            ok = 0;
+            break;
+        }
+
+        if (strcmp(type, "mdat") == 0) {
+            ok = pwrite_all(fd, mem.data, header_size, offset);
+            fetched += header_size;
+        } else {
+            MemoryBuffer box = {0};
+            ok = download_range(url, offset, offset + box_size - 1, &box, 0, NULL) &&
+                 pwrite_all(fd, box.data, box.size, offset);
+            fetched += box.size;
+            free(box.data);
+            if (strcmp(type, "moov") == 0) {
+                found_moov = 1;
+            }
+        }
+
+        free(mem.data);
+        offset += box_size;
+    }
+
+    close(fd);
+    free(first.data);
+    free(url);
+
+    if (!ok || !found_moov) {
+        fprintf(stderr, "Error: No se pudo leer el moov del contenedor\n");
+        return 0;
+    }
+
+    printf("Metadatos del contenedor descargados: %ld de %ld bytes\n", fetched, file_size);
+    fflush(stdout);
+
+    return 1;
+}
+
+/*
+ * Cada rank baja directamente de MinIO solo lo que necesita: cabecera y cola
+ * del contenedor (el rank 0 ya las tiene de fetch_container_metadata) y el
+ * rango de bytes de los GOPs [first_gop, end_gop). Con with_container = 0 el
+ * video local ya existe y solo se agregan los GOPs (otro lote del reparto
+ * dinamico). La descarga queda corriendo en segundo plano y publica su avance
+ * en wm; si devuelve 1 hay que cerrarla con finish_range_download.
+ */
+static int fetch_gop_ranges(const char *video_path, const char *local_file, const GopIndex *index,
+                            int first_gop, int end_gop, int rank, int with_container,
+                            DownloadContext *dl, ByteWatermark *wm) {
+    char *url = object_url(video_path);
+    if (!url) {
+        return 0;
+    }
+
+    int fd;
+    if (rank == 0 || !with_container) {
+        fd = open(local_file, O_WRONLY);
+    } else {
+        fd = open(local_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0 && ftruncate(fd, index->file_size) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        fprintf(stderr, "[Rank %d] Error: No se pudo preparar el video local %s\n", rank, local_file);
+        free(url);
+        return 0;
+    }
+
+    // Primero cabecera y cola: el demuxer las necesita antes que cualquier GOP
+    ByteRange ranges[3];
+    int num_ranges = 0;
+    if (rank != 0 && with_container) {
+        ranges[num_ranges].start = 0;
+        ranges[num_ranges++].end = index->header_end;
+        ranges[num_ranges].start = index->trailer_start;
+        ranges[num_ranges++].end = index->file_size;
+    }
+    gop_span(index, first_gop, end_gop, &ranges[num_ranges++]);
+
+    watermark_init(wm, ranges, num_ranges);
+    if (!start_range_download(dl, url, ranges, num_ranges, fd, wm)) {
+        abort_range_download(dl);
+        finish_range_download(dl);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Modo master con contenedor indexable: el rank 0 ya tiene la metadata y baja
+ * el resto del video en orden de offset, publicando la marca de agua para que
+ * la distribucion envie cada span en cuanto esta en disco. Con whole baja el
+ * objeto entero, incluidos los bytes de mdat fuera de los GOPs, para poder
+ * guardarlo en la cache.
+ */
+static int start_master_download(const char *video_path, const char *output_file, const GopIndex *index,
+                                 int whole, DownloadContext *dl, ByteWatermark *wm) {
+    char *url = object_url(video_path);
+    if (!url) {
+        return 0;
+    }
+
+    int fd = open(output_file, O_WRONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: No se pudo abrir el archivo de salida: %s\n", output_file);
+        free(url);
+        return 0;
+    }
+
+    // Solo los bytes de los GOPs del indice (en un cut, los de la ventana)
+    ByteRange media = {index->trailer_start, index->header_end};
+    for (int g = 0; g < index->num_gops; g++) {
+        if (index->gops[g].byte_start < media.start) {
+            media.start = index->gops[g].byte_start;
+        }
+        if (index->gops[g].byte_end > media.end) {
+            media.end = index->gops[g].byte_end;
+        }
+    }
+    if (whole) {
+        media.start = 0;
+        media.end = index->file_size;
+    }
+    watermark_init(wm, &media, 1);
+    if (!start_range_download(dl, url, &media, 1, fd, wm)) {
+        abort_range_download(dl);
+        finish_range_download(dl);
+        return 0;
+    }
+    return 1;
+}
+
+// Copia entera del video que el rank 0 baja aparte para la cache mientras el job corre en modo directo
+typedef struct {
+    char file[512];
+    DownloadContext download;
+    ByteWatermark watermark;
+    int active;
+} CacheFill;
+
+static int start_cache_fill(CacheFill *fill, const char *video_path, const char *job_id, const GopIndex *index) {
+    snprintf(fill->file, sizeof(fill->file), "/tmp/video_%s_cache.mp4", job_id);
+    int fd = open(fill->file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return 0;
+    }
+    close(fd);
+
+    fill->active = start_master_download(video_path, fill->file, index, 1, &fill->download, &fill->watermark);
+    if (!fill->active) {
+        unlink(fill->file);
+        return 0;
+    }
+    printf("Video fuera de la cache: el rank 0 lo baja entero en segundo plano para guardarlo\n");
+    fflush(stdout);
     return 1;
 }
 
-MPI_Barrier(MPI_COMM_WORLD);
+// Espera la copia (o la corta si keep es 0) y, si llego entera, la guarda con key
+static void finish_cache_fill(CacheFill *fill, const char *key, int keep) {
+    if (!fill->active) {
+        return;
+    }
+    if (!keep) {
+        abort_range_download(&fill->download);
+    }
+    int ok = finish_range_download(&fill->download) && keep;
+    watermark_destroy(&fill->watermark);
+    if (ok) {
+        video_cache_insert(&video_cache, key, fill->file);
+    }
+    unlink(fill->file);
+    fill->active = 0;
+}
+
+// GET de un byte: tamano total y ETag del objeto sin bajarlo
+static int probe_object(const char *video_path, ObjectInfo *info) {
+    info->size = -1;
+    info->etag[0] = '\0';
+    char *url = object_url(video_path);
+    if (!url) {
+        return 0;
+    }
+
+    MemoryBuffer probe = {0};
+    int probed = download_range(url, 0, 0, &probe, 0, info);
+    free(probe.data);
+    free(url);
+    return probed && info->size > 0 && info->etag[0];
+}
+
+/*
+ * Rank 0: busca el video en la cache del nodo por el ETag y el tamano de info
+ * (de probe_object; size -1 si no se pudo). Con hit deja el video enlazado en
+ * output_file y su indice en index. Sin hit deja en key la clave con la que
+ * guardarlo (vacia si no se puede cachear).
+ */
+static int lookup_cached_video(const char *video_path, const ObjectInfo *info, const char *output_file, char *key,
+                               GopIndex *index) {
+    key[0] = '\0';
+    if (video_cache.budget <= 0 || info->size <= 0) {
+        return 0;
+    }
+
+    video_cache_key(video_path, info->etag, info->size, key);
+    if (!video_cache_lookup(&video_cache, key, output_file)) {
+        return 0;
+    }
+    if (!video_cache_load_index(&video_cache, key, index)) {
+        if (!build_gop_index(output_file, index)) {
+            unlink(output_file);
+            return 0;
+        }
+        video_cache_store_index(&video_cache, key, index);
+    }
 
-if (rank == 0) {
-    printf("\n========================================\n");
-    printf("Descomposición completada exitosamente\n");
-    printf("Task: %s\n", task);
-    printf("Archivo local: %s\n", output_file);
-    printf("========================================\n\n");
+    printf("Video en la cache del nodo (%s): %.2f MB sin descargar\n", key, info->size / (1024.0 * 1024.0));
     fflush(stdout);
+    return 1;
+}
+
+/*
+ * DVP_INPUT_MEMORY=1: la copia local del video de entrada vive en un memfd,
+ * en RAM, en lugar de un archivo de /tmp. Se nombra por /proc/self/fd/N, asi
+ * la descarga (pwrite), la distribucion (mmap), el indice (libavformat) y el
+ * AVIOContext del decoder la abren como a cualquier archivo y el video nunca
+ * pasa por el disco. Devuelve el fd, a cerrar al terminar el job, o -1 sin
+ * tocar path.
+ */
+static int open_memory_input(const char *job_id, char *path, size_t size) {
+    if (!env_int("DVP_INPUT_MEMORY", 0, 0, 1)) {
+        return -1;
+    }
+
+    char name[160];
+    snprintf(name, sizeof(name), "video_%s", job_id);
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Aviso: No se pudo crear el video en memoria (%s), se usa %s\n", strerror(errno), path);
+        return -1;
+    }
+    snprintf(path, size, "/proc/self/fd/%d", fd);
+    return fd;
+}
+
+/*
+ * En un cut el indice se reduce a los GOPs de la ventana y en extract_frames a
+ * los GOPs con algun instante de captura: el resto ni se descarga ni se decodifica.
+ */
+static int apply_task_window(GopIndex *index, const TaskConfig *cfg) {
+    if (cfg->frames) {
+        double *times = NULL;
+        int num_times = frame_targets(cfg, index, &times);
+        int ok = num_times > 0 && select_gop_index(index, times, num_times);
+        if (num_times == 0) {
+            fprintf(stderr, "Error: Ningun instante de captura cae dentro del video (%.3fs)\n", index->end_time);
+        }
+        free(times);
+        if (!ok) {
+            free_gop_index(index);
+        }
+        return ok;
+    }
+    if (!cfg->cut) {
+        return 1;
+    }
+    if (!slice_gop_index(index, cfg->cut_start, cfg->cut_end)) {
+        fprintf(stderr, "Error: La ventana de cut (desde %.3fs) esta fuera del video\n", cfg->cut_start);
+        free_gop_index(index);
+        return 0;
+    }
+    return 1;
+}
+
+// Los segmentos se nombran por su primer GOP: en el reparto dinamico un rank tiene varios
+static void segment_path(char *path, size_t size, const char *job_id, int first_gop, const char *extension) {
+    snprintf(path, size, "/tmp/segment_%s_gop%d.%s", job_id, first_gop, extension);
+}
+
+// Borra los segmentos que este rank produjo o recibio
+static void remove_segments(const char *job_id, const GopBatch *batches, int num_batches,
+                            const char *extension, int rank) {
+    for (int b = 0; b < num_batches; b++) {
+        if (rank == 0 || batches[b].owner == rank) {
+            char path[512];
+            segment_path(path, sizeof(path), job_id, batches[b].first_gop, extension);
+            unlink(path);
+        }
+    }
+}
+
+/*
+ * Junta en el rank 0 los segmentos procesados y los concatena en output_file,
+ * en el orden de la tabla de lotes (un lote por segmento, ordenados por GOP).
+ */
+static int assemble_output(const GopIndex *index, const TaskConfig *cfg, const char *job_id,
+                           const char *output_file, int rank, int num_procs,
+                           const GopBatch *batches, int num_batches) {
+    char (*segments)[512] = (char (*)[512])calloc(num_batches, sizeof(*segments));
+    const char **files = (const char **)calloc(num_batches, sizeof(char *));
+    int *owners = (int *)calloc(num_batches, sizeof(int));
+    int *first_gops = (int *)calloc(num_batches, sizeof(int));
+    int ok = (segments && files && owners && first_gops);
+
+    for (int b = 0; ok && b < num_batches; b++) {
+        segment_path(segments[b], sizeof(segments[b]), job_id, batches[b].first_gop, cfg->extension);
+        files[b] = segments[b];
+        owners[b] = batches[b].owner;
+        first_gops[b] = batches[b].first_gop;
+    }
+
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, topology.comm);
+    if (all_ok) {
+        all_ok = gather_segments(files, owners, num_batches, topology.comm, rank, num_procs);
+    }
+
+    if (rank == 0 && all_ok) {
+        printf("Concatenando %d segmentos en %s...\n", num_batches, output_file);
+        fflush(stdout);
+        all_ok = cfg->frames ? concat_frame_archives(files, num_batches, output_file)
+                             : concat_segments(index, files, first_gops, num_batches, cfg, output_file);
+    }
+    remove_segments(job_id, batches, num_batches, cfg->extension, rank);
+    MPI_Bcast(&all_ok, 1, MPI_INT, 0, topology.comm);
+
+    free(segments);
+    free(files);
+    free(owners);
+    free(first_gops);
+    return all_ok;
+}
+
+/*
+ * Subida multipart: cada parte es un PUT de un tramo del resultado mapeado en
+ * memoria, asi que no hay buffers por thread. Los threads toman partes en
+ * orden y reintentan cada una hasta MAX_TASK_ATTEMPTS veces.
+ */
+typedef struct {
+    const char *url;
+    const char *upload_id;
+    const char *data;
+    int64_t size;
+    int64_t part_size;
+    int num_parts;
+    int next_part;
+    char (*etags)[128];
+    int failed;
+    int64_t uploaded;
+    pthread_mutex_t mutex;
+} UploadContext;
+
+// Firma SigV4 con DVP_S3_ACCESS_KEY/DVP_S3_SECRET_KEY; sin credenciales el pedido va anonimo
+static void sign_s3_request(CURL *curl) {
+    const char *access_key = getenv("DVP_S3_ACCESS_KEY");
+    const char *secret_key = getenv("DVP_S3_SECRET_KEY");
+    if (access_key && secret_key) {
+        curl_easy_setopt(curl, CURLOPT_AWS_SIGV4, "aws:amz:us-east-1:s3");
+        curl_easy_setopt(curl, CURLOPT_USERNAME, access_key);
+        curl_easy_setopt(curl, CURLOPT_PASSWORD, secret_key);
+    }
+}
+
+/*
+ * Un pedido S3 con el cuerpo en memoria (body puede ser NULL). content_type
+ * solo va al crear el objeto; header es una cabecera extra o NULL. Devuelve
+ * el codigo HTTP, o 0 si no hubo respuesta. El cuerpo de la respuesta queda
+ * en response y el ETag en info, si no son NULL.
+ */
+static long s3_request(const char *method, const char *url, const char *content_type, const char *header,
+                       const char *body, size_t body_size, MemoryBuffer *response, ObjectInfo *info) {
+    CURL *curl = acquire_handle();
+    if (!curl) {
+        return 0;
+    }
+
+    MemoryBuffer discard = {0};
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body ? body : "");
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)(body ? body_size : 0));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)(response ? response : &discard));
+    if (info) {
+        info->size = -1;
+        info->etag[0] = '\0';
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, object_info_callback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)info);
+    }
+    // Sin "Expect:" curl espera un RTT antes de cada parte; sin Content-Type pondria el de un formulario
+    char type_header[128];
+    snprintf(type_header, sizeof(type_header), "Content-Type: %s", content_type ? content_type : "");
+    struct curl_slist *headers = curl_slist_append(NULL, "Expect:");
+    headers = curl_slist_append(headers, content_type ? type_header : "Content-Type:");
+    if (header) {
+        headers = curl_slist_append(headers, header);
+    }
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    sign_s3_request(curl);
+
+    long status = 0;
+    CURLcode res = curl_easy_perform(curl);
+    if (res == CURLE_OK) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    } else {
+        fprintf(stderr, "Error en %s %s: %s\n", method, url, curl_easy_strerror(res));
+    }
+    release_handle(curl);
+    curl_slist_free_all(headers);
+    free(discard.data);
+    return status;
+}
+
+// Un video que no esta en el bucket no aparece reintentando el job
+static int object_missing(const char *video_path) {
+    char *url = object_url(video_path);
+    long status = url ? s3_request("GET", url, NULL, "Range: bytes=0-0", NULL, 0, NULL, NULL) : 0;
+    free(url);
+    return status == 404;
+}
+
+// Copia a out el texto entre <tag> y </tag> de la respuesta XML
+static int xml_value(const MemoryBuffer *xml, const char *tag, char *out, size_t out_size) {
+    char open_tag[64];
+    char close_tag[64];
+    snprintf(open_tag, sizeof(open_tag), "<%s>", tag);
+    snprintf(close_tag, sizeof(close_tag), "</%s>", tag);
+
+    char *text = strndup(xml->data ? xml->data : "", xml->size);
+    char *start = text ? strstr(text, open_tag) : NULL;
+    char *end = start ? strstr(start, close_tag) : NULL;
+    int found = end && (size_t)(end - start - strlen(open_tag)) < out_size;
+    if (found) {
+        start += strlen(open_tag);
+        memcpy(out, start, end - start);
+        out[end - start] = '\0';
+    }
+    free(text);
+    return found;
+}
+
+static void *upload_worker_thread(void *arg) {
+    UploadContext *ctx = (UploadContext *)arg;
+    size_t url_size = strlen(ctx->url) + strlen(ctx->upload_id) + 64;
+    char *url = (char *)malloc(url_size);
+    if (!url) {
+        pthread_mutex_lock(&ctx->mutex);
+        ctx->failed = 1;
+        pthread_mutex_unlock(&ctx->mutex);
+        return NULL;
+    }
+
+    while (1) {
+        pthread_mutex_lock(&ctx->mutex);
+        int part = ctx->failed ? ctx->num_parts : ctx->next_part++;
+        pthread_mutex_unlock(&ctx->mutex);
+        if (part >= ctx->num_parts) {
+            break;
+        }
+
+        int64_t offset = part * ctx->part_size;
+        size_t len = (size_t)((ctx->size - offset < ctx->part_size) ? ctx->size - offset : ctx->part_size);
+        snprintf(url, url_size, "%s?partNumber=%d&uploadId=%s", ctx->url, part + 1, ctx->upload_id);
+
+        ObjectInfo info;
+        long status = 0;
+        for (int attempt = 0; attempt < MAX_TASK_ATTEMPTS && status != 200; attempt++) {
+            if (attempt > 0) {
+                usleep(200000 * attempt);
+            }
+            status = s3_request("PUT", url, NULL, NULL, ctx->data + offset, len, NULL, &info);
+        }
+
+        pthread_mutex_lock(&ctx->mutex);
+        if (status == 200 && info.etag[0]) {
+            snprintf(ctx->etags[part], sizeof(ctx->etags[part]), "%s", info.etag);
+            ctx->uploaded += len;
+        } else {
+            fprintf(stderr, "Error: Fallo la subida de la parte %d (HTTP %ld)\n", part + 1, status);
+            ctx->failed = 1;
+        }
+        pthread_mutex_unlock(&ctx->mutex);
+    }
+
+    free(url);
+    return NULL;
+}
+
+// CompleteMultipartUpload con el ETag de cada parte, en orden
+static int complete_multipart(const UploadContext *ctx) {
+    size_t xml_size = 128 + (size_t)ctx->num_parts * 200;
+    char *xml = (char *)malloc(xml_size);
+    char *url = (char *)malloc(strlen(ctx->url) + strlen(ctx->upload_id) + 32);
+    if (!xml || !url) {
+        free(xml);
+        free(url);
+        return 0;
+    }
+
+    size_t len = snprintf(xml, xml_size, "<CompleteMultipartUpload>");
+    for (int p = 0; p < ctx->num_parts; p++) {
+        len += snprintf(xml + len, xml_size - len,
+                        "<Part><PartNumber>%d</PartNumber><ETag>\"%s\"</ETag></Part>", p + 1, ctx->etags[p]);
+    }
+    len += snprintf(xml + len, xml_size - len, "</CompleteMultipartUpload>");
+    sprintf(url, "%s?uploadId=%s", ctx->url, ctx->upload_id);
+
+    // S3 puede contestar 200 y reportar el error en el cuerpo
+    MemoryBuffer response = {0};
+    long status = s3_request("POST", url, "application/xml", NULL, xml, len, &response, NULL);
+    char code[128];
+    int ok = (status == 200) && !xml_value(&response, "Code", code, sizeof(code));
+    if (!ok) {
+        fprintf(stderr, "Error: CompleteMultipartUpload fallo (HTTP %ld)\n", status);
+    }
+
+    free(response.data);
+    free(xml);
+    free(url);
+    return ok;
+}
+
+static const char *result_content_type(const char *extension) {
+    if (strcmp(extension, "mp4") == 0) {
+        return "video/mp4";
+    } else if (strcmp(extension, "mov") == 0) {
+        return "video/quicktime";
+    } else if (strcmp(extension, "webm") == 0) {
+        return "video/webm";
+    } else if (strcmp(extension, "mkv") == 0) {
+        return "video/x-matroska";
+    } else if (strcmp(extension, "tar") == 0) {
+        return "application/x-tar";
+    }
+    return "application/octet-stream";
+}
+
+/*
+ * Rank 0: sube result_file a bucket/object_key. Un resultado de hasta una parte
+ * va en un solo PUT; uno mas grande va por multipart, con DVP_DOWNLOAD_THREADS
+ * partes de DVP_UPLOAD_PART_MB en vuelo sobre las conexiones del pool, y solo
+ * se completa si subieron todas (si no, se aborta para no dejar partes).
+ */
+static int upload_result(const char *result_file, const char *bucket, const char *object_key,
+                         const char *content_type) {
+    char *url = generate_presigned_url(bucket, object_key);
+    if (!url) {
+        return 0;
+    }
+
+    int fd = open(result_file, O_RDONLY);
+    struct stat st;
+    char *data = NULL;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!data) {
+        fprintf(stderr, "Error: No se pudo leer el resultado %s\n", result_file);
+        free(url);
+        return 0;
+    }
+
+    int64_t part_size = (int64_t)env_int("DVP_UPLOAD_PART_MB", DEFAULT_UPLOAD_PART_MB, MIN_UPLOAD_PART_MB, 1024) *
+                        1024 * 1024;
+    // S3 acepta hasta MAX_UPLOAD_PARTS partes: en resultados enormes se agrandan
+    while ((st.st_size + part_size - 1) / part_size > MAX_UPLOAD_PARTS) {
+        part_size *= 2;
+    }
+
+    double started = now_seconds();
+    int ok = 0;
+    UploadContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.url = url;
+    ctx.data = data;
+    ctx.size = st.st_size;
+    ctx.part_size = part_size;
+    ctx.num_parts = (int)((st.st_size + part_size - 1) / part_size);
+
+    if (ctx.num_parts == 1) {
+        ok = s3_request("PUT", url, content_type, NULL, data, st.st_size, NULL, NULL) == 200;
+        if (!ok) {
+            fprintf(stderr, "Error: Fallo el PUT del resultado\n");
+        }
+    } else {
+        MemoryBuffer response = {0};
+        char upload_id[512];
+        char *init_url = (char *)malloc(strlen(url) + 16);
+        if (init_url) {
+            sprintf(init_url, "%s?uploads", url);
+        }
+        int started_upload = init_url &&
+                             s3_request("POST", init_url, content_type, NULL, NULL, 0, &response, NULL) == 200 &&
+                             xml_value(&response, "UploadId", upload_id, sizeof(upload_id));
+        free(init_url);
+        free(response.data);
+
+        if (!started_upload) {
+            fprintf(stderr, "Error: No se pudo iniciar la subida multipart\n");
+        } else {
+            ctx.upload_id = upload_id;
+            ctx.etags = (char (*)[128])calloc(ctx.num_parts, sizeof(*ctx.etags));
+            pthread_mutex_init(&ctx.mutex, NULL);
+
+            int max_threads = env_int("DVP_DOWNLOAD_THREADS", DEFAULT_DOWNLOAD_THREADS, 1, MAX_DOWNLOAD_THREADS);
+            int num_threads = (ctx.num_parts < max_threads) ? ctx.num_parts : max_threads;
+            pthread_t threads[MAX_DOWNLOAD_THREADS];
+            int launched = 0;
+            ctx.failed = (ctx.etags == NULL);
+            for (int t = 0; t < num_threads && !ctx.failed; t++) {
+                if (pthread_create(&threads[t], NULL, upload_worker_thread, &ctx) == 0) {
+                    launched++;
+                }
+            }
+            for (int t = 0; t < launched; t++) {
+                pthread_join(threads[t], NULL);
+            }
+
+            ok = launched > 0 && !ctx.failed && complete_multipart(&ctx);
+            if (!ok) {
+                char abort_url[1024];
+                snprintf(abort_url, sizeof(abort_url), "%s?uploadId=%s", url, upload_id);
+                s3_request("DELETE", abort_url, NULL, NULL, NULL, 0, NULL, NULL);
+            }
+            pthread_mutex_destroy(&ctx.mutex);
+            free(ctx.etags);
+        }
+    }
+
+    if (ok) {
+        double elapsed = now_seconds() - started;
+        printf("Resultado subido a %s/%s: %.2f MB en %d partes, %.2fs (%.1f MB/s)\n", bucket, object_key,
+               st.st_size / (1024.0 * 1024.0), ctx.num_parts, elapsed,
+               (elapsed > 0) ? st.st_size / (1024.0 * 1024.0) / elapsed : 0.0);
+        fflush(stdout);
+    }
+
+    munmap(data, st.st_size);
+    free(url);
+    return ok;
+}
+
+/*
+ * Cache de resultados (DVP_RESULT_CACHE). Un resultado se identifica por el
+ * contenido del video, la tarea y los params canonicos. El contenido es el
+ * ETag y el tamano que MinIO calculo al recibir el objeto: vienen en el GET
+ * de un byte que ya se hace para la cache del nodo, asi que la busqueda no
+ * espera a ninguna descarga, y el mismo video subido de nuevo con otro nombre
+ * da la misma identidad. Cada resultado subido deja una entrada en
+ * <bucket>/results/index/<clave>.json con la identidad completa y el objeto
+ * del resultado.
+ */
+typedef struct {
+    char key[VIDEO_CACHE_KEY_SIZE];  // nombre de la entrada
+    char *text;                      // identidad completa; NULL si el job no se cachea
+} ResultIdentity;
+
+// Ordena por clave los miembros de cada objeto, a cualquier profundidad
+static void sort_json_keys(cJSON *item) {
+    for (cJSON *child = item->child; child; child = child->next) {
+        sort_json_keys(child);
+    }
+    if (!cJSON_IsObject(item)) {
+        return;
+    }
+
+    cJSON *sorted = NULL;
+    cJSON *child = item->child;
+    while (child) {
+        cJSON *next = child->next;
+        cJSON **pos = &sorted;
+        while (*pos && strcmp((*pos)->string, child->string) <= 0) {
+            pos = &(*pos)->next;
+        }
+        child->next = *pos;
+        *pos = child;
+        child = next;
+    }
+
+    // cJSON espera en el prev del primer hijo al ultimo
+    cJSON *prev = NULL;
+    for (child = sorted; child; child = child->next) {
+        child->prev = prev;
+        prev = child;
+    }
+    if (sorted) {
+        sorted->prev = prev;
+    }
+    item->child = sorted;
 }
 
-MPI_Finalize();    return 0;
-}
\ No newline at end of file
+/*
+ * Identidad del resultado de task + params sobre el video de info. Los params
+ * se comparan ya parseados, con las claves ordenadas y sin "np", que solo
+ * elige cuantos ranks corren el job.
+ */
+static int result_identity(ResultIdentity *identity, const ObjectInfo *info, const char *task, const char *params) {
+    identity->text = NULL;
+    cJSON *json = cJSON_Parse(params);
+    if (!cJSON_IsObject(json)) {
+        cJSON_Delete(json);
+        return 0;
+    }
+    cJSON_DeleteItemFromObjectCaseSensitive(json, "np");
+    sort_json_keys(json);
+    char *canonical = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    if (!canonical) {
+        return 0;
+    }
+
+    size_t size = strlen(info->etag) + strlen(task) + strlen(canonical) + 64;
+    identity->text = (char *)malloc(size);
+    if (identity->text) {
+        snprintf(identity->text, size, "v%d %s %ld %s %s", RESULT_INDEX_VERSION, info->etag, info->size, task,
+                 canonical);
+        // El mismo hash de la cache de videos, con la identidad en lugar del nombre del objeto
+        video_cache_key(identity->text, info->etag, info->size, identity->key);
+    }
+    cJSON_free(canonical);
+    return identity->text != NULL;
+}
+
+/*
+ * Deja en object_key el resultado ya subido en source_key, copiado del lado
+ * del servidor (x-amz-copy-source): los bytes no pasan por el nodo.
+ */
+static int copy_result(const char *bucket, const char *source_key, const char *object_key) {
+    char *url = generate_presigned_url(bucket, object_key);
+    if (!url) {
+        return 0;
+    }
+
+    int ok;
+    if (strcmp(source_key, object_key) == 0) {
+        // Un rerun del mismo job: S3 no copia un objeto sobre si mismo, alcanza con que siga ahi
+        ObjectInfo info;
+        MemoryBuffer probe = {0};
+        ok = download_range(url, 0, 0, &probe, 0, &info) && info.size > 0;
+        free(probe.data);
+    } else {
+        char header[1024];
+        snprintf(header, sizeof(header), "x-amz-copy-source: /%s/%s", bucket, source_key);
+        // Como CompleteMultipartUpload, la copia puede contestar 200 con el error en el cuerpo
+        MemoryBuffer response = {0};
+        long status = s3_request("PUT", url, NULL, header, NULL, 0, &response, NULL);
+        char code[128];
+        ok = (status == 200) && !xml_value(&response, "Code", code, sizeof(code));
+        free(response.data);
+    }
+    free(url);
+    return ok;
+}
+
+/*
+ * Rank 0: busca la entrada de identity en el indice de resultados y, si
+ * coincide la identidad entera (dos pueden compartir hash) y el resultado
+ * sigue en el bucket, lo copia a object_key.
+ */
+static int reuse_cached_result(const ResultIdentity *identity, const char *bucket, const char *object_key) {
+    char entry_key[128];
+    snprintf(entry_key, sizeof(entry_key), RESULT_INDEX_PREFIX "/%s.json", identity->key);
+    char *url = generate_presigned_url(bucket, entry_key);
+    if (!url) {
+        return 0;
+    }
+
+    MemoryBuffer response = {0};
+    long status = s3_request("GET", url, NULL, NULL, NULL, 0, &response, NULL);
+    free(url);
+    cJSON *entry = (status == 200 && response.data) ? cJSON_ParseWithLength(response.data, response.size) : NULL;
+    free(response.data);
+
+    const cJSON *text = cJSON_GetObjectItemCaseSensitive(entry, "identity");
+    const cJSON *source = cJSON_GetObjectItemCaseSensitive(entry, "object");
+    const cJSON *job_id = cJSON_GetObjectItemCaseSensitive(entry, "job_id");
+    int ok = cJSON_IsString(text) && cJSON_IsString(source) && strcmp(text->valuestring, identity->text) == 0 &&
+             copy_result(bucket, source->valuestring, object_key);
+    if (ok) {
+        printf("Resultado reutilizado del job %s (%s/%s): sin descargar ni procesar el video\n",
+               cJSON_IsString(job_id) ? job_id->valuestring : "?", bucket, source->valuestring);
+        fflush(stdout);
+    } else if (entry) {
+        printf("Entrada %s del indice de resultados descartada\n", identity->key);
+        fflush(stdout);
+    }
+    cJSON_Delete(entry);
+    return ok;
+}
+
+// Rank 0: registra en el indice el resultado recien subido a object_key; si falla el job sigue igual
+static void record_cached_result(const ResultIdentity *identity, const char *bucket, const char *object_key,
+                                 const char *job_id) {
+    cJSON *entry = cJSON_CreateObject();
+    cJSON_AddStringToObject(entry, "identity", identity->text);
+    cJSON_AddStringToObject(entry, "object", object_key);
+    cJSON_AddStringToObject(entry, "job_id", job_id);
+    char *body = cJSON_PrintUnformatted(entry);
+    cJSON_Delete(entry);
+
+    char entry_key[128];
+    snprintf(entry_key, sizeof(entry_key), RESULT_INDEX_PREFIX "/%s.json", identity->key);
+    char *url = body ? generate_presigned_url(bucket, entry_key) : NULL;
+    if (!url || s3_request("PUT", url, "application/json", NULL, body, strlen(body), NULL, NULL) != 200) {
+        fprintf(stderr, "Aviso: No se pudo registrar el resultado en el indice (%s)\n", identity->key);
+    }
+    free(url);
+    if (body) {
+        cJSON_free(body);
+    }
+}
+
+/*
+ * Checkpoints por segmento (DVP_CHECKPOINT). Al empezar, el rank 0 escribe
+ * <bucket>/results/checkpoints/<job_id>/job.json con la identidad del
+ * resultado y la cantidad de GOPs del indice, y cada rank sube cada segmento
+ * terminado al mismo prefijo como gop<a>-<b>.<ext>. El objeto del segmento es
+ * su propio registro: no hay un manifiesto que todos reescriban, y al retomar
+ * se lista el prefijo. Un rerun del mismo job_id sobre el mismo video, tarea
+ * y params reparte solo los GOPs que faltan, con la cantidad de ranks que
+ * tenga, y concatena lo nuevo con lo retomado.
+ */
+typedef struct {
+    int enabled;
+    char bucket[128];
+    char job_id[128];
+    char extension[8];
+} Checkpoint;
+
+// Checkpoint del job en curso; el rank 0 lo arma y lo difunde
+static Checkpoint checkpoint;
+
+static void checkpoint_key(char *key, size_t size, int first_gop, int end_gop) {
+    if (first_gop < 0) {
+        snprintf(key, size, CHECKPOINT_PREFIX "/%s/job.json", checkpoint.job_id);
+    } else {
+        snprintf(key, size, CHECKPOINT_PREFIX "/%s/gop%d-%d.%s", checkpoint.job_id, first_gop, end_gop,
+                 checkpoint.extension);
+    }
+}
+
+// job.json de una corrida anterior; NULL si no existe o no se entiende
+static cJSON *load_checkpoint_job(void) {
+    char key[512];
+    checkpoint_key(key, sizeof(key), -1, -1);
+    char *url = generate_presigned_url(checkpoint.bucket, key);
+    if (!url) {
+        return NULL;
+    }
+
+    MemoryBuffer response = {0};
+    long status = s3_request("GET", url, NULL, NULL, NULL, 0, &response, NULL);
+    free(url);
+    cJSON *job = (status == 200 && response.data) ? cJSON_ParseWithLength(response.data, response.size) : NULL;
+    free(response.data);
+    if (!cJSON_IsObject(job)) {
+        cJSON_Delete(job);
+        return NULL;
+    }
+    return job;
+}
+
+// Escapa value para un parametro de query; todo lo que no es "unreserved" va como %XX
+static void query_escape(const char *value, char *out, size_t size) {
+    size_t used = 0;
+    for (const unsigned char *c = (const unsigned char *)value; *c && used + 4 <= size; c++) {
+        if (isalnum(*c) || *c == '-' || *c == '_' || *c == '.' || *c == '~') {
+            out[used++] = (char)*c;
+        } else {
+            used += snprintf(out + used, size - used, "%%%02X", *c);
+        }
+    }
+    out[used] = '\0';
+}
+
+/*
+ * Lista con ListObjectsV2 los segmentos que hay bajo el prefijo del job. Deja
+ * en segments sus [first_gop, end_gop), con owner 0 y en el orden del
+ * listado, y devuelve cuantos; -1 si no se pudo listar.
+ */
+static int list_checkpoint_segments(GopBatch **segments) {
+    char prefix[512];
+    char escaped_prefix[1536];
+    snprintf(prefix, sizeof(prefix), CHECKPOINT_PREFIX "/%s/", checkpoint.job_id);
+    query_escape(prefix, escaped_prefix, sizeof(escaped_prefix));
+
+    *segments = NULL;
+    int count = 0;
+    int capacity = 0;
+    char token[512] = "";
+    int truncated = 1;
+    while (truncated) {
+        char escaped_token[1536];
+        char query[3200];
+        query_escape(token, escaped_token, sizeof(escaped_token));
+        snprintf(query, sizeof(query), "?list-type=2&prefix=%s%s%s", escaped_prefix,
+                 token[0] ? "&continuation-token=" : "", escaped_token);
+        char *url = generate_presigned_url(checkpoint.bucket, query);
+        MemoryBuffer response = {0};
+        long status = url ? s3_request("GET", url, NULL, NULL, NULL, 0, &response, NULL) : 0;
+        free(url);
+        char *text = (status == 200) ? strndup(response.data ? response.data : "", response.size) : NULL;
+        if (!text) {
+            fprintf(stderr, "Aviso: No se pudo listar el checkpoint del job %s (HTTP %ld)\n", checkpoint.job_id,
+                    status);
+            free(response.data);
+            free(*segments);
+            *segments = NULL;
+            return -1;
+        }
+
+        for (char *key = strstr(text, "<Key>"); key; key = strstr(key, "<Key>")) {
+            key += strlen("<Key>");
+            int first, end;
+            if (strncmp(key, prefix, strlen(prefix)) != 0 ||
+                sscanf(key + strlen(prefix), "gop%d-%d.", &first, &end) != 2) {
+                continue;
+            }
+            if (count == capacity) {
+                capacity = capacity ? 2 * capacity : 64;
+                GopBatch *grown = (GopBatch *)realloc(*segments, capacity * sizeof(GopBatch));
+                if (!grown) {
+                    break;
+                }
+                *segments = grown;
+            }
+            GopBatch batch = {first, end, 0};
+            (*segments)[count++] = batch;
+        }
+        free(text);
+
+        char value[16];
+        truncated = xml_value(&response, "IsTruncated", value, sizeof(value)) && strcmp(value, "true") == 0 &&
+                    xml_value(&response, "NextContinuationToken", token, sizeof(token));
+        free(response.data);
+    }
+    return count;
+}
+
+// Borra un objeto del checkpoint (first_gop -1: job.json). Sin permiso de borrado queda hasta que expire
+static void delete_checkpoint_object(int first_gop, int end_gop) {
+    char key[512];
+    checkpoint_key(key, sizeof(key), first_gop, end_gop);
+    char *url = generate_presigned_url(checkpoint.bucket, key);
+    if (url) {
+        s3_request("DELETE", url, NULL, NULL, NULL, 0, NULL, NULL);
+        free(url);
+    }
+}
+
+static void delete_checkpoint_segments(const GopBatch *segments, int count) {
+    for (int b = 0; b < count; b++) {
+        delete_checkpoint_object(segments[b].first_gop, segments[b].end_gop);
+    }
+}
+
+static int compare_batches(const void *a, const void *b) {
+    return ((const GopBatch *)a)->first_gop - ((const GopBatch *)b)->first_gop;
+}
+
+// Un job.json del mismo video, tarea y params: sus segmentos se pueden retomar
+static int checkpoint_matches(const cJSON *job, const ResultIdentity *identity) {
+    const cJSON *text = cJSON_GetObjectItemCaseSensitive(job, "identity");
+    return cJSON_IsString(text) && strcmp(text->valuestring, identity->text) == 0;
+}
+
+/*
+ * Rank 0, con el indice ya recortado a la tarea: retoma los segmentos
+ * listados (de list_checkpoint_segments) si previous, el job.json leido al
+ * empezar, es del mismo video, tarea, params y cantidad de GOPs; si no, los
+ * borra y escribe un job.json nuevo. Deja al principio de segments los que se
+ * retoman, en orden de GOP y sin solaparse, y devuelve cuantos; -1 si no se
+ * pudo escribir job.json (el job sigue sin checkpoints).
+ */
+static int start_checkpoint(const cJSON *previous, const ResultIdentity *identity, int num_gops,
+                            GopBatch *segments, int num_segments) {
+    const cJSON *gops = cJSON_GetObjectItemCaseSensitive(previous, "num_gops");
+    if (checkpoint_matches(previous, identity) && cJSON_IsNumber(gops) && gops->valueint == num_gops) {
+        int count = 0;
+        for (int b = 0; b < num_segments; b++) {
+            if (segments[b].first_gop >= 0 && segments[b].first_gop < segments[b].end_gop &&
+                segments[b].end_gop <= num_gops) {
+                segments[count++] = segments[b];
+            }
+        }
+        qsort(segments, count, sizeof(GopBatch), compare_batches);
+
+        // Dos corridas con otro reparto pueden dejar segmentos solapados: gana el primero
+        int kept = 0;
+        for (int b = 0; b < count; b++) {
+            if (kept == 0 || segments[b].first_gop >= segments[kept - 1].end_gop) {
+                segments[kept++] = segments[b];
+            }
+        }
+        return kept;
+    }
+
+    if (num_segments > 0) {
+        // De otro video, tarea o params, o sin job.json: sus segmentos no sirven
+        printf("Checkpoint del job %s descartado: no corresponde a este video, tarea y params\n", checkpoint.job_id);
+        fflush(stdout);
+        delete_checkpoint_segments(segments, num_segments);
+    }
+
+    cJSON *job = cJSON_CreateObject();
+    cJSON_AddStringToObject(job, "job_id", checkpoint.job_id);
+    cJSON_AddStringToObject(job, "identity", identity->text);
+    cJSON_AddNumberToObject(job, "num_gops", num_gops);
+    char *body = cJSON_PrintUnformatted(job);
+    cJSON_Delete(job);
+    char key[512];
+    checkpoint_key(key, sizeof(key), -1, -1);
+    char *url = body ? generate_presigned_url(checkpoint.bucket, key) : NULL;
+    long status = url ? s3_request("PUT", url, "application/json", NULL, body, strlen(body), NULL, NULL) : 0;
+    free(url);
+    if (body) {
+        cJSON_free(body);
+    }
+    if (status != 200) {
+        fprintf(stderr, "Aviso: No se pudo crear el checkpoint del job (HTTP %ld), sigue sin checkpoints\n", status);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Sube el segmento [first_gop, end_gop) recien codificado; el objeto es el
+ * registro. Si falla el job sigue: solo ese segmento no se podra retomar.
+ */
+static void record_checkpoint(int first_gop, int end_gop, const char *segment_file, int rank) {
+    if (!checkpoint.enabled) {
+        return;
+    }
+
+    double started = now_seconds();
+    char key[512];
+    checkpoint_key(key, sizeof(key), first_gop, end_gop);
+    if (!upload_result(segment_file, checkpoint.bucket, key, result_content_type(checkpoint.extension))) {
+        fprintf(stderr, "[Rank %d] Aviso: No se pudo guardar el checkpoint de los GOPs %d a %d\n", rank, first_gop,
+                end_gop);
+    }
+    stages.upload += now_seconds() - started;
+}
+
+// Rank 0: baja los segmentos retomados a las rutas de segmento locales, como si los hubiera codificado
+static int fetch_checkpoint_segments(const GopBatch *restored, int count) {
+    for (int b = 0; b < count; b++) {
+        char key[512];
+        char object[768];
+        char path[512];
+        checkpoint_key(key, sizeof(key), restored[b].first_gop, restored[b].end_gop);
+        snprintf(object, sizeof(object), "%s/%s", checkpoint.bucket, key);
+        segment_path(path, sizeof(path), checkpoint.job_id, restored[b].first_gop, checkpoint.extension);
+        if (!download_video_parallel(object, path, 0, -1, "")) {
+            fprintf(stderr, "Error: No se pudo bajar el segmento retomado de los GOPs %d a %d\n",
+                    restored[b].first_gop, restored[b].end_gop);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Rank 0, con el resultado ya subido: el checkpoint no hace mas falta. Sin job.json, lo que quede se descarta
+static void finish_checkpoint(void) {
+    delete_checkpoint_object(-1, -1);
+    GopBatch *segments;
+    int count = list_checkpoint_segments(&segments);
+    delete_checkpoint_segments(segments, count);
+    free(segments);
+}
+
+/*
+ * Reparto dinamico: el rank pide lotes de GOPs hasta que no quedan. Cada lote
+ * baja de MinIO solo sus bytes (el primero, tambien cabecera y cola) y se
+ * codifica en su propio segmento a medida que llegan. Con local_complete (un
+ * hit de la cache en el rank 0) el video ya esta entero en local_file y no se
+ * baja nada. Al volver, todos los ranks tienen la tabla de lotes en sched.
+ */
+static int decompose_dynamic(const char *video_path, const char *local_file, int local_complete,
+                             const GopIndex *index, const TaskConfig *cfg, const char *job_id, int rank,
+                             GopScheduler *sched) {
+    SegmentRuntime runtime = {threads_per_rank(), (rank == 0) ? gop_scheduler_poll : NULL, sched, &stages.segments};
+    int with_container = 1;
+    int ok = 1;
+    int first_gop, end_gop;
+    GopBatch *finished = NULL;  // rank 0: segmentos que sube al checkpoint despues de repartir
+    int num_finished = 0;
+
+    while (gop_scheduler_next(sched, ok, &first_gop, &end_gop)) {
+        DownloadContext download;
+        ByteWatermark watermark;
+        char segment_file[512];
+        segment_path(segment_file, sizeof(segment_file), job_id, first_gop, cfg->extension);
+
+        if (!local_complete && !fetch_gop_ranges(video_path, local_file, index, first_gop, end_gop, rank,
+                                                 with_container, &download, &watermark)) {
+            fprintf(stderr, "[Rank %d] Error en la descarga de los GOPs %d a %d\n", rank, first_gop, end_gop);
+            ok = 0;
+            continue;
+        }
+        with_container = 0;
+
+        VideoInput input = {local_file, NULL, 0, local_complete ? NULL : &watermark};
+        ok = decompose_video(&input, index, first_gop, end_gop, rank, cfg, segment_file, &runtime);
+        if (!ok) {
+            fprintf(stderr, "[Rank %d] Error en la descomposición de los GOPs %d a %d\n", rank, first_gop, end_gop);
+        }
+        if (!local_complete) {
+            if (!ok) {
+                abort_range_download(&download);
+            }
+            ok = finish_range_download(&download) && ok;
+            watermark_destroy(&watermark);
+        }
+        if (ok && checkpoint.enabled && rank == 0) {
+            // Mientras sube no atiende pedidos de lotes: lo deja para cuando el reparto termino
+            GopBatch *grown = (GopBatch *)realloc(finished, (num_finished + 1) * sizeof(GopBatch));
+            if (grown) {
+                GopBatch batch = {first_gop, end_gop, 0};
+                finished = grown;
+                finished[num_finished++] = batch;
+            }
+        } else if (ok) {
+            record_checkpoint(first_gop, end_gop, segment_file, rank);
+        }
+    }
+
+    ok = gop_scheduler_finish(sched) && ok;
+    for (int b = 0; ok && b < num_finished; b++) {
+        char segment_file[512];
+        segment_path(segment_file, sizeof(segment_file), job_id, finished[b].first_gop, cfg->extension);
+        record_checkpoint(finished[b].first_gop, finished[b].end_gop, segment_file, rank);
+    }
+    free(finished);
+    return ok;
+}
+
+// Microsegundos alcanzan para los tiempos y el registro queda legible
+static double round_metric(int column, double value) {
+    return (column < NUM_TIME_METRICS) ? (double)(int64_t)(value * 1e6) / 1e6 : value;
+}
+
+/*
+ * Colectiva: junta con MPI_Gather la fila de metricas de cada rank y el rank 0
+ * la imprime como un registro JSON en una sola linea "[Metricas] {...}": por
+ * metrica min, max, media, desbalance (max / media, 1 = parejo) y el rank del
+ * max, el rank mas lento en la fase de GOPs, la etapa mas larga y las filas
+ * de todos los ranks. El job server lo manda al consumer en la respuesta
+ * (queda en metrics_record) y el consumer lo publica en la cola de
+ * resultados. Devuelve ok, para cerrar run_job con ella.
+ */
+static int report_job_metrics(const JobDescriptor *job, int ok, int rank, int num_procs) {
+    stages.total = now_seconds() - stages.started;
+    double row[NUM_METRICS] = {
+        stages.head, stages.index, stages.download, stages.broadcast, stages.segments.seek,
+        stages.segments.decode, stages.busy, stages.idle, stages.assemble, stages.upload, stages.total,
+        (double)stages.bytes_downloaded, stages.segments.frames, stages.gops,
+    };
+
+    // Sin memoria para la tabla el job sigue, solo que sin registro
+    double *rows = (rank == 0) ? malloc(sizeof(row) * num_procs) : NULL;
+    int gather = (rank != 0) || rows;
+    MPI_Bcast(&gather, 1, MPI_INT, 0, topology.comm);
+    if (!gather) {
+        fprintf(stderr, "Aviso: Sin memoria para las metricas del job\n");
+        return ok;
+    }
+    MPI_Gather(row, NUM_METRICS, MPI_DOUBLE, rows, NUM_METRICS, MPI_DOUBLE, 0, topology.comm);
+    if (rank != 0) {
+        return ok;
+    }
+
+    cJSON *record = cJSON_CreateObject();
+    cJSON_AddStringToObject(record, "job_id", job->job_id);
+    cJSON_AddStringToObject(record, "task", job->task);
+    cJSON_AddStringToObject(record, "status", ok ? "completed" : "failed");
+    cJSON_AddNumberToObject(record, "ranks", num_procs);
+    cJSON_AddNumberToObject(record, "threads_per_rank", threads_per_rank());
+    cJSON_AddNumberToObject(record, "video_bytes", (double)stages.video_bytes);
+    cJSON_AddNumberToObject(record, "video_frames", stages.video_frames);
+    cJSON_AddBoolToObject(record, "reused_result", stages.reused);
+    cJSON_AddNumberToObject(record, "restored_segments", stages.restored);
+
+    cJSON *summary = cJSON_AddObjectToObject(record, "metrics");
+    int busiest = 0;
+    const char *slowest_stage = NULL;
+    double slowest = -1;
+    for (int m = 0; m < NUM_METRICS && summary; m++) {
+        double min = rows[m], max = rows[m], sum = 0;
+        int max_rank = 0;
+        for (int r = 0; r < num_procs; r++) {
+            double value = rows[r * NUM_METRICS + m];
+            sum += value;
+            if (value < min) {
+                min = value;
+            }
+            if (value > max) {
+                max = value;
+                max_rank = r;
+            }
+        }
+        double mean = sum / num_procs;
+
+        cJSON *stat = cJSON_AddObjectToObject(summary, metric_names[m]);
+        cJSON_AddNumberToObject(stat, "min", round_metric(m, min));
+        cJSON_AddNumberToObject(stat, "max", round_metric(m, max));
+        cJSON_AddNumberToObject(stat, "mean", round_metric(m, mean));
+        cJSON_AddNumberToObject(stat, "imbalance", (mean > 0) ? (double)(int64_t)(max / mean * 1000) / 1000 : 1.0);
+        cJSON_AddNumberToObject(stat, "max_rank", max_rank);
+
+        if (strcmp(metric_names[m], "busy") == 0) {
+            busiest = max_rank;
+        } else if (m < NUM_TIME_METRICS && strcmp(metric_names[m], "idle") != 0 &&
+                   strcmp(metric_names[m], "total") != 0 && max > slowest) {
+            slowest = max;
+            slowest_stage = metric_names[m];
+        }
+    }
+    cJSON_AddNumberToObject(record, "straggler_rank", busiest);
+    cJSON_AddStringToObject(record, "slowest_stage", slowest_stage ? slowest_stage : "");
+
+    cJSON *per_rank = cJSON_AddArrayToObject(record, "per_rank");
+    for (int r = 0; r < num_procs && per_rank; r++) {
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddNumberToObject(entry, "rank", r);
+        for (int m = 0; m < NUM_METRICS; m++) {
+            cJSON_AddNumberToObject(entry, metric_names[m], round_metric(m, rows[r * NUM_METRICS + m]));
+        }
+        cJSON_AddItemToArray(per_rank, entry);
+    }
+    free(rows);
+
+    char *text = cJSON_PrintUnformatted(record);
+    if (text) {
+        printf("[Metricas] %s\n", text);
+        fflush(stdout);
+        free(metrics_record);
+        metrics_record = strdup(text);
+        cJSON_free(text);
+    }
+    cJSON_Delete(record);
+    return ok;
+}
+
+/*
+ * Ejecuta un job completo en todos los ranks. Es colectiva: todos devuelven
+ * el mismo resultado, asi que el modo residente puede seguir con el proximo.
+ */
+static int run_job(const JobDescriptor *job, int rank, int num_procs) {
+    const char *job_id = job->job_id;
+    const char *video_path = job->video_path;
+    const char *task = job->task;
+    const char *params = job->params;
+    char output_file[512];
+    char local_file[512];
+    char segment_file[512];
+    char result_file[512];
+    char cache_key[VIDEO_CACHE_KEY_SIZE] = "";
+    char object_key[512];
+    int cached = 0;
+    int fetch_mode = FETCH_MODE_DIRECT;
+    int schedule = SCHEDULE_STATIC;
+    int downloading = 0;
+    int memory_fd = -1;  // memfd con la copia local del video (DVP_INPUT_MEMORY)
+    DownloadContext download;
+    ByteWatermark watermark;
+    CacheFill fill;
+    SharedVideo shared;
+    GopIndex index;
+    TaskConfig cfg;
+    GopScheduler sched;
+    RankLoad load;
+    ResultIdentity identity = {"", NULL};
+    ObjectInfo video_info = {-1, "", -1, -1};
+    cJSON *previous = NULL;     // job.json del checkpoint de una corrida anterior del job
+    GopBatch *restored = NULL;  // segmentos listados en su prefijo; quedan al principio los que se retoman
+    int num_listed = 0;
+    int num_restored = -1;
+
+    memset(&index, 0, sizeof(index));
+    memset(&shared, 0, sizeof(shared));
+    shared.win = MPI_WIN_NULL;
+    memset(&fill, 0, sizeof(fill));
+    memset(&sched, 0, sizeof(sched));
+    memset(&load, 0, sizeof(load));
+    memset(&stages, 0, sizeof(stages));
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    stages.started = now_seconds();
+
+    if (rank == 0) {
+        printf("========================================\n");
+        printf("PROCESS_VIDEO - Iniciando procesamiento\n");
+        printf("========================================\n");
+        printf("Job ID: %s\n", job_id);
+        printf("Video Path: %s\n", video_path);
+        printf("Task: %s\n", task);
+        printf("Params: %s\n", params);
+        printf("MPI Processes: %d\n", num_procs);
+        printf("========================================\n\n");
+        fflush(stdout);
+    }
+
+    // Una tarea invalida se rechaza antes de bajar un solo byte
+    int valid = (rank != 0) || configure_video_task(task, params, &cfg);
+    MPI_Bcast(&valid, 1, MPI_INT, 0, topology.comm);
+    if (!valid) {
+        stages.rejected = 1;
+        return 0;
+    }
+    MPI_Bcast(&cfg, sizeof(TaskConfig), MPI_BYTE, 0, topology.comm);
+
+    // Sin subida no hay resultado en el bucket que reutilizar ni que registrar
+    int upload = env_int("DVP_UPLOAD", 1, 0, 1);
+    const char *result_bucket = getenv("DVP_RESULT_BUCKET");
+    if (!result_bucket) {
+        result_bucket = DEFAULT_RESULT_BUCKET;
+    }
+    snprintf(object_key, sizeof(object_key), "results/%s.%s", job_id, cfg.extension);
+
+    // Un resultado ya calculado para el mismo contenido, tarea y params se copia sin bajar el video
+    int reused = 0;
+    int use_result_cache = 0;
+    int resuming = 0;
+    int rejected = 0;  // rank 0: el video no sirve para la tarea
+    if (rank == 0) {
+        use_result_cache = upload && env_int("DVP_RESULT_CACHE", 1, 0, 1);
+        int use_checkpoint = upload && env_int("DVP_CHECKPOINT", 0, 0, 1);
+        if ((video_cache.budget > 0 || use_result_cache || use_checkpoint) && probe_object(video_path, &video_info) &&
+            (use_result_cache || use_checkpoint)) {
+            result_identity(&identity, &video_info, task, params);
+        }
+        if (use_result_cache && identity.text) {
+            reused = reuse_cached_result(&identity, result_bucket, object_key);
+        }
+        if (!reused && use_checkpoint && identity.text) {
+            checkpoint.enabled = 1;
+            snprintf(checkpoint.bucket, sizeof(checkpoint.bucket), "%s", result_bucket);
+            snprintf(checkpoint.job_id, sizeof(checkpoint.job_id), "%s", job_id);
+            snprintf(checkpoint.extension, sizeof(checkpoint.extension), "%s", cfg.extension);
+            previous = load_checkpoint_job();
+            num_listed = list_checkpoint_segments(&restored);
+            resuming = checkpoint_matches(previous, &identity) && num_listed > 0;
+            // Sin listado no se puede retomar ni limpiar lo que quede: no vale la pena subir segmentos
+            checkpoint.enabled = (num_listed >= 0);
+        }
+    }
+    MPI_Bcast(&reused, 1, MPI_INT, 0, topology.comm);
+    if (reused) {
+        free(identity.text);
+        stages.reused = 1;
+        if (rank == 0) {
+            printf("Procesamiento completado desde la cache de resultados: %s/%s\n", result_bucket, object_key);
+            fflush(stdout);
+        }
+        return report_job_metrics(job, 1, rank, num_procs);
+    }
+
+    if (rank == 0) {
+        snprintf(output_file, sizeof(output_file), "/tmp/video_%s.mp4", job_id);
+
+        const char *mode_env = getenv("DVP_FETCH_MODE");
+        if (mode_env && strcmp(mode_env, "master") == 0) {
+            fetch_mode = FETCH_MODE_MASTER;
+        }
+
+        // Un video de un job anterior con el mismo id puede ser un enlace a la cache
+        unlink(output_file);
+        // Al retomar un checkpoint cada rank baja solo los rangos que le faltan: la cache del nodo no se usa
+        cached = !resuming && lookup_cached_video(video_path, &video_info, output_file, cache_key, &index);
+
+        // Un hit ya esta en disco; si no, el video puede bajar solo a RAM, pero entonces no se cachea
+        if (!cached) {
+            memory_fd = open_memory_input(job_id, output_file, sizeof(output_file));
+            if (memory_fd >= 0) {
+                cache_key[0] = '\0';
+                printf("Video de entrada en memoria, sin archivo temporal\n");
+                fflush(stdout);
+            }
+        }
+
+        long object_size = cached ? (long)index.file_size : -1;
+        int indexed = cached;
+        if (!cached) {
+            // Primero solo la metadata del contenedor, para indexar sin bajar el video
+            printf("Descargando metadatos del contenedor desde MinIO...\n");
+            fflush(stdout);
+
+            double stage_started = now_seconds();
+            indexed = fetch_container_metadata(video_path, output_file, &object_size);
+            stages.head = now_seconds() - stage_started;
+            indexed = indexed && build_gop_index(output_file, &index);
+            stages.index = now_seconds() - stage_started - stages.head;
+            if (indexed && cache_key[0]) {
+                video_cache_store_index(&video_cache, cache_key, &index);
+            }
+        }
+
+        // Fuera de la ventana queda un indice vacio y el job se aborta en todos los ranks
+        int in_window = !indexed || apply_task_window(&index, &cfg);
+        rejected = !in_window;
+
+        // El checkpoint necesita el indice final; un contenedor sin descarga por rangos no se puede retomar
+        if (checkpoint.enabled && indexed && in_window) {
+            num_restored = start_checkpoint(previous, &identity, index.num_gops, restored, num_listed);
+        }
+        checkpoint.enabled = (num_restored >= 0);
+        cJSON_Delete(previous);
+        if (num_restored > 0) {
+            printf("Job retomado de su checkpoint: %d segmentos ya hechos, solo se reparten los GOPs que faltan\n",
+                   num_restored);
+            fflush(stdout);
+            stages.restored = num_restored;
+            fetch_mode = FETCH_MODE_DIRECT;
+        }
+
+        // Sin el video entero en un nodo no hay nada que cachear: la primera pasada lo baja el rank 0.
+        // cut y extract_frames solo bajan algunos GOPs: no conviene traer el resto para la cache
+        int fill_cache = !cached && cache_key[0] && !cfg.cut && !cfg.frames && num_restored <= 0;
+
+        // Con un hit el rank 0 ya tiene el video entero: en modo master lo reparte por MPI sin tocar
+        // MinIO; en el directo no baja nada y los workers bajan sus rangos como siempre
+        if (!cached && indexed && in_window && fetch_mode == FETCH_MODE_MASTER) {
+            // El resto del video se baja en orden mientras se reparte a los workers
+            if (start_master_download(video_path, output_file, &index, fill_cache, &download, &watermark)) {
+                downloading = 1;
+            } else {
+                free_gop_index(&index);
+            }
+        } else if (!cached && indexed && in_window && fill_cache) {
+            // El modo directo no cambia: la copia para la cache es una descarga aparte del rank 0
+            start_cache_fill(&fill, video_path, job_id, &index);
+        } else if (!indexed) {
+            printf("El contenedor no admite descarga por rangos, el master descargara el video completo\n");
+            fflush(stdout);
+            fetch_mode = FETCH_MODE_MASTER;
+
+            printf("Descargando video desde MinIO...\n");
+            fflush(stdout);
+
+            // Un fallo en el rank 0 se propaga como indice vacio para no colgar a los workers
+            if (!download_video_parallel(video_path, output_file, rank, object_size, cache_key)) {
+                fprintf(stderr, "Error: Fallo la descarga del video\n");
+            } else {
+                printf("\n========================================\n");
+                printf("Descarga completada - Video disponible en: %s\n", output_file);
+                printf("========================================\n\n");
+                fflush(stdout);
+
+                // Un hit dentro de download_video_parallel puede traer el indice ya armado
+                double stage_started = now_seconds();
+                int have_index = cache_key[0] && video_cache_load_index(&video_cache, cache_key, &index);
+                if (!have_index && build_gop_index(output_file, &index)) {
+                    have_index = 1;
+                    if (cache_key[0]) {
+                        video_cache_store_index(&video_cache, cache_key, &index);
+                    }
+                }
+                stages.index = now_seconds() - stage_started;
+                if (!have_index) {
+                    fprintf(stderr, "Error: No se pudo indexar el video\n");
+                }
+                rejected = !have_index || !apply_task_window(&index, &cfg);
+            }
+        }
+    }
+
+    if (rank == 0) {
+        // Los lotes se bajan a pedido: en modo master cada worker solo recibe su span fijo
+        const char *schedule_env = getenv("DVP_SCHEDULE");
+        if (num_restored > 0) {
+            // Los GOPs que faltan pueden ser varios tramos sueltos: solo el reparto dinamico los saltea
+            schedule = SCHEDULE_DYNAMIC;
+        } else if (schedule_env && strcmp(schedule_env, "dynamic") == 0 && num_procs > 1) {
+            if (fetch_mode == FETCH_MODE_DIRECT) {
+                schedule = SCHEDULE_DYNAMIC;
+            } else {
+                printf("Reparto dinamico no disponible en modo master, se usa el estatico\n");
+                fflush(stdout);
+            }
+        }
+    }
+    MPI_Bcast(&fetch_mode, 1, MPI_INT, 0, topology.comm);
+    MPI_Bcast(&schedule, 1, MPI_INT, 0, topology.comm);
+    MPI_Bcast(&checkpoint, sizeof(Checkpoint), MPI_BYTE, 0, topology.comm);
+
+    double broadcast_started = now_seconds();
+    if (!broadcast_gop_index(&index, topology.comm, rank)) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: No hay indice de GOPs, abortando job\n");
+            rejected = rejected || object_missing(video_path);
+        }
+        MPI_Bcast(&rejected, 1, MPI_INT, 0, topology.comm);
+        stages.rejected = rejected;
+        finish_cache_fill(&fill, cache_key, 0);
+        if (memory_fd >= 0) {
+            close(memory_fd);
+        }
+        free(identity.text);
+        free(restored);
+        return 0;
+    }
+    stages.broadcast = now_seconds() - broadcast_started;
+    stages.video_bytes = index.file_size;
+    stages.video_frames = index.total_frames;
+
+    // Los workers no comparten /tmp con el master: en modo directo cada uno arma su copia local parcial
+    if (rank == 0) {
+        snprintf(local_file, sizeof(local_file), "%s", output_file);
+    } else {
+        snprintf(local_file, sizeof(local_file), "/tmp/video_%s_rank%d.mp4", job_id, rank);
+        // En modo master los workers leen la ventana compartida: la copia local es solo del modo directo
+        if (fetch_mode == FETCH_MODE_DIRECT) {
+            memory_fd = open_memory_input(job_id, local_file, sizeof(local_file));
+        }
+    }
+
+    if (rank == 0) {
+        printf("Iniciando descomposición del video (reparto %s)...\n",
+               (schedule == SCHEDULE_DYNAMIC) ? "dinamico" : "estatico");
+        fflush(stdout);
+    }
+
+    int ok = 1;
+    if (schedule == SCHEDULE_DYNAMIC) {
+        gop_scheduler_init(&sched, &index, topology.comm, rank, num_procs,
+                           env_int("DVP_SCHEDULE_MIN_GOPS", 1, 1, 1 << 20));
+        int skipped = (num_restored <= 0) || gop_scheduler_skip(&sched, restored, num_restored);
+        ok = decompose_dynamic(video_path, local_file, cached, &index, &cfg, job_id, rank, &sched) && skipped;
+        // Los segmentos retomados quedan en la tabla con owner 0: el rank 0 los baja como propios
+        if (ok && num_restored > 0) {
+            double fetch_started = now_seconds();
+            ok = fetch_checkpoint_segments(restored, num_restored);
+            stages.download += now_seconds() - fetch_started;
+        }
+        load = sched.load;
+    } else {
+        int first_gop, end_gop;
+        gop_range_for_rank(&index, rank, num_procs, &first_gop, &end_gop);
+        double started = now_seconds();
+
+        if (fetch_mode == FETCH_MODE_DIRECT && !cached) {
+            // Sin barrera: cada rank decodifica cada GOP en cuanto sus bytes estan en disco
+            downloading = fetch_gop_ranges(video_path, local_file, &index, first_gop, end_gop, rank, 1,
+                                           &download, &watermark);
+            if (!downloading) {
+                fprintf(stderr, "[Rank %d] Error en la descarga de sus rangos\n", rank);
+                ok = 0;
+            }
+        } else if (fetch_mode == FETCH_MODE_MASTER && num_procs > 1) {
+            // Una copia del video por nodo: los ranks de un mismo nodo leen la misma ventana
+            double distribute_started = now_seconds();
+            int shared_ok = shared_video_alloc(&shared, &topology, index.file_size);
+            MPI_Allreduce(MPI_IN_PLACE, &shared_ok, 1, MPI_INT, MPI_MIN, topology.comm);
+            if (!shared_ok || !distribute_video(output_file, &index, &topology, &shared, rank, num_procs,
+                                                downloading ? &watermark : NULL)) {
+                fprintf(stderr, "[Rank %d] Error en la distribucion del video\n", rank);
+                ok = 0;
+            }
+            stages.broadcast += now_seconds() - distribute_started;
+        }
+
+        segment_path(segment_file, sizeof(segment_file), job_id, first_gop, cfg.extension);
+        SegmentRuntime runtime = {threads_per_rank(), NULL, NULL, &stages.segments};
+
+        // En modo master los workers ya tienen todo su span en la ventana al salir de distribute_video
+        VideoInput input = {local_file, NULL, 0, downloading ? &watermark : NULL};
+        if (fetch_mode == FETCH_MODE_MASTER && rank != 0) {
+            input.data = shared.data;
+            input.size = shared.size;
+        }
+        ok = ok && decompose_video(&input, &index, first_gop, end_gop, rank, &cfg, segment_file, &runtime);
+        if (!ok) {
+            fprintf(stderr, "[Rank %d] Error en la descomposición del video\n", rank);
+        }
+        shared_video_free(&shared);
+
+        if (downloading) {
+            if (!ok) {
+                abort_range_download(&download);
+            }
+            ok = finish_range_download(&download) && ok;
+            watermark_destroy(&watermark);
+        }
+
+        if (ok && first_gop < end_gop) {
+            record_checkpoint(first_gop, end_gop, segment_file, rank);
+        }
+
+        // El rank 0 quedo con el objeto entero: el proximo job sobre el mismo video no lo baja
+        if (rank == 0 && ok && !cached && cache_key[0] && fetch_mode == FETCH_MODE_MASTER && !cfg.cut &&
+            !cfg.frames) {
+            video_cache_insert(&video_cache, cache_key, output_file);
+        }
+
+        load.busy = now_seconds() - started;
+        load.gops = end_gop - first_gop;
+        load.batches = (first_gop < end_gop);
+        sched.num_batches = gop_static_batches(&index, num_procs, &sched.batches);
+        ok = ok && sched.num_batches >= 0;
+    }
+
+    // Lo que un rank espera aca es lo que tarda el mas lento en terminar
+    double wait_started = now_seconds();
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, topology.comm);
+    load.idle += now_seconds() - wait_started;
+    stages.busy = load.busy;
+    stages.idle = load.idle;
+    stages.gops = load.gops;
+    report_rank_load(&load, (schedule == SCHEDULE_DYNAMIC) ? "dinamico" : "estatico", topology.comm, rank,
+                     num_procs);
+
+    // El video de entrada ya no se necesita: solo quedan los segmentos
+    if (memory_fd >= 0) {
+        close(memory_fd);
+    } else {
+        unlink(local_file);
+    }
+
+    snprintf(result_file, sizeof(result_file), "/tmp/output_%s.%s", job_id, cfg.extension);
+    if (all_ok) {
+        double assemble_started = now_seconds();
+        all_ok = assemble_output(&index, &cfg, job_id, result_file, rank, num_procs,
+                                 sched.batches, sched.num_batches);
+        stages.assemble = now_seconds() - assemble_started;
+    } else {
+        remove_segments(job_id, sched.batches, sched.num_batches, cfg.extension, rank);
+    }
+    gop_scheduler_free(&sched);
+    free_gop_index(&index);
+    free(restored);
+    // Para entonces la copia de la cache suele estar completa: bajo a la par de los workers
+    finish_cache_fill(&fill, cache_key, all_ok);
+
+    if (!all_ok) {
+        free(identity.text);
+        return report_job_metrics(job, 0, rank, num_procs);
+    }
+
+    // Solo el rank 0 tiene el resultado; si no se pudo subir el job falla en todos
+    int uploaded = 1;
+    if (rank == 0 && upload) {
+        double upload_started = now_seconds();
+        uploaded = upload_result(result_file, result_bucket, object_key, result_content_type(cfg.extension));
+        if (uploaded && use_result_cache && identity.text) {
+            record_cached_result(&identity, result_bucket, object_key, job_id);
+        }
+        if (uploaded && checkpoint.enabled) {
+            finish_checkpoint();
+        }
+        stages.upload += now_seconds() - upload_started;
+    }
+    free(identity.text);
+    wait_started = now_seconds();
+    MPI_Bcast(&uploaded, 1, MPI_INT, 0, topology.comm);
+    stages.idle += now_seconds() - wait_started;
+    if (!uploaded) {
+        return report_job_metrics(job, 0, rank, num_procs);
+    }
+
+    if (rank == 0) {
+        printf("\n========================================\n");
+        printf("Procesamiento completado exitosamente\n");
+        printf("Task: %s\n", task);
+        printf("Resultado: %s\n", result_file);
+        printf("========================================\n\n");
+        fflush(stdout);
+    }
+
+    return report_job_metrics(job, 1, rank, num_procs);
+}
+
+/*
+ * Job del servidor residente. Con todos los ranks sirve la topologia de main;
+ * con un subconjunto se arma una sobre comm solo para este job.
+ */
+static int serve_job(const JobDescriptor *job, MPI_Comm comm, int rank, int num_procs, char **summary) {
+    int ok;
+    free(metrics_record);
+    metrics_record = NULL;
+
+    if (comm == topology.comm) {
+        ok = run_job(job, rank, num_procs);
+    } else {
+        NodeTopology world = topology;
+        if (!node_topology_init(&topology, comm, rank, num_procs)) {
+            topology = world;
+            if (rank == 0) {
+                fprintf(stderr, "Error: No se pudo armar la topologia de nodos del job %s\n", job->job_id);
+            }
+            return JOB_FAILED;
+        }
+        ok = run_job(job, rank, num_procs);
+        node_topology_free(&topology);
+        topology = world;
+    }
+
+    // El log del rank 0 queda en su host: el registro viaja en la respuesta al consumer
+    *summary = metrics_record;
+    metrics_record = NULL;
+    return ok ? JOB_OK : stages.rejected ? JOB_REJECTED : JOB_FAILED;
+}
+
+int main(int argc, char **argv) {
+    // Los threads de descarga no llaman a MPI: basta con FUNNELED
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    int rank, num_procs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    if (!node_topology_init(&topology, MPI_COMM_WORLD, rank, num_procs)) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: No se pudo armar la topologia de nodos\n");
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    int serve = (argc >= 2 && strcmp(argv[1], "--serve") == 0);
+    if (!serve && argc < 4) {
+        if (rank == 0) {
+            fprintf(stderr, "Usage: %s <job_id> <video_path> <task> [params]\n", argv[0]);
+            fprintf(stderr, "       %s --serve [socket_path]\n", argv[0]);
+        }
+        node_topology_free(&topology);
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Curl y el pool de conexiones viven todo el proceso, incluso entre jobs
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    transfer_engine_init();
+    if (rank == 0) {
+        const char *cache_dir = getenv("DVP_CACHE_DIR");
+        video_cache_open(&video_cache, cache_dir ? cache_dir : DEFAULT_CACHE_DIR,
+                         (int64_t)env_int("DVP_CACHE_MB", DEFAULT_CACHE_MB, 0, 1 << 24) * 1024 * 1024);
+    }
+
+    int ok;
+    if (serve) {
+        const char *socket_path = (argc >= 3) ? argv[2] : DEFAULT_JOB_SOCKET;
+        ok = serve_jobs(socket_path, serve_job, rank, num_procs);
+    } else {
+        JobDescriptor job;
+        memset(&job, 0, sizeof(job));
+        snprintf(job.job_id, sizeof(job.job_id), "%s", argv[1]);
+        snprintf(job.video_path, sizeof(job.video_path), "%s", argv[2]);
+        snprintf(job.task, sizeof(job.task), "%s", argv[3]);
+        snprintf(job.params, sizeof(job.params), "%s", (argc > 4) ? argv[4] : "{}");
+        ok = run_job(&job, rank, num_procs);
+    }
+
+    transfer_engine_cleanup();
+    curl_global_cleanup();
+    node_topology_free(&topology);
+    MPI_Finalize();
+    // El consumer no reintenta un job rechazado
+    return ok ? 0 : (!serve && stages.rejected) ? EXIT_REJECTED : 1;
+}
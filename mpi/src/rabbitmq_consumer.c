@@ -14,19 +14,467 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <amqp.h>
 #include <amqp_tcp_socket.h>
 #include <cjson/cJSON.h>
 
 // Configuración de RabbitMQ (leerá de variables de entorno)
 #define QUEUE_NAME "video_jobs"
+#define RESULTS_QUEUE_NAME "video_results"  // estado final y metricas de cada job
+
+// Log de cada job; con mpirun directo process_video deja ahi su registro "[Metricas] {...}"
+#define JOB_LOG_FORMAT "/var/log/mpi_jobs/%s.log"
+#define METRICS_PREFIX "[Metricas] "
+// Registro de metricas que el hijo de cada slot le pasa al padre para publicarlo
+#define JOB_METRICS_FORMAT "/tmp/dvp_metrics_%d.json"
+
+// Intentos por job (DVP_JOB_ATTEMPTS): uno fallido vuelve a la cola, y retoma desde su checkpoint si lo hay
+#define DEFAULT_JOB_ATTEMPTS 2
+// Salida del hijo (y de process_video) para un job que un reintento repetiria: no vuelve a la cola
+#define JOB_EXIT_REJECTED 2
+
+// Job server MPI residente (process_video --serve), uno por particion del cluster
+#define JOB_SOCKET_FORMAT "/tmp/dvp_jobs_%d.sock"
+#define JOB_SERVER_START_TIMEOUT 60  // segundos esperando a que el servidor abra el socket
+// --bind-to none: cada rank reparte sus threads de frames entre todos los nucleos de su nodo
+#define MPIRUN_CMD "mpirun --allow-run-as-root --bind-to none --mca btl_tcp_if_include eth0 --mca oob_tcp_if_include eth0 --mca routed direct"
+
+// Slots del cluster (DVP_HOSTFILE o DVP_CLUSTER_HOSTS) y jobs simultaneos (DVP_MAX_INFLIGHT)
+#define DEFAULT_CLUSTER_HOSTS "master:2,worker1:2,worker2:2"
+#define MAX_INFLIGHT_JOBS 16
+
+// Un rank por cada DVP_BYTES_PER_RANK_MB del video; en un solo nodo se usa memoria compartida
+#define DEFAULT_BYTES_PER_RANK_MB 64
+#define SHARED_MEMORY_BTL "--mca btl self,vader"
+
+// Estado del job server de una particion, visto por los hijos que le mandan jobs
+enum { SERVER_UNKNOWN = 0, SERVER_UP, SERVER_FAILED };
+
+/*
+ * Particion fija de los slots MPI del cluster. Cada una corre un job a la vez
+ * con su propio job server, asi varios jobs chicos avanzan en paralelo.
+ */
+typedef struct {
+    int index;
+    int np;
+    char hosts[512];        // lista para mpirun -H, p.ej. "master:2,worker1:1"
+    char socket_path[108];
+    pid_t pid;              // proceso hijo que corre el job actual, 0 si esta libre
+    uint64_t delivery_tag;  // mensaje a confirmar cuando termine el hijo
+    char job_id[128];       // vacio si el mensaje no traia uno valido
+    char *message;          // copia del mensaje, para reencolarlo si el job falla
+    size_t message_len;
+    int attempt;            // campo "attempt" del mensaje; 1 en el primero
+    int *server_state;      // en memoria compartida con los hijos; NULL si no se pudo mapear
+} JobSlot;
+
+static JobSlot slots[MAX_INFLIGHT_JOBS];
+static int num_slots = 0;
+
+/**
+ * Convierte un hostfile de OpenMPI ("host slots=N" por linea) al formato
+ * "host:n,host:n" de DVP_CLUSTER_HOSTS. Devuelve 0 si no se pudo leer.
+ */
+static int load_hostfile(const char *path, char *spec, size_t size) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+
+    char line[256];
+    size_t len = 0;
+    spec[0] = '\0';
+    while (fgets(line, sizeof(line), f)) {
+        char host[128];
+        int count = 1;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        if (sscanf(line, "%127s", host) != 1) {
+            continue;
+        }
+        char *slots_kv = strstr(line, "slots=");
+        if (slots_kv) {
+            count = atoi(slots_kv + 6);
+        }
+        if (count > 0 && len < size) {
+            len += snprintf(spec + len, size - len, "%s%s:%d", len ? "," : "", host, count);
+        }
+    }
+    fclose(f);
+    return len > 0 && len < size;
+}
+
+// Host de la lista que es esta maquina (por nombre corto), o -1
+static int find_local_host(char names[][64], int num_hosts) {
+    char local[256];
+    if (gethostname(local, sizeof(local)) != 0) {
+        return -1;
+    }
+    local[sizeof(local) - 1] = '\0';
+    char *dot = strchr(local, '.');
+    if (dot) {
+        *dot = '\0';
+    }
+    for (int h = 0; h < num_hosts; h++) {
+        size_t len = strcspn(names[h], ".");
+        if (strlen(local) == len && strncmp(names[h], local, len) == 0) {
+            return h;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Reparte los slots de DVP_CLUSTER_HOSTS ("host:n,host:n,...") en particiones
+ * lo mas parejas posible. El rank 0 de cada job server abre su socket Unix
+ * en el primer host de su lista, asi que cada particion empieza con un slot
+ * de este host (el del consumer) y sigue con slots contiguos del resto: hay
+ * a lo sumo tantas particiones como slots tiene este host. Devuelve la
+ * cantidad de particiones.
+ */
+static int partition_cluster(const char *hosts_spec, int max_inflight) {
+    char names[32][64];
+    int counts[32];
+    int num_hosts = 0;
+    int total = 0;
+
+    char spec[1024];
+    snprintf(spec, sizeof(spec), "%s", hosts_spec);
+    char *saveptr = NULL;
+    for (char *tok = strtok_r(spec, ",", &saveptr); tok && num_hosts < 32; tok = strtok_r(NULL, ",", &saveptr)) {
+        int count = 1;
+        char *colon = strchr(tok, ':');
+        if (colon) {
+            *colon = '\0';
+            count = atoi(colon + 1);
+        }
+        if (*tok && count > 0) {
+            snprintf(names[num_hosts], sizeof(names[num_hosts]), "%s", tok);
+            counts[num_hosts++] = count;
+            total += count;
+        }
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    int local = find_local_host(names, num_hosts);
+    if (local < 0) {
+        fprintf(stderr, "⚠️  Este host no esta en %s: los job servers abren su socket en %s\n",
+                hosts_spec, names[0]);
+        local = 0;
+    }
+
+    int n = (max_inflight < total) ? max_inflight : total;
+    if (n > counts[local]) {
+        fprintf(stderr, "⚠️  DVP_MAX_INFLIGHT limitado a %d: el rank 0 de cada particion corre en %s\n",
+                counts[local], names[local]);
+        n = counts[local];
+    }
+    if (n > MAX_INFLIGHT_JOBS) {
+        n = MAX_INFLIGHT_JOBS;
+    }
+
+    // Orden de los slots restantes: lo que sobra de este host y despues los demas
+    int order[32];
+    int remaining[32];
+    order[0] = local;
+    for (int h = 0, k = 1; h < num_hosts; h++) {
+        remaining[h] = counts[h];
+        if (h != local) {
+            order[k++] = h;
+        }
+    }
+    remaining[local] -= n;
+
+    int pos = 0;
+    for (int i = 0; i < n; i++) {
+        JobSlot *slot = &slots[i];
+        memset(slot, 0, sizeof(JobSlot));
+        slot->index = i;
+        slot->np = (i + 1) * total / n - i * total / n;
+        snprintf(slot->socket_path, sizeof(slot->socket_path), JOB_SOCKET_FORMAT, i);
+
+        int take[32] = {0};
+        int needed = slot->np - 1;
+        take[local] = 1;
+        while (needed > 0 && pos < num_hosts) {
+            int h = order[pos];
+            int count = (remaining[h] < needed) ? remaining[h] : needed;
+            take[h] += count;
+            remaining[h] -= count;
+            needed -= count;
+            if (remaining[h] == 0) {
+                pos++;
+            }
+        }
+
+        size_t len = 0;
+        for (int k = 0; k < num_hosts; k++) {
+            int h = order[k];
+            if (take[h] > 0) {
+                len += snprintf(slot->hosts + len, sizeof(slot->hosts) - len, "%s%s:%d",
+                                len ? "," : "", names[h], take[h]);
+            }
+        }
+    }
+    return n;
+}
+
+static int connect_job_server(const JobSlot *slot) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, slot->socket_path, sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Levanta los ranks MPI una sola vez; quedan esperando jobs en el socket.
+ * Evita pagar su + SSH + MPI_Init + inicializacion de curl en cada mensaje.
+ */
+static int start_job_server(const JobSlot *slot) {
+    printf("🚀 Iniciando job server MPI residente %d (-np %d -H %s)...\n", slot->index, slot->np, slot->hosts);
+    fflush(stdout);
+
+    char command[2048];
+    snprintf(command, sizeof(command),
+        "su - mpiuser -c 'nohup " MPIRUN_CMD " %s -np %d -H %s /usr/local/bin/process_video --serve %s "
+        "> /var/log/mpi_jobs/job_server_%d.log 2>&1 &'",
+        strchr(slot->hosts, ',') ? "" : SHARED_MEMORY_BTL,
+        slot->np, slot->hosts, slot->socket_path, slot->index);
+
+    if (system(command) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < JOB_SERVER_START_TIMEOUT; i++) {
+        int fd = connect_job_server(slot);
+        if (fd >= 0) {
+            return fd;
+        }
+        sleep(1);
+    }
+    fprintf(stderr, "❌ El job server no abrio %s a tiempo\n", slot->socket_path);
+    return -1;
+}
+
+/**
+ * Cantidad de ranks para el job, acotada a los slots de su particion:
+ * params.np si viene, si no uno cada DVP_BYTES_PER_RANK_MB de size_bytes
+ * (lo agrega la API al subir el video). Sin datos se usa la particion entera.
+ */
+static int choose_num_ranks(const cJSON *json, const cJSON *params, const JobSlot *slot) {
+    const cJSON *np_hint = cJSON_IsObject(params) ? cJSON_GetObjectItemCaseSensitive(params, "np") : NULL;
+    const cJSON *size_bytes = cJSON_GetObjectItemCaseSensitive(json, "size_bytes");
+    int np = slot->np;
+
+    if (cJSON_IsNumber(np_hint)) {
+        np = (int)np_hint->valuedouble;
+    } else if (cJSON_IsNumber(size_bytes) && size_bytes->valuedouble > 0) {
+        const char *env = getenv("DVP_BYTES_PER_RANK_MB");
+        double per_rank = (env && atoi(env) > 0) ? atoi(env) : DEFAULT_BYTES_PER_RANK_MB;
+        per_rank *= 1024.0 * 1024.0;
+        np = (int)((size_bytes->valuedouble + per_rank - 1) / per_rank);
+    }
+
+    if (np < 1) np = 1;
+    if (np > slot->np) np = slot->np;
+    return np;
+}
+
+/**
+ * Toma los primeros np slots de la particion, llenando cada nodo antes de
+ * pasar al siguiente para que los jobs chicos queden en un solo nodo.
+ * Devuelve la cantidad de nodos usados.
+ */
+static int place_ranks(const JobSlot *slot, int np, char *hosts, size_t size) {
+    char spec[512];
+    snprintf(spec, sizeof(spec), "%s", slot->hosts);
+
+    int num_hosts = 0;
+    size_t len = 0;
+    char *saveptr = NULL;
+    hosts[0] = '\0';
+    for (char *tok = strtok_r(spec, ",", &saveptr); tok && np > 0; tok = strtok_r(NULL, ",", &saveptr)) {
+        char *colon = strchr(tok, ':');
+        int count = colon ? atoi(colon + 1) : 1;
+        if (colon) {
+            *colon = '\0';
+        }
+        int take = (count < np) ? count : np;
+        len += snprintf(hosts + len, size - len, "%s%s:%d", len ? "," : "", tok, take);
+        np -= take;
+        num_hosts++;
+    }
+    return num_hosts;
+}
+
+/**
+ * Envia el job al servidor residente y espera su respuesta. Con np menor que
+ * los slots de la particion el servidor lo corre en sus primeros np ranks,
+ * los mismos que elige place_ranks. El registro de metricas que trae la
+ * respuesta queda en *metrics (NULL si no vino).
+ * Devuelve 0 si el job termino bien, 1 si fallo, JOB_EXIT_REJECTED si el
+ * servidor lo rechazo y -1 si no hay servidor.
+ */
+static int submit_to_job_server(const JobSlot *slot, const char *job_id, const char *video_path,
+                                const char *task, const char *params, int np, cJSON **metrics) {
+    const char *mode = getenv("DVP_JOB_SERVER");
+    if (mode && strcmp(mode, "0") == 0) {
+        return -1;
+    }
+
+    int fd = connect_job_server(slot);
+    if (fd < 0) {
+        // Un servidor que nunca respondio no se relanza: cada intento dejaria otro mpirun colgado
+        if (slot->server_state && *slot->server_state == SERVER_FAILED) {
+            return -1;
+        }
+        fd = start_job_server(slot);
+        if (fd < 0) {
+            if (slot->server_state) {
+                *slot->server_state = SERVER_FAILED;
+            }
+            return -1;
+        }
+    }
+    if (slot->server_state) {
+        *slot->server_state = SERVER_UP;
+    }
+
+    char line[8192];
+    int len = snprintf(line, sizeof(line), "%s\t%s\t%s\t%s\t%d\n", job_id, video_path, task, params, np);
+    if (len <= 0 || len >= (int)sizeof(line) || send(fd, line, len, MSG_NOSIGNAL) != len) {
+        close(fd);
+        return -1;
+    }
+
+    // "OK" o "ERROR", y el registro de metricas del job si lo hay
+    FILE *stream = fdopen(fd, "r");
+    char *response = NULL;
+    size_t capacity = 0;
+    ssize_t used = stream ? getline(&response, &capacity, stream) : -1;
+    if (stream) {
+        fclose(stream);
+    } else {
+        close(fd);
+    }
+
+    if (used <= 0) {
+        // El servidor se cayo durante el job: el proximo mensaje lo vuelve a levantar
+        fprintf(stderr, "❌ El job server cerro la conexion sin responder\n");
+        free(response);
+        return 1;
+    }
+    response[strcspn(response, "\n")] = '\0';
+    char *record = strchr(response, ' ');
+    if (record) {
+        *record++ = '\0';
+        *metrics = cJSON_Parse(record);
+    }
+    int result = (strcmp(response, "OK") == 0) ? 0 : (strcmp(response, "REJECTED") == 0) ? JOB_EXIT_REJECTED : 1;
+    free(response);
+    return result;
+}
+
+/**
+ * Ultimo registro de metricas que process_video dejo en el log de un job
+ * corrido con mpirun directo, o NULL si no hay (p.ej. un job rechazado antes
+ * de repartir los GOPs).
+ */
+static cJSON *load_job_metrics(const char *job_id) {
+    char path[256];
+    snprintf(path, sizeof(path), JOB_LOG_FORMAT, job_id);
+    FILE *log = fopen(path, "r");
+    if (!log) {
+        return NULL;
+    }
+
+    cJSON *metrics = NULL;
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+    while ((len = getline(&line, &capacity, log)) > 0) {
+        size_t prefix = strlen(METRICS_PREFIX);
+        if ((size_t)len > prefix && strncmp(line, METRICS_PREFIX, prefix) == 0) {
+            cJSON *parsed = cJSON_ParseWithLength(line + prefix, len - prefix);
+            if (parsed) {
+                cJSON_Delete(metrics);
+                metrics = parsed;
+            }
+        }
+    }
+    free(line);
+    fclose(log);
+    return metrics;
+}
+
+/**
+ * Deja el registro de metricas del job para el padre, que lo publica al
+ * recoger al hijo. Sin registro no se escribe nada.
+ */
+static void save_job_metrics(const JobSlot *slot, const char *job_id, const cJSON *metrics) {
+    char *text = metrics ? cJSON_PrintUnformatted(metrics) : NULL;
+    if (!text) {
+        return;
+    }
+    char path[256];
+    snprintf(path, sizeof(path), JOB_METRICS_FORMAT, slot->index);
+    FILE *f = fopen(path, "w");
+    int written = f && fputs(text, f) >= 0;
+    if ((f && fclose(f) != 0) || !written) {
+        fprintf(stderr, "⚠️  No se pudieron guardar las metricas del job %s\n", job_id);
+    }
+    free(text);
+}
+
+// Registro que dejo save_job_metrics en el slot, o NULL; el archivo se borra
+static cJSON *take_job_metrics(const JobSlot *slot) {
+    char path[256];
+    snprintf(path, sizeof(path), JOB_METRICS_FORMAT, slot->index);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return NULL;
+    }
+
+    cJSON *metrics = NULL;
+    char *text = NULL;
+    size_t capacity = 0;
+    ssize_t len = getdelim(&text, &capacity, '\0', f);
+    if (len > 0) {
+        metrics = cJSON_ParseWithLength(text, len);
+    }
+    free(text);
+    fclose(f);
+    unlink(path);
+    return metrics;
+}
 
 /**
  * Función para procesar un mensaje recibido
  * Parsea el JSON y extrae los campos necesarios
+ * Corre en el proceso hijo del slot; devuelve 0 si el job termino bien, 1 si
+ * fallo y JOB_EXIT_REJECTED si reintentarlo no cambiaria nada
  */
-void process_message(const char *message, size_t message_len) {
+int process_message(const char *message, size_t message_len, const JobSlot *slot) {
     printf("\n========================================\n");
     printf("📨 MENSAJE RECIBIDO DE LA COLA\n");
     printf("========================================\n");
@@ -42,7 +490,7 @@ void process_message(const char *message, size_t message_len) {
         if (error_ptr != NULL) {
             fprintf(stderr, "❌ Error parseando JSON: %s\n", error_ptr);
         }
-        return;
+        return JOB_EXIT_REJECTED;
     }
 
     // Extraer campos del JSON
@@ -55,7 +503,7 @@ void process_message(const char *message, size_t message_len) {
     if (!cJSON_IsString(job_id) || !cJSON_IsString(video_path) || !cJSON_IsString(task)) {
         fprintf(stderr, "❌ Error: Faltan campos obligatorios (job_id, video_path, task)\n");
         cJSON_Delete(json);
-        return;
+        return JOB_EXIT_REJECTED;
     }
 
     // Imprimir información extraída
@@ -80,25 +528,51 @@ void process_message(const char *message, size_t message_len) {
         params_str = strdup("{}");
     }
 
-    // Ejecutar el comando MPI como el usuario mpiuser (usa /home/mpiuser/.ssh)
-    // Esto evita que mpirun intente SSH como root y falle por host-key/credenciales
-    char command[4096];
-    snprintf(command, sizeof(command),
-        "su - mpiuser -c 'mpirun --allow-run-as-root --mca btl_tcp_if_include eth0 --mca oob_tcp_if_include eth0 --mca routed direct "
-        "-np 6 -H master:2,worker1:2,worker2:2 /usr/local/bin/process_video %s %s %s \"%s\" > /var/log/mpi_jobs/%s.log 2>&1'",
-        job_id->valuestring,
-        video_path->valuestring,
-        task->valuestring,
-        params_str,
-        job_id->valuestring
-    );
-    
-    printf("Ejecutando: %s\n", command);
-    fflush(stdout);
-    
-    int result = system(command);
+    char hosts[512];
+    int np = choose_num_ranks(json, params, slot);
+    int num_hosts = place_ranks(slot, np, hosts, sizeof(hosts));
+    printf("🧮 Asignacion: %d ranks en %s\n", np, hosts);
+
+    // El job server de la particion corre con todos sus slots y usa solo los np que pide el job
+    char *params_line = cJSON_IsObject(params) ? cJSON_PrintUnformatted(params) : NULL;
+    cJSON *metrics = NULL;
+    int result = submit_to_job_server(slot, job_id->valuestring, video_path->valuestring, task->valuestring,
+                                      params_line ? params_line : "{}", np, &metrics);
+    free(params_line);
+
+    if (result >= 0) {
+        printf("Job %s ejecutado en el job server %d\n", job_id->valuestring, slot->index);
+    } else {
+        // Ejecutar el comando MPI como el usuario mpiuser (usa /home/mpiuser/.ssh)
+        // Esto evita que mpirun intente SSH como root y falle por host-key/credenciales
+        char command[4096];
+        snprintf(command, sizeof(command),
+            "su - mpiuser -c '" MPIRUN_CMD " %s -np %d -H %s /usr/local/bin/process_video %s %s %s \"%s\" > /var/log/mpi_jobs/%s.log 2>&1'",
+            num_hosts == 1 ? SHARED_MEMORY_BTL : "",
+            np,
+            hosts,
+            job_id->valuestring,
+            video_path->valuestring,
+            task->valuestring,
+            params_str,
+            job_id->valuestring
+        );
+
+        printf("Ejecutando: %s\n", command);
+        fflush(stdout);
+
+        int status = system(command);
+        result = (status == 0) ? 0 : (WIFEXITED(status) && WEXITSTATUS(status) == JOB_EXIT_REJECTED) ? JOB_EXIT_REJECTED : 1;
+        // Este mpirun corre en este host: su log, con el registro de metricas, esta aca
+        metrics = load_job_metrics(job_id->valuestring);
+    }
+    save_job_metrics(slot, job_id->valuestring, metrics);
+    cJSON_Delete(metrics);
+
     if (result == 0) {
         printf("Procesamiento completado exitosamente\n");
+    } else if (result == JOB_EXIT_REJECTED) {
+        fprintf(stderr, "Job rechazado: tarea, params o video invalidos, no se reintenta\n");
     } else {
         fprintf(stderr, "Error en procesamiento (codigo: %d)\n", result);
     }
@@ -109,6 +583,180 @@ void process_message(const char *message, size_t message_len) {
     // Liberar memoria
     free(params_str);
     cJSON_Delete(json);
+    return result;
+}
+
+static int num_busy_slots(void) {
+    int busy = 0;
+    for (int i = 0; i < num_slots; i++) {
+        busy += (slots[i].pid != 0);
+    }
+    return busy;
+}
+
+static JobSlot *find_free_slot(void) {
+    for (int i = 0; i < num_slots; i++) {
+        if (slots[i].pid == 0) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Lanza el job en un proceso hijo para no bloquear el loop de consumo.
+ * El hijo no toca la conexion AMQP: solo el padre confirma mensajes.
+ */
+static int launch_job(JobSlot *slot, const amqp_envelope_t *envelope) {
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "❌ Error: fork fallo: %s\n", strerror(errno));
+        return 0;
+    }
+    if (pid == 0) {
+        int result = process_message((const char *)envelope->message.body.bytes,
+                                     envelope->message.body.len, slot);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(result);
+    }
+
+    slot->pid = pid;
+    slot->delivery_tag = envelope->delivery_tag;
+    slot->job_id[0] = '\0';
+    cJSON *json = cJSON_ParseWithLength((const char *)envelope->message.body.bytes, envelope->message.body.len);
+    const cJSON *job_id = json ? cJSON_GetObjectItemCaseSensitive(json, "job_id") : NULL;
+    if (cJSON_IsString(job_id)) {
+        snprintf(slot->job_id, sizeof(slot->job_id), "%s", job_id->valuestring);
+    }
+    const cJSON *attempt = json ? cJSON_GetObjectItemCaseSensitive(json, "attempt") : NULL;
+    slot->attempt = (cJSON_IsNumber(attempt) && attempt->valueint > 1) ? attempt->valueint : 1;
+    cJSON_Delete(json);
+
+    // Sin memoria para la copia el job corre igual, solo que no se reintenta
+    slot->message_len = envelope->message.body.len;
+    slot->message = (char *)malloc(slot->message_len);
+    if (slot->message) {
+        memcpy(slot->message, envelope->message.body.bytes, slot->message_len);
+    }
+    printf("▶️  Job lanzado en slot %d (pid %d, -np %d)\n", slot->index, (int)pid, slot->np);
+    return 1;
+}
+
+/**
+ * Publica en la cola de resultados el estado final del job y sus metricas
+ * por rank, para que la API actualice el job sin consultar los logs. Toma
+ * posesion de metrics.
+ */
+static void publish_job_result(amqp_connection_state_t conn, const JobSlot *slot, int ok, cJSON *metrics) {
+    if (!slot->job_id[0]) {
+        cJSON_Delete(metrics);
+        return;
+    }
+
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "job_id", slot->job_id);
+    cJSON_AddStringToObject(result, "status", ok ? "completed" : "failed");
+    if (metrics) {
+        cJSON_AddItemToObject(result, "metrics", metrics);
+    } else {
+        cJSON_AddNullToObject(result, "metrics");
+    }
+
+    char *body = cJSON_PrintUnformatted(result);
+    cJSON_Delete(result);
+    if (!body) {
+        return;
+    }
+
+    amqp_basic_properties_t props;
+    props._flags = AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
+    props.content_type = amqp_cstring_bytes("application/json");
+    props.delivery_mode = 2;  // persistente
+    if (amqp_basic_publish(conn, 1, amqp_empty_bytes, amqp_cstring_bytes(RESULTS_QUEUE_NAME), 0, 0,
+                           &props, amqp_cstring_bytes(body)) != AMQP_STATUS_OK) {
+        fprintf(stderr, "⚠️  No se pudo publicar el resultado del job %s\n", slot->job_id);
+    }
+    free(body);
+}
+
+/**
+ * Vuelve a publicar en la cola de jobs el mensaje de un job fallido con
+ * "attempt" incrementado. Con DVP_CHECKPOINT=1 process_video retoma el mismo
+ * job_id desde el checkpoint de sus segmentos, asi que el reintento solo
+ * procesa los GOPs que faltaron. Los jobs rechazados no llegan aca.
+ * Devuelve 0 si no quedan intentos o no se pudo publicar.
+ */
+static int retry_job(amqp_connection_state_t conn, const JobSlot *slot) {
+    const char *env = getenv("DVP_JOB_ATTEMPTS");
+    int max_attempts = (env && atoi(env) > 0) ? atoi(env) : DEFAULT_JOB_ATTEMPTS;
+    if (!slot->message || !slot->job_id[0] || slot->attempt >= max_attempts) {
+        return 0;
+    }
+
+    cJSON *json = cJSON_ParseWithLength(slot->message, slot->message_len);
+    if (!cJSON_IsObject(json)) {
+        cJSON_Delete(json);
+        return 0;
+    }
+    cJSON_DeleteItemFromObjectCaseSensitive(json, "attempt");
+    cJSON_AddNumberToObject(json, "attempt", slot->attempt + 1);
+    char *body = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    if (!body) {
+        return 0;
+    }
+
+    amqp_basic_properties_t props;
+    props._flags = AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
+    props.content_type = amqp_cstring_bytes("application/json");
+    props.delivery_mode = 2;  // persistente
+    int ok = amqp_basic_publish(conn, 1, amqp_empty_bytes, amqp_cstring_bytes(QUEUE_NAME), 0, 0,
+                                &props, amqp_cstring_bytes(body)) == AMQP_STATUS_OK;
+    free(body);
+    if (ok) {
+        printf("🔁 Job %s reencolado (intento %d de %d)\n", slot->job_id, slot->attempt + 1, max_attempts);
+    } else {
+        fprintf(stderr, "⚠️  No se pudo reencolar el job %s\n", slot->job_id);
+    }
+    return ok;
+}
+
+// Recoge los hijos terminados, confirma cada mensaje al terminar su propio job y publica su resultado
+static void reap_jobs(amqp_connection_state_t conn, int block) {
+    while (1) {
+        int status;
+        pid_t pid = waitpid(-1, &status, block ? 0 : WNOHANG);
+        if (pid <= 0) {
+            return;
+        }
+        block = 0;
+
+        for (int i = 0; i < num_slots; i++) {
+            if (slots[i].pid == pid) {
+                int ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                int rejected = WIFEXITED(status) && WEXITSTATUS(status) == JOB_EXIT_REJECTED;
+                printf("%s Slot %d libre (pid %d, %s)\n", ok ? "✅" : "❌", i, (int)pid,
+                       ok ? "job completado" : rejected ? "job rechazado" : "job fallido");
+                // El reintento se publica antes del ACK: si el consumer cae en el medio, el job se repite
+                int retried = !ok && !rejected && retry_job(conn, &slots[i]);
+                amqp_basic_ack(conn, 1, slots[i].delivery_tag, 0);
+                cJSON *metrics = take_job_metrics(&slots[i]);
+                if (retried) {
+                    cJSON_Delete(metrics);
+                } else {
+                    publish_job_result(conn, &slots[i], ok, metrics);
+                }
+                free(slots[i].message);
+                slots[i].message = NULL;
+                slots[i].pid = 0;
+                break;
+            }
+        }
+    }
 }
 
 /**
@@ -180,11 +828,44 @@ int main(int argc, char *argv[]) {
     if (!rabbitmq_user) rabbitmq_user = "guest";
     if (!rabbitmq_password) rabbitmq_password = "guest";
 
+    // Inventario: hostfile de OpenMPI si hay, si no la lista de DVP_CLUSTER_HOSTS
+    char inventory[1024];
+    const char *hostfile = getenv("DVP_HOSTFILE");
+    const char *cluster_hosts = getenv("DVP_CLUSTER_HOSTS");
+    if (!cluster_hosts || !*cluster_hosts) cluster_hosts = DEFAULT_CLUSTER_HOSTS;
+    if (hostfile && *hostfile) {
+        if (load_hostfile(hostfile, inventory, sizeof(inventory))) {
+            cluster_hosts = inventory;
+        } else {
+            fprintf(stderr, "⚠️  No se pudo leer DVP_HOSTFILE %s, se usa %s\n", hostfile, cluster_hosts);
+        }
+    }
+    int max_inflight = getenv("DVP_MAX_INFLIGHT") ? atoi(getenv("DVP_MAX_INFLIGHT")) : 1;
+    if (max_inflight < 1) max_inflight = 1;
+
+    num_slots = partition_cluster(cluster_hosts, max_inflight);
+    if (num_slots == 0) {
+        fprintf(stderr, "❌ Error: DVP_CLUSTER_HOSTS no tiene slots validos: %s\n", cluster_hosts);
+        return 1;
+    }
+
+    // El hijo que lanza un job server anota si respondio; el padre lo conserva para el proximo job
+    int *server_states = (int *)mmap(NULL, num_slots * sizeof(int), PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    for (int i = 0; i < num_slots && server_states != MAP_FAILED; i++) {
+        server_states[i] = SERVER_UNKNOWN;
+        slots[i].server_state = &server_states[i];
+    }
+
     printf("🚀 Iniciando RabbitMQ Consumer para MPI Master\n");
     printf("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n");
     printf("📡 Host: %s:%d\n", rabbitmq_host, rabbitmq_port);
     printf("👤 Usuario: %s\n", rabbitmq_user);
     printf("📬 Cola: %s\n", QUEUE_NAME);
+    printf("🧮 Jobs simultaneos: %d\n", num_slots);
+    for (int i = 0; i < num_slots; i++) {
+        printf("   Slot %d: -np %d -H %s\n", i, slots[i].np, slots[i].hosts);
+    }
     printf("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n\n");
     fflush(stdout);
 
@@ -257,12 +938,23 @@ int main(int argc, char *argv[]) {
     printf("✅ Cola '%s' declarada (mensajes en cola: %d)\n", 
            QUEUE_NAME, queue_declare->message_count);
 
-    // 5. Configurar QoS (procesar 1 mensaje a la vez)
+    // Cola de resultados: la API la consume para enterarse de que termino cada job
+    amqp_queue_declare(conn, 1, amqp_cstring_bytes(RESULTS_QUEUE_NAME), 0, 1, 0, 0, amqp_empty_table);
+    reply = amqp_get_rpc_reply(conn);
+    if (check_amqp_error(reply, "Declarar cola de resultados")) {
+        amqp_channel_close(conn, 1, AMQP_REPLY_SUCCESS);
+        amqp_connection_close(conn, AMQP_REPLY_SUCCESS);
+        amqp_destroy_connection(conn);
+        return 1;
+    }
+    printf("✅ Cola '%s' declarada\n", RESULTS_QUEUE_NAME);
+
+    // 5. Configurar QoS (tantos mensajes sin confirmar como slots)
     amqp_basic_qos(
         conn,
         1,      // canal
         0,      // prefetch_size
-        1,      // prefetch_count (1 mensaje a la vez)
+        num_slots, // prefetch_count (un mensaje por slot)
         0       // global
     );
     reply = amqp_get_rpc_reply(conn);
@@ -300,6 +992,7 @@ int main(int argc, char *argv[]) {
     // 7. Loop infinito: Esperar y procesar mensajes
     while (1) {
         amqp_envelope_t envelope;
+        reap_jobs(conn, 0);
         amqp_maybe_release_buffers(conn);
 
         // Esperar mensaje (timeout de 1 segundo para permitir señales)
@@ -330,14 +1023,17 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        // Procesar mensaje recibido
-        process_message(
-            (const char *)envelope.message.body.bytes,
-            envelope.message.body.len
-        );
+        // El prefetch no entrega mas mensajes que slots, pero por las dudas se espera uno libre
+        JobSlot *slot = find_free_slot();
+        if (!slot) {
+            reap_jobs(conn, 1);
+            slot = find_free_slot();
+        }
 
-        // Enviar ACK (confirmar que procesamos el mensaje)
-        amqp_basic_ack(conn, 1, envelope.delivery_tag, 0);
+        // El ACK se manda cuando termina el hijo del job (reap_jobs)
+        if (!slot || !launch_job(slot, &envelope)) {
+            amqp_basic_nack(conn, 1, envelope.delivery_tag, 0, 1);
+        }
 
         // Liberar memoria del envelope
         amqp_destroy_envelope(&envelope);
@@ -345,6 +1041,9 @@ int main(int argc, char *argv[]) {
 
     // 8. Cleanup (solo se alcanza si hay error o señal de parada)
     printf("\n🛑 Cerrando consumer...\n");
+    while (num_busy_slots() > 0) {
+        reap_jobs(conn, 1);
+    }
     amqp_channel_close(conn, 1, AMQP_REPLY_SUCCESS);
     amqp_connection_close(conn, AMQP_REPLY_SUCCESS);
     amqp_destroy_connection(conn);
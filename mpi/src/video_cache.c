@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "video_cache.h"
+
+#define INDEX_MAGIC 0x49505644u  // "DVPI"
+#define INDEX_VERSION 1
+#define ORPHAN_INDEX_AGE (24 * 3600)  // un .idx sin video se borra pasado un dia
+
+typedef struct {
+    char key[VIDEO_CACHE_KEY_SIZE];
+    time_t mtime;
+    int64_t size;
+} CacheEntry;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    GopIndex index;  // gops no se usa: las entradas van a continuacion
+} IndexHeader;
+
+int video_cache_open(VideoCache *cache, const char *dir, int64_t budget) {
+    snprintf(cache->dir, sizeof(cache->dir), "%s", dir);
+    cache->budget = budget;
+    if (budget <= 0) {
+        cache->budget = 0;
+        return 0;
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Aviso: No se pudo crear la cache %s, se descarga siempre de MinIO\n", dir);
+        cache->budget = 0;
+        return 0;
+    }
+    return 1;
+}
+
+// FNV-1a de 64 bits sobre objeto, ETag y tamano
+void video_cache_key(const char *object, const char *etag, int64_t size, char key[VIDEO_CACHE_KEY_SIZE]) {
+    char text[1024];
+    int len = snprintf(text, sizeof(text), "%s\n%s\n%lld", object, etag, (long long)size);
+    if (len >= (int)sizeof(text)) {
+        len = sizeof(text) - 1;
+    }
+    uint64_t hash = 1469598103934665603ULL;
+    for (int i = 0; i < len; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    snprintf(key, VIDEO_CACHE_KEY_SIZE, "%016llx", (unsigned long long)hash);
+}
+
+static void entry_path(const VideoCache *cache, const char *key, const char *ext, char *path, size_t size) {
+    snprintf(path, size, "%s/%s.%s", cache->dir, key, ext);
+}
+
+static int lock_cache(const VideoCache *cache) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/.lock", cache->dir);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static void unlock_cache(int fd) {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+int video_cache_lookup(const VideoCache *cache, const char *key, const char *dest) {
+    if (cache->budget <= 0) {
+        return 0;
+    }
+    int lock = lock_cache(cache);
+    if (lock < 0) {
+        return 0;
+    }
+
+    char path[512];
+    entry_path(cache, key, "mp4", path, sizeof(path));
+    int hit = (link(path, dest) == 0);
+    if (hit) {
+        // La fecha de modificacion es la de ultimo uso para el desalojo
+        utimensat(AT_FDCWD, path, NULL, 0);
+    } else if (errno == EXDEV) {
+        fprintf(stderr, "Aviso: La cache %s no esta en el mismo sistema de archivos que %s\n", cache->dir, dest);
+    }
+
+    unlock_cache(lock);
+    return hit;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const CacheEntry *x = (const CacheEntry *)a;
+    const CacheEntry *y = (const CacheEntry *)b;
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+static void remove_entry(const VideoCache *cache, const char *key) {
+    char path[512];
+    entry_path(cache, key, "mp4", path, sizeof(path));
+    unlink(path);
+    entry_path(cache, key, "idx", path, sizeof(path));
+    unlink(path);
+}
+
+// Con el lock tomado: desaloja por LRU hasta que entren incoming bytes mas
+static void evict(const VideoCache *cache, int64_t incoming) {
+    DIR *dir = opendir(cache->dir);
+    if (!dir) {
+        return;
+    }
+
+    CacheEntry *entries = NULL;
+    int num_entries = 0;
+    int capacity = 0;
+    int64_t total = 0;
+    time_t now = time(NULL);
+    struct dirent *de;
+
+    while ((de = readdir(dir)) != NULL) {
+        size_t len = strlen(de->d_name);
+        if (len != VIDEO_CACHE_KEY_SIZE - 1 + 4 || de->d_name[VIDEO_CACHE_KEY_SIZE - 1] != '.') {
+            continue;
+        }
+        const char *ext = de->d_name + VIDEO_CACHE_KEY_SIZE;
+        char key[VIDEO_CACHE_KEY_SIZE];
+        memcpy(key, de->d_name, VIDEO_CACHE_KEY_SIZE - 1);
+        key[VIDEO_CACHE_KEY_SIZE - 1] = '\0';
+
+        char path[512];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, de->d_name);
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+
+        if (strcmp(ext, "idx") == 0) {
+            char video[512];
+            entry_path(cache, key, "mp4", video, sizeof(video));
+            if (access(video, F_OK) != 0 && now - st.st_mtime > ORPHAN_INDEX_AGE) {
+                unlink(path);
+            }
+            continue;
+        }
+        if (strcmp(ext, "mp4") != 0) {
+            continue;
+        }
+
+        if (num_entries == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            CacheEntry *grown = (CacheEntry *)realloc(entries, capacity * sizeof(CacheEntry));
+            if (!grown) {
+                break;
+            }
+            entries = grown;
+        }
+        CacheEntry *e = &entries[num_entries++];
+        memcpy(e->key, key, VIDEO_CACHE_KEY_SIZE);
+        e->mtime = st.st_mtime;
+        e->size = (int64_t)st.st_size;
+        total += e->size;
+    }
+    closedir(dir);
+
+    qsort(entries, num_entries, sizeof(CacheEntry), compare_entries);
+    for (int i = 0; i < num_entries && total + incoming > cache->budget; i++) {
+        printf("Cache: desalojando %s (%.1f MB)\n", entries[i].key, entries[i].size / (1024.0 * 1024.0));
+        remove_entry(cache, entries[i].key);
+        total -= entries[i].size;
+    }
+    fflush(stdout);
+    free(entries);
+}
+
+int video_cache_insert(const VideoCache *cache, const char *key, const char *src) {
+    struct stat st;
+    if (cache->budget <= 0 || stat(src, &st) != 0 || st.st_size > cache->budget) {
+        return 0;
+    }
+    int lock = lock_cache(cache);
+    if (lock < 0) {
+        return 0;
+    }
+
+    char path[512];
+    entry_path(cache, key, "mp4", path, sizeof(path));
+    int ok;
+    if (access(path, F_OK) == 0) {
+        // Otro job del nodo ya lo agrego
+        ok = 1;
+    } else {
+        evict(cache, st.st_size);
+        ok = (link(src, path) == 0);
+        if (ok) {
+            utimensat(AT_FDCWD, path, NULL, 0);
+            printf("Cache: video guardado como %s (%.1f MB)\n", key, st.st_size / (1024.0 * 1024.0));
+            fflush(stdout);
+        } else {
+            fprintf(stderr, "Aviso: No se pudo guardar el video en la cache %s\n", cache->dir);
+        }
+    }
+
+    unlock_cache(lock);
+    return ok;
+}
+
+int video_cache_load_index(const VideoCache *cache, const char *key, GopIndex *index) {
+    char path[512];
+    entry_path(cache, key, "idx", path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+
+    IndexHeader header;
+    int ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == INDEX_MAGIC &&
+             header.version == INDEX_VERSION && header.index.num_gops > 0;
+    GopEntry *gops = ok ? (GopEntry *)malloc(header.index.num_gops * sizeof(GopEntry)) : NULL;
+    ok = ok && gops && fread(gops, sizeof(GopEntry), header.index.num_gops, f) == (size_t)header.index.num_gops;
+    fclose(f);
+
+    if (!ok) {
+        free(gops);
+        return 0;
+    }
+    *index = header.index;
+    index->gops = gops;
+    return 1;
+}
+
+void video_cache_store_index(const VideoCache *cache, const char *key, const GopIndex *index) {
+    if (cache->budget <= 0 || index->num_gops <= 0) {
+        return;
+    }
+
+    // Se escribe aparte y se renombra: un lector nunca ve un indice a medias
+    char path[512];
+    char tmp[544];
+    entry_path(cache, key, "idx", path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.index = *index;
+    header.index.gops = NULL;
+
+    FILE *f = fopen(tmp, "wb");
+    int ok = f && fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(index->gops, sizeof(GopEntry), index->num_gops, f) == (size_t)index->num_gops;
+    if (f && fclose(f) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+    }
+}
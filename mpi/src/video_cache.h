@@ -0,0 +1,51 @@
+#ifndef VIDEO_CACHE_H
+#define VIDEO_CACHE_H
+
+#include <stdint.h>
+#include "gop_index.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VIDEO_CACHE_KEY_SIZE 17  // 16 digitos hex + '\0'
+
+/*
+ * Cache de videos de entrada local al nodo, direccionada por contenido: la
+ * clave sale del objeto (bucket/key), su ETag y su tamano, asi que un objeto
+ * re-subido con el mismo nombre nunca da un hit viejo. Cada entrada es
+ * <clave>.mp4 (el video completo) y <clave>.idx (su indice de GOPs).
+ *
+ * Los videos se enlazan con link() en ambos sentidos: un hit deja el video en
+ * la ruta del job sin copiarlo y una entrada desalojada sigue viva para el
+ * job que la esta leyendo. El directorio tiene que estar en el mismo sistema
+ * de archivos que los videos de los jobs (/tmp).
+ *
+ * Busquedas y altas toman un flock sobre <dir>/.lock, asi que varios jobs o
+ * procesos del mismo nodo pueden usarla a la vez. Al agregar un video se
+ * desalojan los menos usados hasta entrar en el presupuesto.
+ */
+typedef struct {
+    char dir[256];
+    int64_t budget;  // bytes; 0 = cache desactivada
+} VideoCache;
+
+// Crea el directorio si hace falta. Devuelve 0 (cache desactivada) si no se puede
+int video_cache_open(VideoCache *cache, const char *dir, int64_t budget);
+
+void video_cache_key(const char *object, const char *etag, int64_t size, char key[VIDEO_CACHE_KEY_SIZE]);
+
+// Enlaza el video cacheado en dest y lo marca como recien usado. Devuelve 1 si estaba
+int video_cache_lookup(const VideoCache *cache, const char *key, const char *dest);
+
+// Agrega src (un video completo) a la cache, desalojando entradas viejas si hace falta
+int video_cache_insert(const VideoCache *cache, const char *key, const char *src);
+
+int video_cache_load_index(const VideoCache *cache, const char *key, GopIndex *index);
+void video_cache_store_index(const VideoCache *cache, const char *key, const GopIndex *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,46 +1,112 @@
 #include <mpi.h>
 #include <stdio.h>
-#include <opencv2/opencv.hpp>
+#include "monotonic_clock.h"
 #include "video_decompose.h"
 
-using namespace cv;
+extern "C" {
+#include <libavformat/avformat.h>
+}
 
-extern "C" int decompose_video(const char *video_file, int rank, int num_procs) {
-    int total_frames = 0;
-    
-    if (rank == 0) {
-        VideoCapture cap(video_file);
-        if (!cap.isOpened()) {
-            fprintf(stderr, "Error: No se pudo abrir el video %s\n", video_file);
-            return 0;
+// Abre el video y lo posiciona exactamente en el keyframe del GOP indicado
+static AVFormatContext *open_at_gop(const VideoInput *input, const GopIndex *index, int gop, int rank,
+                                    AVIOContext **avio) {
+    *avio = open_video_source(input);
+    AVFormatContext *fmt = *avio ? avformat_alloc_context() : NULL;
+    if (!fmt) {
+        fprintf(stderr, "[Rank %d] Error: No se pudo abrir el video %s\n", rank, video_input_name(input));
+        close_video_source(avio);
+        return NULL;
+    }
+    fmt->pb = *avio;
+
+    // Si falla, avformat_open_input libera fmt pero no el AVIOContext propio
+    if (avformat_open_input(&fmt, NULL, NULL, NULL) < 0) {
+        fprintf(stderr, "[Rank %d] Error: No se pudo abrir el video %s\n", rank, video_input_name(input));
+        close_video_source(avio);
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+        if ((int)i != index->stream_index && (int)i != index->audio_stream_index) {
+            fmt->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    // min_ts == max_ts: el demuxer no puede caer en un keyframe anterior
+    int64_t ts = index->gops[gop].timestamp;
+    if (avformat_seek_file(fmt, index->stream_index, ts, ts, ts, 0) < 0) {
+        fprintf(stderr, "[Rank %d] Error: No se pudo posicionar en el GOP %d\n", rank, gop);
+        avformat_close_input(&fmt);
+        close_video_source(avio);
+        return NULL;
+    }
+
+    return fmt;
+}
+
+extern "C" int decompose_video(const VideoInput *input, const GopIndex *index, int first_gop, int end_gop,
+                               int rank, const TaskConfig *cfg, const char *segment_file,
+                               const SegmentRuntime *runtime) {
+    if (first_gop >= end_gop) {
+        printf("[MPI Rank %d] Sin GOPs asignados (%d GOPs en el video)\n", rank, index->num_gops);
+        return 1;
+    }
+
+    const GopEntry *first = &index->gops[first_gop];
+    const GopEntry *last = &index->gops[end_gop - 1];
+    int start = first->frame_start;
+    int end = last->frame_start + last->frame_count;
+
+    printf("[MPI Rank %d] Dominio asignado: GOPs %d a %d, Frames %d a %d (Total: %d), bytes %lld-%lld\n",
+           rank, first_gop, end_gop, start, end, (end - start),
+           (long long)first->byte_start, (long long)last->byte_end);
+
+    double started = now_seconds();
+    AVIOContext *avio = NULL;
+    AVFormatContext *fmt = open_at_gop(input, index, first_gop, rank, &avio);
+    if (!fmt) {
+        return 0;
+    }
+
+    // El primer paquete tras el seek debe ser el keyframe del GOP
+    AVPacket *pkt = av_packet_alloc();
+    int positioned = 0;
+    while (pkt && av_read_frame(fmt, pkt) >= 0) {
+        if (pkt->stream_index == index->stream_index) {
+            positioned = (pkt->flags & AV_PKT_FLAG_KEY) &&
+                         (pkt->pos < 0 || pkt->pos == first->byte_start);
+            av_packet_unref(pkt);
+            break;
         }
-        total_frames = (int)cap.get(CAP_PROP_FRAME_COUNT);
-        printf("[Master] Video abierto. Total Frames: %d\n", total_frames);
-    }
-    
-    MPI_Bcast(&total_frames, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    
-    if (total_frames <= 0) {
-        fprintf(stderr, "[Rank %d] Error: No se pudo obtener el total de frames\n", rank);
+        av_packet_unref(pkt);
+    }
+    av_packet_free(&pkt);
+
+    if (!positioned) {
+        fprintf(stderr, "[Rank %d] Error: El seek no cayo en el keyframe del GOP %d\n", rank, first_gop);
+        avformat_close_input(&fmt);
+        close_video_source(&avio);
         return 0;
     }
-    
-    int frames_per_rank = total_frames / num_procs;
-    int start = rank * frames_per_rank;
-    int end = (rank == num_procs - 1) ? total_frames : start + frames_per_rank;
-    
-    printf("[MPI Rank %d] Dominio asignado: Frames %d a %d (Total: %d)\n", 
-           rank, start, end, (end - start));
-    
-    VideoCapture cap_worker(video_file);
-    if (cap_worker.isOpened()) {
-        cap_worker.set(CAP_PROP_POS_FRAMES, start);
-        double current_pos = cap_worker.get(CAP_PROP_POS_FRAMES);
-        printf("[MPI Rank %d] Video posicionado correctamente en frame %.0f\n", rank, current_pos);
+
+    printf("[MPI Rank %d] Video posicionado en keyframe (frame %d, t=%.3fs)\n",
+           rank, start, first->start_time);
+
+    // Volver al keyframe: el paquete de verificacion ya se consumio
+    int64_t ts = first->timestamp;
+    int ok = avformat_seek_file(fmt, index->stream_index, ts, ts, ts, 0) >= 0;
+    double positioned_at = now_seconds();
+    if (cfg->frames) {
+        ok = ok && extract_frames(fmt, index, first_gop, end_gop, cfg, segment_file, rank, runtime);
     } else {
-        fprintf(stderr, "[Rank %d] Error: No se pudo abrir el video para worker\n", rank);
-        return 0;
+        ok = ok && encode_segment(fmt, index, first_gop, end_gop, cfg, segment_file, rank, runtime);
+    }
+    if (runtime->stats) {
+        runtime->stats->seek += positioned_at - started;
+        runtime->stats->decode += now_seconds() - positioned_at;
     }
-    
-    return 1;
-}
\ No newline at end of file
+
+    avformat_close_input(&fmt);
+    close_video_source(&avio);
+    return ok;
+}
@@ -1,11 +1,24 @@
 #ifndef VIDEO_DECOMPOSE_H
 #define VIDEO_DECOMPOSE_H
 
+#include "gop_index.h"
+#include "video_source.h"
+#include "video_tasks.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-int decompose_video(const char *video_file, int rank, int num_procs);
+/*
+ * Procesa los GOPs [first_gop, end_gop) con la tarea cfg y escribe el
+ * resultado en segment_file. Un rango vacio no crea el segmento.
+ * Con input->wm != NULL el video local todavia se esta descargando: el demuxer
+ * lee a traves de la marca de agua y se bloquea hasta que sus bytes estan en
+ * disco. Con input->data lee la copia del video compartida por el nodo.
+ */
+int decompose_video(const VideoInput *input, const GopIndex *index, int first_gop, int end_gop,
+                    int rank, const TaskConfig *cfg, const char *segment_file,
+                    const SegmentRuntime *runtime);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,295 @@
+#define _GNU_SOURCE
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "video_distribute.h"
+
+#define DIST_PIECE_SIZE (8 * 1024 * 1024)  // 8 MB por mensaje
+#define DIST_TAG 100
+#define SEGMENT_SIZE_TAG 101
+#define SEGMENT_TAG 102
+#define DIST_WINDOW 8  // envios MPI_Isend en vuelo desde el rank 0
+
+// Cabecera y cola son iguales para todos los nodos: se difunden entre los lideres
+static void bcast_region(const char *base, uint8_t *shared, int64_t start, int64_t end,
+                         const NodeTopology *topo, int rank) {
+    for (int64_t offset = start; offset < end; offset += DIST_PIECE_SIZE) {
+        int len = (int)((end - offset < DIST_PIECE_SIZE) ? end - offset : DIST_PIECE_SIZE);
+        if (rank == 0) {
+            MPI_Bcast((void *)(base + offset), len, MPI_BYTE, 0, topo->leaders);
+            if (topo->node_size > 1) {
+                memcpy(shared + offset, base + offset, len);
+            }
+        } else {
+            MPI_Bcast(shared + offset, len, MPI_BYTE, 0, topo->leaders);
+        }
+    }
+}
+
+/*
+ * Rank 0: envia el span de cada worker al lider de su nodo por piezas, en
+ * orden de offset para seguir a la descarga, con hasta DIST_WINDOW envios en
+ * vuelo. Los spans de los ranks de su propio nodo los copia a la ventana.
+ */
+static int send_spans(const char *base, uint8_t *shared, const GopIndex *index,
+                      const NodeTopology *topo, int num_procs, ByteWatermark *wm) {
+    MPI_Request requests[DIST_WINDOW];
+    int in_flight = 0;
+    int slot = 0;
+    int ok = 1;
+
+    for (int r = 1; r < num_procs; r++) {
+        ByteRange span;
+        gop_span_for_rank(index, r, num_procs, &span);
+        int leader = topo->leader_of[r];
+
+        for (int64_t offset = span.start; offset < span.end; offset += DIST_PIECE_SIZE) {
+            int len = (int)(span.end - offset < DIST_PIECE_SIZE ? span.end - offset : DIST_PIECE_SIZE);
+
+            // Si la descarga fallo se sigue enviando para no dejar al lider esperando
+            if (ok && wm && !watermark_wait(wm, offset, len)) {
+                fprintf(stderr, "Error: La descarga fallo antes de enviar el span del rank %d\n", r);
+                ok = 0;
+            }
+
+            if (leader == 0) {
+                memcpy(shared + offset, base + offset, len);
+                continue;
+            }
+            if (in_flight == DIST_WINDOW) {
+                MPI_Wait(&requests[slot], MPI_STATUS_IGNORE);
+                in_flight--;
+            }
+            MPI_Isend((void *)(base + offset), len, MPI_BYTE, leader, DIST_TAG, topo->comm, &requests[slot]);
+            slot = (slot + 1) % DIST_WINDOW;
+            in_flight++;
+        }
+    }
+
+    for (int i = 0; i < in_flight; i++) {
+        MPI_Wait(&requests[(slot - in_flight + i + DIST_WINDOW) % DIST_WINDOW], MPI_STATUS_IGNORE);
+    }
+
+    return ok;
+}
+
+/*
+ * Lider de un nodo sin el rank 0: recibe los spans de sus ranks, en el mismo
+ * orden en que los envia send_spans, directo a la ventana compartida.
+ * Devuelve los bytes recibidos.
+ */
+static int64_t receive_node_spans(uint8_t *shared, const GopIndex *index, const NodeTopology *topo,
+                                  int rank, int num_procs) {
+    int64_t received = 0;
+    for (int r = 1; r < num_procs; r++) {
+        if (topo->leader_of[r] != rank) {
+            continue;
+        }
+        ByteRange span;
+        gop_span_for_rank(index, r, num_procs, &span);
+        for (int64_t offset = span.start; offset < span.end; offset += DIST_PIECE_SIZE) {
+            int len = (int)(span.end - offset < DIST_PIECE_SIZE ? span.end - offset : DIST_PIECE_SIZE);
+            MPI_Recv(shared + offset, len, MPI_BYTE, 0, DIST_TAG, topo->comm, MPI_STATUS_IGNORE);
+            received += len;
+        }
+    }
+    return received;
+}
+
+// Doble buffer: la siguiente pieza llega mientras se escribe la actual
+static int receive_range(int fd, int64_t start, int64_t end, int source, int tag,
+                         char *buffers[2], MPI_Comm comm, int rank) {
+    if (end <= start) {
+        return 1;
+    }
+
+    int ok = 1;
+    int current = 0;
+    MPI_Request request;
+    int64_t offset = start;
+    int len = (int)(end - offset < DIST_PIECE_SIZE ? end - offset : DIST_PIECE_SIZE);
+    MPI_Irecv(buffers[current], len, MPI_BYTE, source, tag, comm, &request);
+
+    while (offset < end) {
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+
+        int64_t next_offset = offset + len;
+        int next_len = 0;
+        if (next_offset < end) {
+            next_len = (int)(end - next_offset < DIST_PIECE_SIZE ? end - next_offset : DIST_PIECE_SIZE);
+            MPI_Irecv(buffers[1 - current], next_len, MPI_BYTE, source, tag, comm, &request);
+        }
+
+        if (ok && fd >= 0 && !pwrite_all(fd, buffers[current], len, offset)) {
+            fprintf(stderr, "[Rank %d] Error al escribir bytes %lld del archivo local\n",
+                    rank, (long long)offset);
+            ok = 0;
+        }
+
+        offset = next_offset;
+        len = next_len;
+        current = 1 - current;
+    }
+
+    return ok;
+}
+
+int distribute_video(const char *source_file, const GopIndex *index, const NodeTopology *topo,
+                     SharedVideo *shared, int rank, int num_procs, ByteWatermark *wm) {
+    int ok = 1;
+    int fd = -1;
+    char *base = NULL;
+
+    if (num_procs == 1) {
+        return 1;
+    }
+
+    if (rank == 0) {
+        fd = open(source_file, O_RDONLY);
+        if (fd >= 0) {
+            base = (char *)mmap(NULL, index->file_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED) {
+                base = NULL;
+            }
+        }
+        if (!base) {
+            fprintf(stderr, "Error: No se pudo mapear el video %s\n", source_file);
+            ok = 0;
+        }
+    }
+
+    // Si el rank 0 no puede leer el video se aborta antes de mover datos
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, topo->comm);
+    if (!all_ok) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+
+    if (rank == 0) {
+        printf("Distribuyendo video: cabecera %lld bytes, cola %lld bytes, %d workers en %d nodos\n",
+               (long long)index->header_end, (long long)(index->file_size - index->trailer_start),
+               num_procs - 1, topo->num_nodes);
+        fflush(stdout);
+    }
+
+    if (topo->node_rank == 0) {
+        bcast_region(base, shared->data, 0, index->header_end, topo, rank);
+        bcast_region(base, shared->data, index->trailer_start, index->file_size, topo, rank);
+    }
+
+    if (rank == 0) {
+        ok = send_spans(base, shared->data, index, topo, num_procs, wm);
+        munmap(base, index->file_size);
+        close(fd);
+    } else if (topo->node_rank == 0) {
+        int64_t received = index->header_end + (index->file_size - index->trailer_start) +
+                           receive_node_spans(shared->data, index, topo, rank, num_procs);
+        printf("[MPI Rank %d] Recibidos %lld bytes del video para %d ranks del nodo (%.1f%% del archivo)\n",
+               rank, (long long)received, topo->node_size, 100.0 * received / index->file_size);
+        fflush(stdout);
+    }
+
+    // Los demas ranks del nodo leen lo que escribio su lider recien despues de esto
+    shared_video_publish(shared, topo);
+
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, topo->comm);
+    return all_ok;
+}
+
+// Worker: envia su segmento por piezas; mientras una pieza viaja se lee la siguiente
+static int send_segment(int fd, int64_t size, char *buffers[2], MPI_Comm comm, int rank) {
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    int current = 0;
+    int ok = 1;
+
+    for (int64_t offset = 0; offset < size; offset += DIST_PIECE_SIZE) {
+        int len = (int)(size - offset < DIST_PIECE_SIZE ? size - offset : DIST_PIECE_SIZE);
+        MPI_Wait(&requests[current], MPI_STATUS_IGNORE);
+
+        // El rank 0 espera exactamente size bytes: ante un error se sigue enviando
+        if (ok && pread(fd, buffers[current], len, offset) != len) {
+            fprintf(stderr, "[Rank %d] Error al leer el segmento local\n", rank);
+            ok = 0;
+        }
+        MPI_Isend(buffers[current], len, MPI_BYTE, 0, SEGMENT_TAG, comm, &requests[current]);
+        current = 1 - current;
+    }
+
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    return ok;
+}
+
+int gather_segments(const char *const *files, const int *owners, int num_segments, MPI_Comm comm, int rank,
+                    int num_procs) {
+    int ok = 1;
+    char *buffers[2] = {NULL, NULL};
+
+    if (num_procs == 1) {
+        return 1;
+    }
+
+    buffers[0] = (char *)malloc(DIST_PIECE_SIZE);
+    buffers[1] = (char *)malloc(DIST_PIECE_SIZE);
+    ok = buffers[0] && buffers[1];
+    int all_ok;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, comm);
+    if (!all_ok) {
+        free(buffers[0]);
+        free(buffers[1]);
+        return 0;
+    }
+
+    // Un segmento a la vez, en orden: el rank 0 escribe cada uno secuencialmente
+    for (int i = 0; i < num_segments; i++) {
+        int owner = owners[i];
+        if (!files[i] || owner == 0 || (rank != 0 && rank != owner)) {
+            continue;
+        }
+        if (rank == 0) {
+            int64_t size;
+            MPI_Recv(&size, 1, MPI_INT64_T, owner, SEGMENT_SIZE_TAG, comm, MPI_STATUS_IGNORE);
+            if (size == 0) {
+                continue;
+            }
+
+            int fd = open(files[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                fprintf(stderr, "Error: No se pudo crear el segmento %s del rank %d\n", files[i], owner);
+                ok = 0;
+            }
+            ok = receive_range(fd, 0, size, owner, SEGMENT_TAG, buffers, comm, rank) && ok;
+            if (fd >= 0) {
+                close(fd);
+            }
+        } else {
+            int64_t size = 0;
+            int fd = open(files[i], O_RDONLY);
+            struct stat st;
+            if (fd >= 0 && fstat(fd, &st) == 0) {
+                size = st.st_size;
+            } else {
+                fprintf(stderr, "[Rank %d] Error: No se pudo abrir el segmento %s\n", rank, files[i]);
+                ok = 0;
+            }
+            MPI_Send(&size, 1, MPI_INT64_T, 0, SEGMENT_SIZE_TAG, comm);
+            ok = send_segment(fd, size, buffers, comm, rank) && ok;
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    free(buffers[0]);
+    free(buffers[1]);
+
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, comm);
+    return all_ok;
+}
@@ -0,0 +1,36 @@
+#ifndef VIDEO_DISTRIBUTE_H
+#define VIDEO_DISTRIBUTE_H
+
+#include "gop_index.h"
+#include "node_share.h"
+#include "video_source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Reparte el video descargado por el rank 0 sin asumir un /tmp compartido.
+ * Cada nodo recibe una sola vez la cabecera/cola del contenedor y los spans
+ * de bytes de los GOPs de sus ranks; su lider los escribe en la ventana
+ * compartida (shared, del tamano del archivo) y los demas ranks del nodo los
+ * leen de ahi sin copiarlos. En el nodo del rank 0 los copia el propio rank 0.
+ * Si el rank 0 todavia esta descargando (wm != NULL), cada pieza se envia en
+ * cuanto la marca de agua la cubre.
+ */
+int distribute_video(const char *source_file, const GopIndex *index, const NodeTopology *topo,
+                     SharedVideo *shared, int rank, int num_procs, ByteWatermark *wm);
+
+/*
+ * Trae al rank 0 los segmentos procesados por los workers. El segmento i lo
+ * tiene owners[i] en files[i] y el rank 0 lo escribe en la misma ruta; todos
+ * los ranks de comm pasan la misma tabla. Devuelve el resultado combinado.
+ */
+int gather_segments(const char *const *files, const int *owners, int num_segments, MPI_Comm comm, int rank,
+                    int num_procs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
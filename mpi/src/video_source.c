@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libavformat/avformat.h>
+#include "video_source.h"
+
+#define SOURCE_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    int fd;             // -1 sobre memoria
+    const uint8_t *data;
+    int64_t pos;
+    int64_t size;
+    ByteWatermark *wm;
+} VideoSource;
+
+void watermark_init(ByteWatermark *wm, const ByteRange *ranges, int num_ranges) {
+    pthread_mutex_init(&wm->mutex, NULL);
+    pthread_cond_init(&wm->cond, NULL);
+    wm->num_ranges = 0;
+    wm->available = 0;
+    wm->total = 0;
+    wm->failed = 0;
+    for (int i = 0; i < num_ranges && wm->num_ranges < WATERMARK_MAX_RANGES; i++) {
+        if (ranges[i].end > ranges[i].start) {
+            wm->ranges[wm->num_ranges++] = ranges[i];
+            wm->total += ranges[i].end - ranges[i].start;
+        }
+    }
+}
+
+void watermark_publish(ByteWatermark *wm, int64_t available) {
+    pthread_mutex_lock(&wm->mutex);
+    if (available > wm->available) {
+        wm->available = available;
+        pthread_cond_broadcast(&wm->cond);
+    }
+    pthread_mutex_unlock(&wm->mutex);
+}
+
+void watermark_fail(ByteWatermark *wm) {
+    pthread_mutex_lock(&wm->mutex);
+    wm->failed = 1;
+    pthread_cond_broadcast(&wm->cond);
+    pthread_mutex_unlock(&wm->mutex);
+}
+
+// Espera a que esten en disco los bytes de [offset, offset + len) que caen en rangos esperados
+int watermark_wait(ByteWatermark *wm, int64_t offset, int64_t len) {
+    int64_t needed = 0;
+    int64_t logical = 0;
+
+    for (int i = 0; i < wm->num_ranges; i++) {
+        const ByteRange *r = &wm->ranges[i];
+        if (offset < r->end && offset + len > r->start) {
+            int64_t end = (offset + len < r->end) ? offset + len : r->end;
+            needed = logical + (end - r->start);
+        }
+        logical += r->end - r->start;
+    }
+
+    pthread_mutex_lock(&wm->mutex);
+    while (wm->available < needed && !wm->failed) {
+        pthread_cond_wait(&wm->cond, &wm->mutex);
+    }
+    int ok = (wm->available >= needed);
+    pthread_mutex_unlock(&wm->mutex);
+
+    return ok;
+}
+
+void watermark_destroy(ByteWatermark *wm) {
+    pthread_mutex_destroy(&wm->mutex);
+    pthread_cond_destroy(&wm->cond);
+}
+
+int pwrite_all(int fd, const char *buf, size_t len, int64_t offset) {
+    while (len > 0) {
+        ssize_t written = pwrite(fd, buf, len, (off_t)offset);
+        if (written <= 0) {
+            return 0;
+        }
+        buf += written;
+        len -= written;
+        offset += written;
+    }
+    return 1;
+}
+
+static int source_read(void *opaque, uint8_t *buf, int buf_size) {
+    VideoSource *src = (VideoSource *)opaque;
+
+    if (src->pos >= src->size) {
+        return AVERROR_EOF;
+    }
+    if (buf_size > src->size - src->pos) {
+        buf_size = (int)(src->size - src->pos);
+    }
+    if (src->wm && !watermark_wait(src->wm, src->pos, buf_size)) {
+        return AVERROR(EIO);
+    }
+
+    if (src->data) {
+        memcpy(buf, src->data + src->pos, buf_size);
+        src->pos += buf_size;
+        return buf_size;
+    }
+
+    ssize_t n = pread(src->fd, buf, buf_size, src->pos);
+    if (n < 0) {
+        return AVERROR(EIO);
+    }
+    if (n == 0) {
+        return AVERROR_EOF;
+    }
+    src->pos += n;
+    return (int)n;
+}
+
+static int64_t source_seek(void *opaque, int64_t offset, int whence) {
+    VideoSource *src = (VideoSource *)opaque;
+
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE:
+            return src->size;
+        case SEEK_SET:
+            src->pos = offset;
+            break;
+        case SEEK_CUR:
+            src->pos += offset;
+            break;
+        case SEEK_END:
+            src->pos = src->size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    return src->pos;
+}
+
+const char *video_input_name(const VideoInput *input) {
+    return input->data ? "(memoria compartida del nodo)" : input->path;
+}
+
+struct AVIOContext *open_video_source(const VideoInput *input) {
+    VideoSource *src = (VideoSource *)calloc(1, sizeof(VideoSource));
+    if (!src) {
+        return NULL;
+    }
+
+    src->fd = -1;
+    src->wm = input->wm;
+    if (input->data) {
+        src->data = input->data;
+        src->size = input->size;
+    } else {
+        struct stat st;
+        src->fd = open(input->path, O_RDONLY);
+        if (src->fd < 0 || fstat(src->fd, &st) != 0) {
+            fprintf(stderr, "Error: No se pudo abrir el video %s\n", input->path);
+            if (src->fd >= 0) {
+                close(src->fd);
+            }
+            free(src);
+            return NULL;
+        }
+        src->size = st.st_size;
+    }
+
+    unsigned char *buffer = (unsigned char *)av_malloc(SOURCE_BUFFER_SIZE);
+    AVIOContext *avio = buffer ? avio_alloc_context(buffer, SOURCE_BUFFER_SIZE, 0, src,
+                                                    source_read, NULL, source_seek) : NULL;
+    if (!avio) {
+        av_free(buffer);
+        if (src->fd >= 0) {
+            close(src->fd);
+        }
+        free(src);
+        return NULL;
+    }
+
+    return avio;
+}
+
+void close_video_source(struct AVIOContext **avio) {
+    if (!*avio) {
+        return;
+    }
+    VideoSource *src = (VideoSource *)(*avio)->opaque;
+    av_freep(&(*avio)->buffer);
+    avio_context_free(avio);
+    if (src) {
+        if (src->fd >= 0) {
+            close(src->fd);
+        }
+        free(src);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef VIDEO_SOURCE_H
+#define VIDEO_SOURCE_H
+
+#include <pthread.h>
+#include "gop_index.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WATERMARK_MAX_RANGES 4
+
+/*
+ * Marca de agua de una descarga en curso. Los rangos esperados se descargan
+ * en el orden dado; available es el prefijo contiguo ya escrito en disco,
+ * medido sobre la concatenacion de esos rangos.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    ByteRange ranges[WATERMARK_MAX_RANGES];
+    int num_ranges;
+    int64_t available;
+    int64_t total;
+    int failed;
+} ByteWatermark;
+
+void watermark_init(ByteWatermark *wm, const ByteRange *ranges, int num_ranges);
+void watermark_publish(ByteWatermark *wm, int64_t available);
+void watermark_fail(ByteWatermark *wm);
+int watermark_wait(ByteWatermark *wm, int64_t offset, int64_t len);
+void watermark_destroy(ByteWatermark *wm);
+
+// Escribe len bytes en offset aunque pwrite escriba de a partes; devuelve 0 si fallo
+int pwrite_all(int fd, const char *buf, size_t len, int64_t offset);
+
+/*
+ * Video de entrada de un rank: un archivo local (path) o los bytes del video
+ * en la memoria compartida de su nodo (data != NULL, size bytes). Con
+ * wm != NULL el archivo todavia se esta descargando.
+ */
+typedef struct {
+    const char *path;
+    const uint8_t *data;
+    int64_t size;
+    ByteWatermark *wm;
+} VideoInput;
+
+/*
+ * Contexto de E/S para libavformat sobre el video de entrada: cada lectura
+ * dentro de un rango esperado se bloquea hasta que la marca de agua lo cubre.
+ * Sobre memoria lee directo del buffer compartido, sin copiar a disco.
+ */
+struct AVIOContext;
+struct AVIOContext *open_video_source(const VideoInput *input);
+const char *video_input_name(const VideoInput *input);
+void close_video_source(struct AVIOContext **avio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
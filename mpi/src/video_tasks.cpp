@@ -0,0 +1,1515 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cjson/cJSON.h>
+#include "frame_kernels.h"
+#include "frame_pipeline.h"
+#include "frame_pool.h"
+#include "video_tasks.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavcodec/bsf.h>
+#include <libavutil/opt.h>
+#include <libavutil/parseutils.h>
+#include <libswscale/swscale.h>
+}
+
+/*
+ * Tope de buffers por pool; se crean a demanda. El decoder retiene hasta 16
+ * referencias (H.264/HEVC) mas los frames en reordenamiento; los encoders
+ * copian el frame de entrada y sueltan el buffer enseguida. Con pipeline se
+ * suman los frames en vuelo de la ventana.
+ */
+#define DECODED_POOL_FRAMES 32
+#define PROCESSED_POOL_FRAMES 8
+
+// Con menos threads por rank el pipeline no tiene nucleos para solapar etapas
+#define PIPELINE_MIN_THREADS 3
+
+typedef int (*TaskConfigure)(const cJSON *params, TaskConfig *cfg);
+
+// Estado de escalado de un worker: libswscale y el scaler no se comparten entre threads
+typedef struct {
+    SwsContext *sws;
+    Yuv420Scaler *scaler;
+    AVFrame *processed;  // solo en el camino secuencial; el pipeline usa el del slot
+} FrameProcessor;
+
+typedef struct {
+    AVCodecContext *dec;
+    AVCodecContext *enc;
+    FrameProcessor *processors;  // uno por worker del pipeline; el [0] en el camino secuencial
+    int num_processors;
+    FramePipeline *pipeline;     // NULL: decode, proceso y encode en el mismo thread
+    pthread_mutex_t mux;         // el encoder del pipeline y el audio escriben en el mismo muxer
+    FramePool *decoded_pool;    // buffers del decoder
+    FramePool *processed_pool; // frames escalados/filtrados que van al encoder
+    AVPacket *out_pkt;
+    AVFormatContext *out;
+    AVStream *video_out;
+    AVStream *audio_out;    // NULL si el contenedor no admite el audio de entrada
+    AVBSFContext *bsf;      // cut: GOPs interiores copiados a Annex B; NULL si todo se recodifica
+    AVFormatContext *in;
+    AVStream *in_video;
+    const TaskConfig *cfg;
+    AVRational in_tb;
+    AVRational audio_tb;
+    int64_t origin;         // inicio del segmento en time_base del video de entrada
+    int64_t first_key_pts;  // AV_NOPTS_VALUE hasta el primer keyframe decodificado
+    int64_t window_start;   // frames fuera de [window_start, window_end) no se codifican
+    int64_t window_end;
+    int64_t reorder_delay;  // pts - dts de los keyframes de entrada
+    int encoder_threads;
+    int frames;
+    int copied;
+} SegmentWriter;
+
+static const char *json_string(const cJSON *params, const char *key, const char *default_value) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(params, key);
+    return cJSON_IsString(item) && item->valuestring[0] ? item->valuestring : default_value;
+}
+
+// Acepta numeros o strings numericos: la API manda los params tal cual llegan del formulario
+static int json_int(const cJSON *params, const char *key, int default_value) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(params, key);
+    if (cJSON_IsNumber(item)) {
+        return item->valueint;
+    }
+    if (cJSON_IsString(item) && item->valuestring[0]) {
+        return atoi(item->valuestring);
+    }
+    return default_value;
+}
+
+static double json_double(const cJSON *params, const char *key, double default_value) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(params, key);
+    if (cJSON_IsNumber(item)) {
+        return item->valuedouble;
+    }
+    if (cJSON_IsString(item) && item->valuestring[0]) {
+        return atof(item->valuestring);
+    }
+    return default_value;
+}
+
+static int set_output_format(TaskConfig *cfg, const char *name) {
+    static const char *formats[][3] = {
+        {"mp4", "mp4", "mp4"},
+        {"mov", "mov", "mov"},
+        {"webm", "webm", "webm"},
+        {"mkv", "matroska", "mkv"},
+    };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (strcmp(name, formats[i][0]) == 0) {
+            snprintf(cfg->format, sizeof(cfg->format), "%s", formats[i][1]);
+            snprintf(cfg->extension, sizeof(cfg->extension), "%s", formats[i][2]);
+            return 1;
+        }
+    }
+    fprintf(stderr, "Error: Formato de salida no soportado: %s\n", name);
+    return 0;
+}
+
+static int set_codec(TaskConfig *cfg, const char *name) {
+    static const char *codecs[][2] = {
+        {"h264", "libx264"},
+        {"hevc", "libx265"},
+        {"h265", "libx265"},
+        {"vp9", "libvpx-vp9"},
+        {"av1", "libaom-av1"},
+    };
+    for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+        if (strcmp(name, codecs[i][0]) == 0) {
+            snprintf(cfg->codec, sizeof(cfg->codec), "%s", codecs[i][1]);
+            return 1;
+        }
+    }
+    fprintf(stderr, "Error: Codec no soportado: %s\n", name);
+    return 0;
+}
+
+static int configure_convert(const cJSON *params, TaskConfig *cfg) {
+    const char *format = json_string(params, "output_format", "mp4");
+    const char *codec = json_string(params, "codec", strcmp(format, "webm") == 0 ? "vp9" : "h264");
+    return set_output_format(cfg, format) && set_codec(cfg, codec);
+}
+
+static int configure_resize(const cJSON *params, TaskConfig *cfg) {
+    cfg->width = json_int(params, "width", 0);
+    cfg->height = json_int(params, "height", 0);
+
+    // "720p" equivale a height = 720 con el ancho proporcional
+    const char *resolution = json_string(params, "resolution", NULL);
+    if (cfg->height <= 0 && resolution) {
+        cfg->height = atoi(resolution);
+    }
+
+    // Recorte opcional antes de escalar; sin width/height la salida mide lo recortado
+    cfg->crop_x = json_int(params, "crop_x", 0);
+    cfg->crop_y = json_int(params, "crop_y", 0);
+    cfg->crop_width = json_int(params, "crop_width", 0);
+    cfg->crop_height = json_int(params, "crop_height", 0);
+    if (cfg->crop_x < 0 || cfg->crop_y < 0 || cfg->crop_width < 0 || cfg->crop_height < 0 ||
+        (cfg->crop_width == 0) != (cfg->crop_height == 0)) {
+        fprintf(stderr, "Error: resize requiere crop_width y crop_height positivos para recortar\n");
+        return 0;
+    }
+
+    if (cfg->width < 0 || cfg->height < 0 || (cfg->width == 0 && cfg->height == 0 && cfg->crop_width == 0)) {
+        fprintf(stderr, "Error: resize requiere width/height, resolution o un recorte\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int configure_compress(const cJSON *params, TaskConfig *cfg) {
+    cfg->crf = json_int(params, "crf", 28);
+    cfg->bit_rate = (int64_t)json_int(params, "bitrate_kbps", 0) * 1000;
+
+    // Prefiltro: bajar contraste o ruido de luma abarata la codificacion con el mismo crf
+    cfg->brightness = json_int(params, "brightness", 0);
+    cfg->contrast = json_double(params, "contrast", 1.0);
+    if (cfg->brightness < -255 || cfg->brightness > 255 || !(cfg->contrast >= 0 && cfg->contrast <= 4)) {
+        fprintf(stderr, "Error: compress requiere brightness en [-255, 255] y contrast en [0, 4]\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int parse_time(const char *text, double *seconds) {
+    int64_t us;
+    if (av_parse_time(&us, text, 1) < 0 || us < 0) {
+        return 0;
+    }
+    *seconds = us / 1e6;
+    return 1;
+}
+
+// "HH:MM:SS[.ms]", "MM:SS" o segundos; devuelve -1 si el valor no es valido y 0 si falta
+static int json_time(const cJSON *params, const char *key, double *seconds) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(params, key);
+    if (cJSON_IsNumber(item)) {
+        *seconds = item->valuedouble;
+        return (*seconds >= 0) ? 1 : -1;
+    }
+    if (!cJSON_IsString(item) || !item->valuestring[0]) {
+        return 0;
+    }
+    return parse_time(item->valuestring, seconds) ? 1 : -1;
+}
+
+static int configure_cut(const cJSON *params, TaskConfig *cfg) {
+    cfg->cut = 1;
+    cfg->cut_start = 0;
+    cfg->cut_end = -1;
+
+    int has_start = json_time(params, "start_time", &cfg->cut_start);
+    int has_end = json_time(params, "end_time", &cfg->cut_end);
+    if (has_start < 0 || has_end < 0 || (!has_start && !has_end) ||
+        (has_end && cfg->cut_end <= cfg->cut_start)) {
+        fprintf(stderr, "Error: cut requiere start_time y/o end_time validos (end_time > start_time)\n");
+        return 0;
+    }
+
+    // Los GOPs interiores se copian con su codec original: webm no admite H.264/HEVC
+    const char *format = json_string(params, "output_format", "mp4");
+    if (strcmp(format, "webm") == 0) {
+        fprintf(stderr, "Error: cut no admite output_format webm\n");
+        return 0;
+    }
+    return set_output_format(cfg, format);
+}
+
+static int compare_times(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int add_frame_time(TaskConfig *cfg, double seconds) {
+    if (!(seconds >= 0) || cfg->num_frame_times == MAX_FRAME_TIMES) {
+        return 0;
+    }
+    cfg->frame_times[cfg->num_frame_times++] = seconds;
+    return 1;
+}
+
+static int add_frame_item(TaskConfig *cfg, const cJSON *item) {
+    double seconds;
+    if (cJSON_IsNumber(item)) {
+        return add_frame_time(cfg, item->valuedouble);
+    }
+    return cJSON_IsString(item) && parse_time(item->valuestring, &seconds) && add_frame_time(cfg, seconds);
+}
+
+// Lista de instantes: un array JSON o un string "1.5,00:01:10,90" del formulario
+static int json_time_list(const cJSON *params, const char *key, TaskConfig *cfg) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(params, key);
+    int ok = 1;
+    if (cJSON_IsArray(item)) {
+        const cJSON *element;
+        cJSON_ArrayForEach(element, item) {
+            ok = ok && add_frame_item(cfg, element);
+        }
+    } else if (cJSON_IsString(item)) {
+        char text[4096];
+        snprintf(text, sizeof(text), "%s", item->valuestring);
+        char *save = NULL;
+        for (char *token = strtok_r(text, ", ", &save); ok && token; token = strtok_r(NULL, ", ", &save)) {
+            double seconds;
+            ok = parse_time(token, &seconds) && add_frame_time(cfg, seconds);
+        }
+    } else if (item) {
+        ok = add_frame_item(cfg, item);
+    }
+    if (!ok) {
+        return -1;
+    }
+
+    qsort(cfg->frame_times, cfg->num_frame_times, sizeof(double), compare_times);
+    int unique = 0;
+    for (int i = 0; i < cfg->num_frame_times; i++) {
+        if (unique == 0 || cfg->frame_times[i] != cfg->frame_times[unique - 1]) {
+            cfg->frame_times[unique++] = cfg->frame_times[i];
+        }
+    }
+    cfg->num_frame_times = unique;
+    return unique > 0;
+}
+
+static int configure_extract_frames(const cJSON *params, TaskConfig *cfg) {
+    cfg->frames = 1;
+    snprintf(cfg->format, sizeof(cfg->format), "tar");
+    snprintf(cfg->extension, sizeof(cfg->extension), "tar");
+
+    cfg->frame_interval = json_double(params, "interval", 0);
+    int has_list = json_time_list(params, "frames", cfg);
+    if (has_list < 0 || cfg->frame_interval < 0 || (cfg->frame_interval > 0) == (has_list > 0)) {
+        fprintf(stderr, "Error: extract_frames requiere interval (segundos) o frames (hasta %d instantes), "
+                        "no ambos\n", MAX_FRAME_TIMES);
+        return 0;
+    }
+    if (json_time(params, "start_time", &cfg->frame_start) < 0) {
+        fprintf(stderr, "Error: extract_frames requiere un start_time valido\n");
+        return 0;
+    }
+
+    const char *image_format = json_string(params, "image_format", "jpg");
+    if (strcmp(image_format, "jpg") == 0 || strcmp(image_format, "jpeg") == 0) {
+        snprintf(cfg->codec, sizeof(cfg->codec), "mjpeg");
+        snprintf(cfg->image_extension, sizeof(cfg->image_extension), "jpg");
+    } else if (strcmp(image_format, "webp") == 0) {
+        snprintf(cfg->codec, sizeof(cfg->codec), "libwebp");
+        snprintf(cfg->image_extension, sizeof(cfg->image_extension), "webp");
+    } else {
+        fprintf(stderr, "Error: Formato de imagen no soportado: %s\n", image_format);
+        return 0;
+    }
+
+    // Miniaturas: con width o height la otra dimension sale proporcional
+    cfg->quality = json_int(params, "quality", 85);
+    cfg->width = json_int(params, "width", 0);
+    cfg->height = json_int(params, "height", 0);
+    if (cfg->quality < 1 || cfg->quality > 100 || cfg->width < 0 || cfg->height < 0) {
+        fprintf(stderr, "Error: extract_frames requiere quality en [1, 100] y width/height no negativos\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Para agregar una tarea basta con una entrada aqui
+static const struct {
+    const char *name;
+    TaskConfigure configure;
+} video_tasks[] = {
+    {"convert", configure_convert},
+    {"resize", configure_resize},
+    {"compress", configure_compress},
+    {"cut", configure_cut},
+    {"extract_frames", configure_extract_frames},
+};
+
+extern "C" int configure_video_task(const char *task, const char *params, TaskConfig *cfg) {
+    memset(cfg, 0, sizeof(TaskConfig));
+    snprintf(cfg->codec, sizeof(cfg->codec), "libx264");
+    snprintf(cfg->format, sizeof(cfg->format), "mp4");
+    snprintf(cfg->extension, sizeof(cfg->extension), "mp4");
+    cfg->crf = -1;
+    cfg->contrast = 1.0;
+
+    TaskConfigure configure = NULL;
+    for (size_t i = 0; i < sizeof(video_tasks) / sizeof(video_tasks[0]); i++) {
+        if (strcmp(task, video_tasks[i].name) == 0) {
+            configure = video_tasks[i].configure;
+        }
+    }
+    if (!configure) {
+        fprintf(stderr, "Error: Task desconocida: %s\n", task);
+        return 0;
+    }
+
+    cJSON *json = cJSON_Parse(params ? params : "{}");
+    if (!cJSON_IsObject(json)) {
+        fprintf(stderr, "Error: params no es un objeto JSON: %s\n", params);
+        cJSON_Delete(json);
+        return 0;
+    }
+
+    snprintf(cfg->preset, sizeof(cfg->preset), "%s", json_string(json, "preset", ""));
+    int ok = configure(json, cfg);
+    cJSON_Delete(json);
+    return ok;
+}
+
+static int64_t seconds_to_ts(const GopIndex *index, double seconds) {
+    return llrint(seconds * index->time_base_den / index->time_base_num);
+}
+
+/*
+ * Origen de tiempo del segmento: el dts del keyframe de su primer GOP. Ningun
+ * frame del GOP se presenta antes. El primer segmento arranca en 0 (o antes,
+ * si hay dts negativos por edit lists) para conservar el audio inicial; en un
+ * cut arranca en start_time.
+ */
+static int64_t segment_origin(const GopIndex *index, int first_gop, const TaskConfig *cfg) {
+    int64_t ts = index->gops[first_gop].timestamp;
+    if (first_gop == 0 && cfg->cut) {
+        return seconds_to_ts(index, cfg->cut_start);
+    }
+    return (first_gop == 0 && ts > 0) ? 0 : ts;
+}
+
+// Encoder compatible con el stream de entrada, para mezclar GOPs recodificados y copiados
+static const char *matching_encoder(enum AVCodecID codec_id) {
+    switch (codec_id) {
+    case AV_CODEC_ID_H264:
+        return "libx264";
+    case AV_CODEC_ID_HEVC:
+        return "libx265";
+    default:
+        return NULL;
+    }
+}
+
+static const char *annexb_filter(enum AVCodecID codec_id) {
+    return (codec_id == AV_CODEC_ID_H264) ? "h264_mp4toannexb" : "hevc_mp4toannexb";
+}
+
+// En un cut solo se copia un GOP entero dentro de la ventana
+static int gop_is_copied(const GopIndex *index, int gop, const TaskConfig *cfg) {
+    double end = (gop + 1 < index->num_gops) ? index->gops[gop + 1].start_time : index->end_time;
+    return cfg->cut && index->gops[gop].start_time >= cfg->cut_start &&
+           (cfg->cut_end < 0 || end <= cfg->cut_end);
+}
+
+// Los frames decodificados salen de pool en lugar del allocator de libavcodec
+static AVCodecContext *open_decoder(const AVStream *st, FramePool *pool) {
+    const AVCodec *codec = avcodec_find_decoder(st->codecpar->codec_id);
+    AVCodecContext *dec = codec ? avcodec_alloc_context3(codec) : NULL;
+    if (!dec || avcodec_parameters_to_context(dec, st->codecpar) < 0) {
+        avcodec_free_context(&dec);
+        return NULL;
+    }
+    if (pool && (codec->capabilities & AV_CODEC_CAP_DR1)) {
+        dec->opaque = pool;
+        dec->get_buffer2 = frame_pool_get_buffer2;
+    }
+    if (avcodec_open2(dec, codec, NULL) < 0) {
+        avcodec_free_context(&dec);
+        return NULL;
+    }
+    dec->pkt_timebase = st->time_base;
+    return dec;
+}
+
+// Tamano de salida para una entrada de in_w x in_h; 4:2:0 necesita dimensiones pares
+static void output_size(const TaskConfig *cfg, int in_w, int in_h, int *width, int *height) {
+    int w = cfg->width;
+    int h = cfg->height;
+    if (w == 0 && h == 0) {
+        w = in_w;
+        h = in_h;
+    } else if (w == 0) {
+        w = (int)((int64_t)in_w * h / in_h);
+    } else if (h == 0) {
+        h = (int)((int64_t)in_h * w / in_w);
+    }
+    *width = w & ~1;
+    *height = h & ~1;
+}
+
+/*
+ * Con match_input el encoder reproduce codec, tamano y formato de pixel de la
+ * entrada, y deja los parameter sets dentro del bitstream: los GOPs
+ * recodificados conviven asi con los copiados en el mismo stream.
+ */
+static AVCodecContext *open_encoder(const TaskConfig *cfg, AVFormatContext *fmt, AVStream *st,
+                                    int global_header, int match_input, int threads) {
+    const char *name = match_input ? matching_encoder(st->codecpar->codec_id) : cfg->codec;
+    const AVCodec *codec = avcodec_find_encoder_by_name(name);
+    if (!codec) {
+        fprintf(stderr, "Error: Encoder no disponible: %s\n", name);
+        return NULL;
+    }
+    AVCodecContext *enc = avcodec_alloc_context3(codec);
+    if (!enc) {
+        return NULL;
+    }
+
+    int in_w = st->codecpar->width;
+    int in_h = st->codecpar->height;
+    if (cfg->crop_width > 0) {
+        if (cfg->crop_x + cfg->crop_width > in_w || cfg->crop_y + cfg->crop_height > in_h) {
+            fprintf(stderr, "Error: El recorte %dx%d+%d+%d no cabe en el video (%dx%d)\n",
+                    cfg->crop_width, cfg->crop_height, cfg->crop_x, cfg->crop_y, in_w, in_h);
+            avcodec_free_context(&enc);
+            return NULL;
+        }
+        in_w = cfg->crop_width;
+        in_h = cfg->crop_height;
+    }
+    output_size(cfg, in_w, in_h, &enc->width, &enc->height);
+    enc->pix_fmt = match_input ? (AVPixelFormat)st->codecpar->format : AV_PIX_FMT_YUV420P;
+    enc->sample_aspect_ratio = st->codecpar->sample_aspect_ratio;
+    enc->time_base = st->time_base;
+    enc->framerate = av_guess_frame_rate(fmt, st, NULL);
+    // Sin B-frames dts == pts y los segmentos se concatenan sin reordenar timestamps
+    enc->max_b_frames = 0;
+    if (cfg->bit_rate > 0) {
+        enc->bit_rate = cfg->bit_rate;
+    }
+    if (cfg->crf >= 0) {
+        av_opt_set_int(enc->priv_data, "crf", cfg->crf, 0);
+    }
+    if (cfg->preset[0]) {
+        av_opt_set(enc->priv_data, "preset", cfg->preset, 0);
+    }
+    if (global_header && !match_input) {
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    enc->thread_count = threads;
+
+    if (avcodec_open2(enc, codec, NULL) < 0) {
+        fprintf(stderr, "Error: No se pudo abrir el encoder %s (%dx%d)\n", name, enc->width, enc->height);
+        avcodec_free_context(&enc);
+        return NULL;
+    }
+    return enc;
+}
+
+static int write_packet(SegmentWriter *w, AVPacket *pkt) {
+    pthread_mutex_lock(&w->mux);
+    int ok = av_interleaved_write_frame(w->out, pkt) >= 0;
+    pthread_mutex_unlock(&w->mux);
+    return ok;
+}
+
+static int write_encoded(SegmentWriter *w) {
+    while (avcodec_receive_packet(w->enc, w->out_pkt) == 0) {
+        // Sin B-frames cualquier dts <= pts sirve: se alinea con el de los GOPs copiados
+        if (w->bsf && w->out_pkt->pts != AV_NOPTS_VALUE) {
+            w->out_pkt->dts = w->out_pkt->pts - w->reorder_delay;
+        }
+        av_packet_rescale_ts(w->out_pkt, w->enc->time_base, w->video_out->time_base);
+        w->out_pkt->stream_index = w->video_out->index;
+        if (!write_packet(w, w->out_pkt)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static Yuv420Planes frame_planes(const AVFrame *frame) {
+    Yuv420Planes planes;
+    for (int p = 0; p < 3; p++) {
+        planes.data[p] = frame->data[p];
+        planes.linesize[p] = frame->linesize[p];
+    }
+    planes.width = frame->width;
+    planes.height = frame->height;
+    return planes;
+}
+
+/*
+ * Lleva el frame decodificado al formato y tamano del encoder, con el recorte
+ * y el prefiltro de la tarea. YUV420P de 8 bits se queda en sus planos y pasa
+ * por los kernels SIMD; el resto (10 bits, 4:2:2, reducciones de mas de 2x
+ * donde el bilineal produce aliasing) va por libswscale. El resultado se
+ * escribe en processed (vacio) con un buffer del pool de frames procesados.
+ * Corre en el thread de decode o en un worker del pipeline.
+ */
+static int prepare_frame(SegmentWriter *w, FrameProcessor *proc, AVFrame *frame, AVFrame *processed,
+                         AVFrame **out) {
+    const TaskConfig *cfg = w->cfg;
+    int crop = cfg->crop_width > 0;
+    int src_w = crop ? cfg->crop_width : frame->width;
+    int src_h = crop ? cfg->crop_height : frame->height;
+    int convert = crop || frame->format != w->enc->pix_fmt || src_w != w->enc->width || src_h != w->enc->height;
+    // El encoder siempre es YUV420P cuando hay prefiltro: solo compress lo usa
+    int adjust = (cfg->brightness != 0 || cfg->contrast != 1.0) && w->enc->pix_fmt == AV_PIX_FMT_YUV420P;
+
+    *out = frame;
+    if (!convert && !adjust) {
+        return 1;
+    }
+
+    processed->format = w->enc->pix_fmt;
+    processed->width = w->enc->width;
+    processed->height = w->enc->height;
+    processed->pts = frame->pts;
+    if (!frame_pool_get(w->processed_pool, processed)) {
+        return 0;
+    }
+    Yuv420Planes dst = frame_planes(processed);
+
+    if (!convert) {
+        // El decoder puede seguir usando el frame como referencia: el prefiltro escribe aparte
+        Yuv420Planes src = frame_planes(frame);
+        yuv420_adjust(&src, &dst, cfg->brightness, cfg->contrast);
+    } else if (frame->format == AV_PIX_FMT_YUV420P && w->enc->pix_fmt == AV_PIX_FMT_YUV420P &&
+               2 * w->enc->width >= src_w && 2 * w->enc->height >= src_h) {
+        Yuv420Planes decoded = frame_planes(frame);
+        Yuv420Planes src = decoded;
+        if (crop) {
+            yuv420_crop(&decoded, cfg->crop_x, cfg->crop_y, src_w, src_h, &src);
+        }
+        if (!proc->scaler && !(proc->scaler = yuv420_scaler_alloc(src_w, src_h, dst.width, dst.height))) {
+            return 0;
+        }
+        if (!yuv420_scaler_matches(proc->scaler, &src, &dst)) {
+            fprintf(stderr, "Error: El tamano del video cambio a mitad del segmento\n");
+            return 0;
+        }
+        yuv420_scaler_run(proc->scaler, &src, &dst);
+    } else {
+        if (crop) {
+            frame->crop_left = cfg->crop_x;
+            frame->crop_top = cfg->crop_y;
+            frame->crop_right = frame->width - cfg->crop_x - src_w;
+            frame->crop_bottom = frame->height - cfg->crop_y - src_h;
+            if (av_frame_apply_cropping(frame, AV_FRAME_CROP_UNALIGNED) < 0) {
+                return 0;
+            }
+        }
+        if (!proc->sws) {
+            proc->sws = sws_getContext(frame->width, frame->height, (AVPixelFormat)frame->format,
+                                       w->enc->width, w->enc->height, w->enc->pix_fmt,
+                                       SWS_BICUBIC, NULL, NULL, NULL);
+            if (!proc->sws) {
+                return 0;
+            }
+        }
+        sws_scale(proc->sws, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height,
+                  processed->data, processed->linesize);
+    }
+
+    if (convert && adjust) {
+        yuv420_adjust(&dst, &dst, cfg->brightness, cfg->contrast);
+    }
+    *out = processed;
+    return 1;
+}
+
+static int send_to_encoder(SegmentWriter *w, AVFrame *frame) {
+    frame->pict_type = AV_PICTURE_TYPE_NONE;
+    if (avcodec_send_frame(w->enc, frame) < 0) {
+        return 0;
+    }
+    w->frames++;
+    return write_encoded(w);
+}
+
+static int pipeline_process(void *opaque, int worker, AVFrame *decoded, AVFrame *processed, AVFrame **out) {
+    SegmentWriter *w = (SegmentWriter *)opaque;
+    return prepare_frame(w, &w->processors[worker], decoded, processed, out);
+}
+
+static int pipeline_consume(void *opaque, AVFrame *frame) {
+    return send_to_encoder((SegmentWriter *)opaque, frame);
+}
+
+static int encode_frame(SegmentWriter *w, AVFrame *frame) {
+    int64_t pts = (frame->best_effort_timestamp != AV_NOPTS_VALUE) ? frame->best_effort_timestamp : frame->pts;
+
+    // Frames de un GOP abierto que dependen del GOP anterior: los codifica el rank previo,
+    // que sigue decodificando despues de su ultimo GOP hasta cubrirlos
+    if (w->first_key_pts == AV_NOPTS_VALUE) {
+        if (!(frame->flags & AV_FRAME_FLAG_KEY)) {
+            return 1;
+        }
+        w->first_key_pts = pts;
+    } else if (pts < w->first_key_pts) {
+        return 1;
+    }
+    if (pts < w->window_start || pts >= w->window_end) {
+        return 1;
+    }
+
+    // Con GOPs copiados el encoder se abre en cada tramo recodificado
+    if (!w->enc && !(w->enc = open_encoder(w->cfg, w->in, w->in_video, 0, 1, w->encoder_threads))) {
+        return 0;
+    }
+
+    frame->pts = pts - w->origin;
+    if (w->pipeline) {
+        return frame_pipeline_push(w->pipeline, frame);
+    }
+
+    // El AVFrame se reusa; el encoder tiene su propia referencia al buffer anterior
+    FrameProcessor *proc = &w->processors[0];
+    AVFrame *in = frame;
+    av_frame_unref(proc->processed);
+    return prepare_frame(w, proc, frame, proc->processed, &in) && send_to_encoder(w, in);
+}
+
+static int decode_packet(SegmentWriter *w, const AVPacket *pkt, AVFrame *frame) {
+    if (avcodec_send_packet(w->dec, pkt) < 0) {
+        return 0;
+    }
+    while (avcodec_receive_frame(w->dec, frame) == 0) {
+        int ok = encode_frame(w, frame);
+        av_frame_unref(frame);
+        if (!ok) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Cierra un tramo recodificado: lo pendiente en decoder y encoder va antes del siguiente GOP copiado
+static int finish_encoding(SegmentWriter *w, AVFrame *frame) {
+    if (!decode_packet(w, NULL, frame)) {
+        return 0;
+    }
+    avcodec_flush_buffers(w->dec);
+    // Los frames todavia en el pipeline van al encoder antes del flush
+    int ok = frame_pipeline_finish(&w->pipeline);
+    ok = ok && (!w->enc || (avcodec_send_frame(w->enc, NULL) >= 0 && write_encoded(w)));
+    avcodec_free_context(&w->enc);
+    return ok;
+}
+
+static int copy_video_packet(SegmentWriter *w, AVPacket *pkt) {
+    if (pkt->pts != AV_NOPTS_VALUE) {
+        pkt->pts -= w->origin;
+    }
+    if (pkt->dts != AV_NOPTS_VALUE) {
+        pkt->dts -= w->origin;
+    }
+    if (av_bsf_send_packet(w->bsf, pkt) < 0) {
+        return 0;
+    }
+    while (av_bsf_receive_packet(w->bsf, pkt) == 0) {
+        av_packet_rescale_ts(pkt, w->in_tb, w->video_out->time_base);
+        pkt->stream_index = w->video_out->index;
+        pkt->pos = -1;
+        w->copied++;
+        if (!write_packet(w, pkt)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int copy_audio_packet(SegmentWriter *w, AVPacket *pkt) {
+    int64_t shift = av_rescale_q(w->origin, w->in_tb, w->audio_tb);
+    if (pkt->pts != AV_NOPTS_VALUE) {
+        pkt->pts -= shift;
+    }
+    if (pkt->dts != AV_NOPTS_VALUE) {
+        pkt->dts -= shift;
+    }
+    av_packet_rescale_ts(pkt, w->audio_tb, w->audio_out->time_base);
+    pkt->stream_index = w->audio_out->index;
+    pkt->pos = -1;
+    return write_packet(w, pkt);
+}
+
+static int open_segment_output(SegmentWriter *w, AVFormatContext *fmt, const GopIndex *index,
+                               const TaskConfig *cfg, const char *segment_file) {
+    if (avformat_alloc_output_context2(&w->out, NULL, cfg->format, segment_file) < 0) {
+        return 0;
+    }
+
+    AVStream *in_video = fmt->streams[index->stream_index];
+    const AVBitStreamFilter *filter = NULL;
+    if (cfg->cut && matching_encoder(in_video->codecpar->codec_id)) {
+        filter = av_bsf_get_by_name(annexb_filter(in_video->codecpar->codec_id));
+    }
+
+    if (filter) {
+        // Los GOPs copiados pasan a Annex B con los parameter sets de la entrada en cada
+        // keyframe; los tramos recodificados traen los suyos, asi cada GOP se decodifica solo
+        if (av_bsf_alloc(filter, &w->bsf) < 0 ||
+            avcodec_parameters_copy(w->bsf->par_in, in_video->codecpar) < 0) {
+            return 0;
+        }
+        w->bsf->time_base_in = in_video->time_base;
+        w->video_out = (av_bsf_init(w->bsf) >= 0) ? avformat_new_stream(w->out, NULL) : NULL;
+        if (!w->video_out || avcodec_parameters_copy(w->video_out->codecpar, w->bsf->par_out) < 0) {
+            return 0;
+        }
+        w->video_out->codecpar->codec_tag = 0;
+        w->video_out->time_base = in_video->time_base;
+    } else {
+        w->enc = open_encoder(cfg, fmt, in_video, (w->out->oformat->flags & AVFMT_GLOBALHEADER) != 0, 0,
+                              w->encoder_threads);
+        w->video_out = w->enc ? avformat_new_stream(w->out, NULL) : NULL;
+        if (!w->video_out || avcodec_parameters_from_context(w->video_out->codecpar, w->enc) < 0) {
+            return 0;
+        }
+        w->video_out->time_base = w->enc->time_base;
+    }
+
+    // El audio se copia tal cual si el contenedor de salida lo admite
+    if (index->audio_stream_index >= 0) {
+        AVStream *in_audio = fmt->streams[index->audio_stream_index];
+        if (avformat_query_codec(w->out->oformat, in_audio->codecpar->codec_id, FF_COMPLIANCE_NORMAL) == 1) {
+            w->audio_out = avformat_new_stream(w->out, NULL);
+            if (!w->audio_out || avcodec_parameters_copy(w->audio_out->codecpar, in_audio->codecpar) < 0) {
+                return 0;
+            }
+            w->audio_out->codecpar->codec_tag = 0;
+            w->audio_out->time_base = in_audio->time_base;
+            w->audio_tb = in_audio->time_base;
+        } else {
+            fprintf(stderr, "Aviso: %s no admite el audio de entrada, se descarta\n", cfg->format);
+        }
+    }
+
+    if (avio_open(&w->out->pb, segment_file, AVIO_FLAG_WRITE) < 0) {
+        fprintf(stderr, "Error: No se pudo crear el segmento %s\n", segment_file);
+        return 0;
+    }
+    return avformat_write_header(w->out, NULL) >= 0;
+}
+
+static void close_segment_writer(SegmentWriter *w) {
+    // Tras un error el pipeline sigue vivo: sus threads usan el encoder y el muxer
+    frame_pipeline_finish(&w->pipeline);
+    if (w->out) {
+        if (w->out->pb) {
+            avio_closep(&w->out->pb);
+        }
+        avformat_free_context(w->out);
+    }
+    avcodec_free_context(&w->dec);
+    avcodec_free_context(&w->enc);
+    av_bsf_free(&w->bsf);
+    for (int i = 0; i < w->num_processors; i++) {
+        sws_freeContext(w->processors[i].sws);
+        yuv420_scaler_free(&w->processors[i].scaler);
+        av_frame_free(&w->processors[i].processed);
+    }
+    free(w->processors);
+    frame_pool_free(&w->decoded_pool);
+    frame_pool_free(&w->processed_pool);
+    av_packet_free(&w->out_pkt);
+    pthread_mutex_destroy(&w->mux);
+}
+
+/*
+ * Reparte los threads del rank. Sin cut: un thread decodifica, threads / 4
+ * workers escalan y filtran, y el resto va a los threads internos del encoder,
+ * que es la etapa mas cara. En un cut el encoder se reabre en cada tramo y
+ * todo corre secuencial; el encoder se queda con todos los threads.
+ */
+static int plan_threads(SegmentWriter *w, int threads, int *window) {
+    int copies_gops = w->cfg->cut && matching_encoder(w->in_video->codecpar->codec_id);
+    int workers = (!copies_gops && threads >= PIPELINE_MIN_THREADS) ? FFMAX(1, threads / 4) : 0;
+    *window = workers ? 2 * workers + 4 : 0;
+    w->encoder_threads = workers ? FFMAX(1, threads - workers - 1) : FFMAX(1, threads);
+    w->processors = (FrameProcessor *)calloc(FFMAX(1, workers), sizeof(FrameProcessor));
+    if (!w->processors) {
+        return -1;
+    }
+    w->num_processors = FFMAX(1, workers);
+    return (w->processors[0].processed = av_frame_alloc()) ? workers : -1;
+}
+
+extern "C" int encode_segment(AVFormatContext *fmt, const GopIndex *index, int first_gop, int end_gop,
+                              const TaskConfig *cfg, const char *segment_file, int rank,
+                              const SegmentRuntime *runtime) {
+    SegmentWriter w;
+    memset(&w, 0, sizeof(w));
+    pthread_mutex_init(&w.mux, NULL);
+    w.in = fmt;
+    w.in_video = fmt->streams[index->stream_index];
+    w.cfg = cfg;
+    w.in_tb = w.in_video->time_base;
+    w.origin = segment_origin(index, first_gop, cfg);
+    w.first_key_pts = AV_NOPTS_VALUE;
+    w.window_start = cfg->cut ? seconds_to_ts(index, cfg->cut_start) : INT64_MIN;
+    w.window_end = (cfg->cut && cfg->cut_end >= 0) ? seconds_to_ts(index, cfg->cut_end) : INT64_MAX;
+    w.out_pkt = av_packet_alloc();
+    int window;
+    int workers = plan_threads(&w, runtime->threads, &window);
+    w.decoded_pool = frame_pool_create("decodificados", DECODED_POOL_FRAMES + window);
+    w.processed_pool = frame_pool_create("procesados", PROCESSED_POOL_FRAMES + window);
+    w.dec = w.decoded_pool && w.processed_pool ? open_decoder(fmt->streams[index->stream_index], w.decoded_pool) : NULL;
+
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int ok = pkt && frame && w.out_pkt && workers >= 0 && w.dec &&
+             open_segment_output(&w, fmt, index, cfg, segment_file);
+    if (!ok) {
+        fprintf(stderr, "[Rank %d] Error: No se pudo preparar el segmento %s\n", rank, segment_file);
+    }
+    if (ok && workers > 0) {
+        w.pipeline = frame_pipeline_start(workers, window, pipeline_process, pipeline_consume, &w);
+        if (w.pipeline) {
+            printf("[MPI Rank %d] Pipeline: 1 thread de decode, %d workers, encoder con %d threads, ventana de %d frames\n",
+                   rank, workers, w.encoder_threads, window);
+        } else {
+            // El camino secuencial siempre funciona: solo se pierde el solapamiento
+            fprintf(stderr, "[Rank %d] Aviso: Sin pipeline, el segmento se procesa en un solo thread\n", rank);
+        }
+        fflush(stdout);
+    }
+
+    // El video termina en el keyframe del siguiente rank; el audio, en su instante de inicio
+    int64_t video_end = (end_gop < index->num_gops) ? index->gops[end_gop].timestamp : INT64_MAX;
+    // Pts de ese keyframe si su GOP es abierto: hasta ahi se siguen decodificando paquetes
+    int64_t open_end = AV_NOPTS_VALUE;
+    double audio_start = (first_gop > 0) ? index->gops[first_gop].start_time : cfg->cut ? cfg->cut_start : -1e300;
+    double audio_end = (end_gop < index->num_gops) ? index->gops[end_gop].start_time
+                       : (cfg->cut && cfg->cut_end >= 0) ? cfg->cut_end : 1e300;
+    int video_done = 0;
+    int audio_done = (w.audio_out == NULL);
+    int delay_known = 0;
+    int encoding = 0;
+    int gop = first_gop;
+
+    while (ok && !(video_done && audio_done) && av_read_frame(fmt, pkt) >= 0) {
+        if (pkt->stream_index == index->stream_index && !video_done) {
+            int64_t ts = (pkt->dts != AV_NOPTS_VALUE) ? pkt->dts : pkt->pts;
+            if (!delay_known && pkt->pts != AV_NOPTS_VALUE && pkt->dts != AV_NOPTS_VALUE) {
+                w.reorder_delay = pkt->pts - pkt->dts;
+                delay_known = 1;
+            }
+            while (ts != AV_NOPTS_VALUE && gop + 1 < end_gop && ts >= index->gops[gop + 1].timestamp) {
+                gop++;
+            }
+
+            if (open_end != AV_NOPTS_VALUE) {
+                // Con dts >= open_end ya no puede venir un frame con pts anterior al keyframe
+                if (ts != AV_NOPTS_VALUE && ts < open_end) {
+                    ok = decode_packet(&w, pkt, frame);
+                } else {
+                    video_done = 1;
+                }
+            } else if (ts != AV_NOPTS_VALUE && ts >= video_end) {
+                /*
+                 * Los B-frames iniciales de un GOP abierto vienen despues del keyframe en orden
+                 * de decode pero tienen pts anterior, y el rank siguiente los descarta porque
+                 * referencian este GOP. Si el keyframe tiene pts > dts puede haberlos: se
+                 * decodifica hasta cubrirlos y solo se codifican los frames anteriores a el.
+                 * Sus bytes estan en el rango del rank: gop_span llega hasta el lead_end del GOP.
+                 */
+                if (encoding && (pkt->flags & AV_PKT_FLAG_KEY) && pkt->pts != AV_NOPTS_VALUE && pkt->pts > ts) {
+                    open_end = pkt->pts;
+                    w.window_end = FFMIN(w.window_end, open_end);
+                    ok = decode_packet(&w, pkt, frame);
+                } else {
+                    video_done = 1;
+                }
+            } else if (w.bsf && gop_is_copied(index, gop, cfg)) {
+                ok = (!encoding || finish_encoding(&w, frame)) && copy_video_packet(&w, pkt);
+                encoding = 0;
+            } else {
+                ok = decode_packet(&w, pkt, frame);
+                encoding = 1;
+            }
+        } else if (w.audio_out && pkt->stream_index == index->audio_stream_index && !audio_done) {
+            int64_t ts = (pkt->pts != AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+            double t = ts * av_q2d(w.audio_tb);
+            if (t >= audio_end) {
+                audio_done = 1;
+            } else if (t >= audio_start) {
+                ok = copy_audio_packet(&w, pkt);
+            }
+        }
+        av_packet_unref(pkt);
+        if (runtime->poll) {
+            runtime->poll(runtime->poll_opaque);
+        }
+    }
+
+    // Vaciar decoder y encoder
+    ok = ok && finish_encoding(&w, frame) && av_write_trailer(w.out) >= 0;
+
+    if (runtime->stats) {
+        runtime->stats->frames += w.frames;
+    }
+    if (ok) {
+        printf("[MPI Rank %d] Segmento %s: %d frames codificados, %d paquetes copiados\n",
+               rank, segment_file, w.frames, w.copied);
+        fflush(stdout);
+    } else {
+        fprintf(stderr, "[Rank %d] Error al codificar el segmento %s\n", rank, segment_file);
+    }
+    if (w.decoded_pool && w.processed_pool) {
+        frame_pool_report(w.decoded_pool, rank);
+        frame_pool_report(w.processed_pool, rank);
+    }
+
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    close_segment_writer(&w);
+    return ok;
+}
+
+static int find_stream(AVFormatContext *fmt, enum AVMediaType type) {
+    return av_find_best_stream(fmt, type, -1, -1, NULL, 0);
+}
+
+extern "C" int concat_segments(const GopIndex *index, const char *const *segment_files, const int *first_gops,
+                               int num_segments, const TaskConfig *cfg, const char *output_file) {
+    AVRational in_tb = {index->time_base_num, index->time_base_den};
+    int64_t origin0 = segment_origin(index, 0, cfg);
+    AVFormatContext *out = NULL;
+    AVStream *out_streams[2] = {NULL, NULL};  // video, audio
+    int64_t last_dts[2] = {AV_NOPTS_VALUE, AV_NOPTS_VALUE};
+    AVPacket *pkt = av_packet_alloc();
+    int ok = (pkt != NULL);
+    int segments = 0;
+
+    for (int i = 0; i < num_segments && ok; i++) {
+        if (!segment_files[i]) {
+            continue;
+        }
+
+        int64_t offset_us = av_rescale_q(segment_origin(index, first_gops[i], cfg) - origin0, in_tb, AV_TIME_BASE_Q);
+
+        AVFormatContext *in = NULL;
+        if (avformat_open_input(&in, segment_files[i], NULL, NULL) < 0 ||
+            avformat_find_stream_info(in, NULL) < 0) {
+            fprintf(stderr, "Error: No se pudo abrir el segmento %s\n", segment_files[i]);
+            avformat_close_input(&in);
+            ok = 0;
+            break;
+        }
+        int in_index[2] = {find_stream(in, AVMEDIA_TYPE_VIDEO), find_stream(in, AVMEDIA_TYPE_AUDIO)};
+
+        // Los streams de salida se copian del primer segmento; todos usan la misma configuracion
+        if (!out) {
+            ok = avformat_alloc_output_context2(&out, NULL, cfg->format, output_file) >= 0;
+            for (int s = 0; s < 2 && ok; s++) {
+                if (in_index[s] < 0) {
+                    continue;
+                }
+                out_streams[s] = avformat_new_stream(out, NULL);
+                ok = out_streams[s] &&
+                     avcodec_parameters_copy(out_streams[s]->codecpar, in->streams[in_index[s]]->codecpar) >= 0;
+                if (ok) {
+                    out_streams[s]->codecpar->codec_tag = 0;
+                    out_streams[s]->time_base = in->streams[in_index[s]]->time_base;
+                }
+            }
+            ok = ok && avio_open(&out->pb, output_file, AVIO_FLAG_WRITE) >= 0 &&
+                 avformat_write_header(out, NULL) >= 0;
+            if (!ok) {
+                fprintf(stderr, "Error: No se pudo crear la salida %s\n", output_file);
+            }
+        }
+
+        while (ok && av_read_frame(in, pkt) >= 0) {
+            int s = (pkt->stream_index == in_index[0]) ? 0 : (pkt->stream_index == in_index[1]) ? 1 : -1;
+            if (s < 0 || !out_streams[s]) {
+                av_packet_unref(pkt);
+                continue;
+            }
+
+            AVStream *in_st = in->streams[pkt->stream_index];
+            int64_t offset = av_rescale_q(offset_us, AV_TIME_BASE_Q, in_st->time_base);
+            if (pkt->pts != AV_NOPTS_VALUE) {
+                pkt->pts += offset;
+            }
+            if (pkt->dts != AV_NOPTS_VALUE) {
+                pkt->dts += offset;
+            }
+            av_packet_rescale_ts(pkt, in_st->time_base, out_streams[s]->time_base);
+
+            // El redondeo entre time_bases no puede hacer retroceder el dts en el borde de segmentos
+            if (pkt->dts != AV_NOPTS_VALUE && last_dts[s] != AV_NOPTS_VALUE && pkt->dts <= last_dts[s]) {
+                pkt->dts = last_dts[s] + 1;
+                if (pkt->pts != AV_NOPTS_VALUE && pkt->pts < pkt->dts) {
+                    pkt->pts = pkt->dts;
+                }
+            }
+            if (pkt->dts != AV_NOPTS_VALUE) {
+                last_dts[s] = pkt->dts;
+            }
+
+            pkt->stream_index = out_streams[s]->index;
+            pkt->pos = -1;
+            ok = av_interleaved_write_frame(out, pkt) >= 0;
+            av_packet_unref(pkt);
+        }
+
+        avformat_close_input(&in);
+        segments++;
+    }
+
+    if (ok && out) {
+        ok = av_write_trailer(out) >= 0;
+    } else if (!out) {
+        fprintf(stderr, "Error: No hay segmentos para concatenar\n");
+        ok = 0;
+    }
+
+    if (out) {
+        if (out->pb) {
+            avio_closep(&out->pb);
+        }
+        avformat_free_context(out);
+    }
+    av_packet_free(&pkt);
+
+    if (ok) {
+        printf("Salida final %s: %d segmentos concatenados sin recodificar\n", output_file, segments);
+        fflush(stdout);
+    }
+    return ok;
+}
+
+/*
+ * extract_frames. Cada rank escribe sus imagenes como miembros de un tar
+ * (ustar) sin los bloques de cierre: el rank 0 los concatena en orden y
+ * cierra el archivo, igual que concat_segments con los segmentos de video.
+ */
+#define TAR_BLOCK 512
+#define ARCHIVE_COPY_SIZE (1024 * 1024)
+
+// Estado de un worker: encoder, escalado e imagen no se comparten entre threads
+typedef struct {
+    AVCodecContext *enc;  // se abre con el primer frame: el tamano sale del decodificado
+    SwsContext *sws;
+    AVFrame *image;
+    AVPacket *pkt;
+} ImageEncoder;
+
+typedef struct {
+    const TaskConfig *cfg;
+    const double *times;     // instantes de captura de todo el job
+    AVCodecContext *dec;
+    AVRational tb;
+    ImageEncoder *encoders;  // uno por worker del pipeline; el [0] en el camino secuencial
+    int num_encoders;
+    FramePipeline *pipeline;  // NULL: decode y encode en el mismo thread
+    AVFrame *held;   // ultimo frame decodificado del GOP: el que se ve hasta el siguiente
+    AVFrame *copy;   // referencia que se entrega al pipeline
+    int next;        // proximo instante a capturar
+    int end;         // fin de los instantes del GOP actual
+    int key_seen;
+    int64_t key_pts;
+    FILE *archive;
+    time_t mtime;
+    int decoded;
+    int images;
+    int64_t bytes;
+} FrameExtractor;
+
+extern "C" int frame_targets(const TaskConfig *cfg, const GopIndex *index, double **times) {
+    int count = 0;
+    *times = NULL;
+    if (cfg->frame_interval > 0) {
+        if (index->end_time - cfg->frame_start > cfg->frame_interval * MAX_EXTRACTED_FRAMES) {
+            count = MAX_EXTRACTED_FRAMES + 1;
+        }
+        while (count <= MAX_EXTRACTED_FRAMES && cfg->frame_start + count * cfg->frame_interval < index->end_time) {
+            count++;
+        }
+    } else {
+        while (count < cfg->num_frame_times && cfg->frame_times[count] < index->end_time) {
+            count++;
+        }
+    }
+    if (count > MAX_EXTRACTED_FRAMES) {
+        fprintf(stderr, "Error: extract_frames pide mas de %d capturas\n", MAX_EXTRACTED_FRAMES);
+        return -1;
+    }
+
+    *times = (double *)malloc(FFMAX(1, count) * sizeof(double));
+    if (!*times) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        (*times)[i] = (cfg->frame_interval > 0) ? cfg->frame_start + i * cfg->frame_interval : cfg->frame_times[i];
+    }
+    return count;
+}
+
+static void tar_octal(char *field, int size, int64_t value) {
+    snprintf(field, size, "%0*llo", size - 1, (unsigned long long)value);
+}
+
+// Cabecera ustar, la imagen y el relleno hasta el bloque
+static int write_archive_member(FrameExtractor *x, int target, const uint8_t *data, int size) {
+    static const char zeros[TAR_BLOCK] = {0};
+    char header[TAR_BLOCK];
+    memset(header, 0, sizeof(header));
+    snprintf(header, 100, "frame_%05d_%.3fs.%s", target, x->times[target], x->cfg->image_extension);
+    tar_octal(header + 100, 8, 0644);
+    tar_octal(header + 108, 8, 0);
+    tar_octal(header + 116, 8, 0);
+    tar_octal(header + 124, 12, size);
+    tar_octal(header + 136, 12, x->mtime);
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    // El checksum se calcula con su propio campo en blancos
+    memset(header + 148, ' ', 8);
+    unsigned int sum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++) {
+        sum += (unsigned char)header[i];
+    }
+    snprintf(header + 148, 8, "%06o", sum);
+
+    size_t pad = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+    if (fwrite(header, 1, TAR_BLOCK, x->archive) != TAR_BLOCK ||
+        fwrite(data, 1, size, x->archive) != (size_t)size || fwrite(zeros, 1, pad, x->archive) != pad) {
+        return 0;
+    }
+    x->images++;
+    x->bytes += size;
+    return 1;
+}
+
+static AVCodecContext *open_image_encoder(const TaskConfig *cfg, int in_w, int in_h) {
+    const AVCodec *codec = avcodec_find_encoder_by_name(cfg->codec);
+    if (!codec) {
+        fprintf(stderr, "Error: Encoder no disponible: %s\n", cfg->codec);
+        return NULL;
+    }
+    AVCodecContext *enc = avcodec_alloc_context3(codec);
+    if (!enc) {
+        return NULL;
+    }
+
+    output_size(cfg, in_w, in_h, &enc->width, &enc->height);
+    // JPEG va en rango completo: libswscale expande la luma al convertir a YUVJ420P
+    enc->pix_fmt = (codec->id == AV_CODEC_ID_MJPEG) ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_YUV420P;
+    enc->time_base = av_make_q(1, 25);
+    enc->thread_count = 1;
+    if (codec->id == AV_CODEC_ID_MJPEG) {
+        // quality 100 -> qscale 2, quality 1 -> qscale 31
+        enc->flags |= AV_CODEC_FLAG_QSCALE;
+        enc->global_quality = FF_QP2LAMBDA * (2 + (100 - cfg->quality) * 29 / 99);
+    } else {
+        av_opt_set_double(enc->priv_data, "quality", cfg->quality, 0);
+    }
+
+    if (avcodec_open2(enc, codec, NULL) < 0) {
+        fprintf(stderr, "Error: No se pudo abrir el encoder %s (%dx%d)\n", cfg->codec, enc->width, enc->height);
+        avcodec_free_context(&enc);
+        return NULL;
+    }
+    return enc;
+}
+
+// Escala el frame al tamano de la imagen y lo codifica; deja los bytes en *data
+static int encode_image(FrameExtractor *x, ImageEncoder *ie, const AVFrame *frame, AVBufferRef **data) {
+    if (!ie->enc && !(ie->enc = open_image_encoder(x->cfg, frame->width, frame->height))) {
+        return 0;
+    }
+    ie->image->format = ie->enc->pix_fmt;
+    ie->image->width = ie->enc->width;
+    ie->image->height = ie->enc->height;
+    ie->sws = sws_getCachedContext(ie->sws, frame->width, frame->height, (AVPixelFormat)frame->format,
+                                   ie->enc->width, ie->enc->height, ie->enc->pix_fmt,
+                                   SWS_BICUBIC, NULL, NULL, NULL);
+    int ok = ie->sws && av_frame_get_buffer(ie->image, 0) >= 0;
+    if (ok) {
+        sws_scale(ie->sws, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height,
+                  ie->image->data, ie->image->linesize);
+    }
+
+    // Los encoders de imagen devuelven el paquete del frame enseguida
+    ok = ok && avcodec_send_frame(ie->enc, ie->image) >= 0 && avcodec_receive_packet(ie->enc, ie->pkt) == 0;
+    av_frame_unref(ie->image);
+    if (ok) {
+        *data = av_buffer_alloc(ie->pkt->size);
+        ok = (*data != NULL);
+        if (ok) {
+            memcpy((*data)->data, ie->pkt->data, ie->pkt->size);
+        }
+    }
+    av_packet_unref(ie->pkt);
+    return ok;
+}
+
+// La imagen codificada viaja al thread que escribe el tar en el opaque_ref del slot
+static int extract_process(void *opaque, int worker, AVFrame *decoded, AVFrame *processed, AVFrame **out) {
+    FrameExtractor *x = (FrameExtractor *)opaque;
+    if (!encode_image(x, &x->encoders[worker], decoded, &processed->opaque_ref)) {
+        return 0;
+    }
+    processed->pts = decoded->pts;
+    *out = processed;
+    return 1;
+}
+
+static int extract_consume(void *opaque, AVFrame *frame) {
+    FrameExtractor *x = (FrameExtractor *)opaque;
+    return write_archive_member(x, (int)frame->pts, frame->opaque_ref->data, (int)frame->opaque_ref->size);
+}
+
+// Imagen del instante target a partir de frame, que se sigue usando: el pipeline recibe otra referencia
+static int capture(FrameExtractor *x, const AVFrame *frame, int target) {
+    if (x->pipeline) {
+        if (av_frame_ref(x->copy, frame) < 0) {
+            return 0;
+        }
+        x->copy->pts = target;
+        return frame_pipeline_push(x->pipeline, x->copy);
+    }
+
+    AVBufferRef *data = NULL;
+    int ok = encode_image(x, &x->encoders[0], frame, &data) &&
+             write_archive_member(x, target, data->data, (int)data->size);
+    av_buffer_unref(&data);
+    return ok;
+}
+
+/*
+ * Frame decodificado del GOP, en orden de presentacion. En cada instante se
+ * ve el ultimo frame que empezo antes o en ese instante; uno anterior al
+ * primer frame del GOP se lleva el primero.
+ */
+static int take_frame(FrameExtractor *x, AVFrame *frame) {
+    int64_t pts = (frame->best_effort_timestamp != AV_NOPTS_VALUE) ? frame->best_effort_timestamp : frame->pts;
+    if (pts == AV_NOPTS_VALUE) {
+        return 1;
+    }
+
+    // Frames de un GOP abierto que dependen del GOP anterior: no se muestran en este
+    if (!x->key_seen) {
+        if (!(frame->flags & AV_FRAME_FLAG_KEY)) {
+            return 1;
+        }
+        x->key_seen = 1;
+        x->key_pts = pts;
+    } else if (pts < x->key_pts) {
+        return 1;
+    }
+    x->decoded++;
+
+    double t = pts * av_q2d(x->tb);
+    int ok = 1;
+    while (ok && x->next < x->end && x->times[x->next] < t) {
+        ok = capture(x, x->held->buf[0] ? x->held : frame, x->next++);
+    }
+    av_frame_unref(x->held);
+    av_frame_move_ref(x->held, frame);
+    while (ok && x->next < x->end && x->times[x->next] <= t) {
+        ok = capture(x, x->held, x->next++);
+    }
+    return ok;
+}
+
+static int receive_frames(FrameExtractor *x, AVFrame *frame) {
+    int ret;
+    while ((ret = avcodec_receive_frame(x->dec, frame)) == 0) {
+        int ok = take_frame(x, frame);
+        av_frame_unref(frame);
+        if (!ok) {
+            return 0;
+        }
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+}
+
+/*
+ * Instantes [x->next, x->end) del GOP: busca su keyframe y decodifica hasta
+ * pasar el ultimo. Si alguno cae despues del ultimo frame del GOP, el
+ * decoder se vacia en el siguiente keyframe y se usa ese ultimo frame.
+ */
+static int extract_gop(FrameExtractor *x, AVFormatContext *fmt, const GopIndex *index, int gop,
+                       AVPacket *pkt, AVFrame *frame, const SegmentRuntime *runtime) {
+    int64_t ts = index->gops[gop].timestamp;
+    if (avformat_seek_file(fmt, index->stream_index, ts, ts, ts, 0) < 0) {
+        fprintf(stderr, "Error: No se pudo posicionar en el GOP %d\n", gop);
+        return 0;
+    }
+    avcodec_flush_buffers(x->dec);
+    av_frame_unref(x->held);
+    x->key_seen = 0;
+
+    int ok = 1;
+    int started = 0;
+    while (ok && x->next < x->end && av_read_frame(fmt, pkt) >= 0) {
+        if (pkt->stream_index == index->stream_index) {
+            if (started && (pkt->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(pkt);
+                break;
+            }
+            started = 1;
+            ok = avcodec_send_packet(x->dec, pkt) >= 0 && receive_frames(x, frame);
+        }
+        av_packet_unref(pkt);
+        if (runtime->poll) {
+            runtime->poll(runtime->poll_opaque);
+        }
+    }
+
+    if (ok && x->next < x->end) {
+        ok = avcodec_send_packet(x->dec, NULL) >= 0 && receive_frames(x, frame);
+        while (ok && x->next < x->end && x->held->buf[0]) {
+            ok = capture(x, x->held, x->next++);
+        }
+        if (ok && x->next < x->end) {
+            fprintf(stderr, "Error: El GOP %d no tiene frames para t=%.3fs\n", gop, x->times[x->next]);
+            ok = 0;
+        }
+    }
+    av_frame_unref(x->held);
+    return ok;
+}
+
+extern "C" int extract_frames(AVFormatContext *fmt, const GopIndex *index, int first_gop, int end_gop,
+                              const TaskConfig *cfg, const char *archive_file, int rank,
+                              const SegmentRuntime *runtime) {
+    FrameExtractor x;
+    memset(&x, 0, sizeof(x));
+    x.cfg = cfg;
+    x.tb = fmt->streams[index->stream_index]->time_base;
+    x.mtime = time(NULL);
+
+    double *times = NULL;
+    int num_times = frame_targets(cfg, index, &times);
+    x.times = times;
+
+    // Solo hace falta el video
+    if (index->audio_stream_index >= 0) {
+        fmt->streams[index->audio_stream_index]->discard = AVDISCARD_ALL;
+    }
+
+    // Desde PIPELINE_MIN_THREADS las imagenes se codifican en workers mientras se decodifica
+    int workers = (runtime->threads >= PIPELINE_MIN_THREADS) ? runtime->threads - 1 : 0;
+    x.num_encoders = FFMAX(1, workers);
+    x.encoders = (ImageEncoder *)calloc(x.num_encoders, sizeof(ImageEncoder));
+    int ok = (num_times >= 0 && x.encoders != NULL);
+    for (int i = 0; ok && i < x.num_encoders; i++) {
+        x.encoders[i].image = av_frame_alloc();
+        x.encoders[i].pkt = av_packet_alloc();
+        ok = x.encoders[i].image && x.encoders[i].pkt;
+    }
+    x.held = av_frame_alloc();
+    x.copy = av_frame_alloc();
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    x.dec = ok ? open_decoder(fmt->streams[index->stream_index], NULL) : NULL;
+    x.archive = fopen(archive_file, "wb");
+    ok = ok && x.held && x.copy && pkt && frame && x.dec && x.archive;
+    if (!ok) {
+        fprintf(stderr, "[Rank %d] Error: No se pudo preparar el archivo de imagenes %s\n", rank, archive_file);
+    }
+    if (ok && workers > 0) {
+        x.pipeline = frame_pipeline_start(workers, 2 * workers + 2, extract_process, extract_consume, &x);
+        if (!x.pipeline) {
+            fprintf(stderr, "[Rank %d] Aviso: Sin pipeline, las imagenes se codifican en un solo thread\n", rank);
+        }
+    }
+
+    // Los instantes de GOPs anteriores son de otros ranks (o de otros lotes)
+    int target = 0;
+    while (target < num_times && gop_at_time(index, times[target]) < first_gop) {
+        target++;
+    }
+    int gops = 0;
+    for (int g = first_gop; ok && g < end_gop; g++) {
+        x.next = target;
+        x.end = target;
+        while (x.end < num_times && gop_at_time(index, times[x.end]) == g) {
+            x.end++;
+        }
+        if (x.end > x.next) {
+            ok = extract_gop(&x, fmt, index, g, pkt, frame, runtime);
+            gops++;
+        }
+        target = x.end;
+    }
+
+    // Las imagenes todavia en el pipeline se escriben antes de cerrar el archivo
+    ok = frame_pipeline_finish(&x.pipeline) && ok;
+    if (x.archive && fclose(x.archive) != 0) {
+        ok = 0;
+    }
+
+    if (runtime->stats) {
+        runtime->stats->frames += x.images;
+    }
+    if (ok) {
+        printf("[MPI Rank %d] Archivo %s: %d imagenes (%.1f KB) de %d GOPs, %d frames decodificados\n",
+               rank, archive_file, x.images, x.bytes / 1024.0, gops, x.decoded);
+        fflush(stdout);
+    } else {
+        fprintf(stderr, "[Rank %d] Error al extraer las imagenes en %s\n", rank, archive_file);
+    }
+
+    av_frame_free(&x.held);
+    av_frame_free(&x.copy);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&x.dec);
+    for (int i = 0; x.encoders && i < x.num_encoders; i++) {
+        avcodec_free_context(&x.encoders[i].enc);
+        sws_freeContext(x.encoders[i].sws);
+        av_frame_free(&x.encoders[i].image);
+        av_packet_free(&x.encoders[i].pkt);
+    }
+    free(x.encoders);
+    free(times);
+    return ok;
+}
+
+extern "C" int concat_frame_archives(const char *const *archive_files, int num_archives, const char *output_file) {
+    static const char end_blocks[2 * TAR_BLOCK] = {0};
+    FILE *out = fopen(output_file, "wb");
+    char *buffer = (char *)malloc(ARCHIVE_COPY_SIZE);
+    int ok = (out && buffer);
+    int archives = 0;
+    int64_t total = 0;
+
+    for (int i = 0; i < num_archives && ok; i++) {
+        if (!archive_files[i]) {
+            continue;
+        }
+        FILE *in = fopen(archive_files[i], "rb");
+        if (!in) {
+            fprintf(stderr, "Error: No se pudo abrir el segmento %s\n", archive_files[i]);
+            ok = 0;
+            break;
+        }
+        size_t n;
+        while (ok && (n = fread(buffer, 1, ARCHIVE_COPY_SIZE, in)) > 0) {
+            ok = fwrite(buffer, 1, n, out) == n;
+            total += n;
+        }
+        ok = ok && !ferror(in);
+        fclose(in);
+        archives++;
+    }
+
+    // Fin del tar: dos bloques en cero
+    ok = ok && fwrite(end_blocks, 1, sizeof(end_blocks), out) == sizeof(end_blocks);
+    if (out && fclose(out) != 0) {
+        ok = 0;
+    }
+    free(buffer);
+
+    if (ok) {
+        printf("Salida final %s: %d archivos de imagenes juntados (%.1f KB)\n", output_file, archives, total / 1024.0);
+        fflush(stdout);
+    } else {
+        fprintf(stderr, "Error: No se pudo crear la salida %s\n", output_file);
+    }
+    return ok;
+}
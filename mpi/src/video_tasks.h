@@ -0,0 +1,111 @@
+#ifndef VIDEO_TASKS_H
+#define VIDEO_TASKS_H
+
+#include <stdint.h>
+#include "gop_index.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_FRAME_TIMES 512          // instantes en la lista de extract_frames
+#define MAX_EXTRACTED_FRAMES 10000  // capturas por job, tambien con interval
+
+/*
+ * Configuracion de codificacion que resulta de task + params. Todas las
+ * tareas de video terminan en lo mismo: cada rank decodifica su rango de
+ * GOPs, aplica la tarea y codifica un segmento independiente con esta
+ * configuracion; el rank 0 concatena los segmentos sin recodificar.
+ * extract_frames es la excepcion: cada rank deja en su segmento (un tar sin
+ * cierre) las imagenes de los instantes que caen en sus GOPs.
+ */
+typedef struct {
+    char codec[32];    // encoder de libavcodec (libx264, libvpx-vp9...)
+    char format[16];   // contenedor de salida (mp4, webm, matroska, mov)
+    char extension[8];
+    int width;         // 0 = el de la entrada (o proporcional si solo se da el otro)
+    int height;
+    int crf;           // -1 = el default del encoder
+    int64_t bit_rate;  // 0 = controlado por crf
+    char preset[16];
+    int crop_x;        // recorte previo al escalado; crop_width == 0: sin recorte
+    int crop_y;
+    int crop_width;
+    int crop_height;
+    int brightness;    // sumado a la luma, [-255, 255]
+    double contrast;   // 1 = sin cambio, [0, 4]
+    int cut;           // 1: solo la ventana [cut_start, cut_end); los GOPs interiores se copian
+    double cut_start;  // segundos
+    double cut_end;    // segundos; -1 = hasta el final
+    int frames;             // extract_frames: imagenes de instantes sueltos en un tar en lugar de un video
+    double frame_interval;  // segundos entre capturas desde frame_start; 0 = la lista frame_times
+    double frame_start;
+    int quality;            // 1-100 de la imagen (codec mjpeg o libwebp)
+    char image_extension[8];
+    int num_frame_times;
+    double frame_times[MAX_FRAME_TIMES];  // ordenados y sin repetir, en segundos
+} TaskConfig;
+
+struct AVFormatContext;
+
+/*
+ * Entorno de un segmento. threads: nucleos disponibles para el rank; desde 3,
+ * decode, escalado y encode corren en un pipeline de threads. poll, si no es
+ * NULL, se llama entre paquetes desde el thread principal: ahi el rank 0
+ * atiende al reparto dinamico de GOPs sin un thread MPI aparte.
+ */
+typedef struct {
+    double seek;    // abrir el video y posicionarse en el keyframe del primer GOP
+    double decode;  // decode, proceso y encode (o extraccion de imagenes) de los GOPs
+    int frames;     // frames codificados (imagenes en extract_frames)
+} SegmentStats;
+
+typedef struct {
+    int threads;
+    void (*poll)(void *opaque);
+    void *poll_opaque;
+    SegmentStats *stats;  // si no es NULL, cada segmento suma ahi sus tiempos
+} SegmentRuntime;
+
+// Devuelve 0 si la tarea no existe o sus params no son validos
+int configure_video_task(const char *task, const char *params, TaskConfig *cfg);
+
+/*
+ * Codifica en segment_file los GOPs [first_gop, end_gop) a partir de fmt ya
+ * posicionado en first_gop. El audio del intervalo se copia sin recodificar.
+ */
+int encode_segment(struct AVFormatContext *fmt, const GopIndex *index, int first_gop, int end_gop,
+                   const TaskConfig *cfg, const char *segment_file, int rank, const SegmentRuntime *runtime);
+
+/*
+ * Rank 0: concatena en orden los segmentos (NULL: se saltea) copiando
+ * paquetes, sin recodificar. first_gops[i] es el primer GOP del segmento i.
+ */
+int concat_segments(const GopIndex *index, const char *const *segment_files, const int *first_gops,
+                    int num_segments, const TaskConfig *cfg, const char *output_file);
+
+/*
+ * extract_frames: instantes de captura de cfg dentro del video del indice,
+ * ordenados, en *times (lo libera quien llama). Da lo mismo sobre el indice
+ * completo que sobre el recortado por select_gop_index. Devuelve cuantos, o
+ * -1 si pasan de MAX_EXTRACTED_FRAMES o no hay memoria.
+ */
+int frame_targets(const TaskConfig *cfg, const GopIndex *index, double **times);
+
+/*
+ * Escribe en archive_file las imagenes de los instantes que caen en los GOPs
+ * [first_gop, end_gop). Cada GOP con capturas se busca por su keyframe y se
+ * decodifica solo hasta el ultimo instante que contiene; las imagenes se
+ * codifican en paralelo en los workers del rank.
+ */
+int extract_frames(struct AVFormatContext *fmt, const GopIndex *index, int first_gop, int end_gop,
+                   const TaskConfig *cfg, const char *archive_file, int rank, const SegmentRuntime *runtime);
+
+// Rank 0: junta en orden los tars de los segmentos (NULL: se saltea) y cierra el archivo final
+int concat_frame_archives(const char *const *archive_files, int num_archives, const char *output_file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif